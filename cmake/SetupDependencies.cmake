@@ -187,6 +187,9 @@ macro(asmgrader_setup_dependencies)
         _force_system_includes(libassert::assert)
     endif()
 
+    # std::thread, e.g. for reaping child processes in the background
+    find_package(Threads REQUIRED)
+
 
     if(NOT TARGET Catch2::Catch2WithMain)
         CPMAddPackage("gh:catchorg/Catch2@3.8.1")
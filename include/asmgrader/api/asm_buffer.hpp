@@ -6,6 +6,7 @@
 #include <asmgrader/common/macros.hpp>
 #include <asmgrader/program/program.hpp>
 #include <asmgrader/subprocess/memory/memory_io_base.hpp>
+#include <asmgrader/subprocess/memory/tracee_heap.hpp>
 
 #include <range/v3/algorithm/fill.hpp>
 #include <range/v3/range/conversion.hpp>
@@ -32,7 +33,9 @@ public:
     NativeByteArray<NumBytes> fill(Byte byte) const;
 
 private:
-    static std::uintptr_t get_alloced_address(Program& prog) { return prog.alloc_mem(NumBytes); }
+    static TraceeAllocation allocate(Program& prog) {
+        return TRY_OR_THROW(prog.alloc_mem(NumBytes), "failed to allocate buffer");
+    }
 };
 
 template <std::size_t NumBytes>
@@ -66,6 +69,6 @@ std::string AsmBuffer<NumBytes>::str() const {
 
 template <std::size_t NumBytes>
 AsmBuffer<NumBytes>::AsmBuffer(Program& prog)
-    : AsmData<NativeByteArray<NumBytes>>{prog, get_alloced_address(prog)} {}
+    : AsmData<NativeByteArray<NumBytes>>{prog, allocate(prog)} {}
 
 } // namespace asmgrader
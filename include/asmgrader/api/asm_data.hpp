@@ -5,12 +5,14 @@
 #include <asmgrader/logging.hpp>
 #include <asmgrader/program/program.hpp>
 #include <asmgrader/subprocess/memory/concepts.hpp>
+#include <asmgrader/subprocess/memory/tracee_heap.hpp>
 
 #include <fmt/base.h>
 
 #include <concepts>
 #include <cstdint>
 #include <string>
+#include <utility>
 
 namespace asmgrader {
 
@@ -21,6 +23,9 @@ class AsmData
 public:
     AsmData(Program& prog, std::uintptr_t address);
 
+    /// Refers to memory allocated in the program, which is freed once this (and any copies) are destroyed
+    AsmData(Program& prog, TraceeAllocation allocation);
+
     virtual ~AsmData() = default;
 
     // NOLINTNEXTLINE(google-runtime-operator) - nicer semantics?
@@ -59,6 +64,9 @@ private:
     Program* prog_;
 
     std::uintptr_t address_;
+
+    /// Empty if this object does not own the memory it refers to
+    TraceeAllocation allocation_;
 };
 
 template <typename T>
@@ -114,4 +122,11 @@ AsmData<T>::AsmData(Program& prog, std::uintptr_t address)
     : prog_{&prog}
     , address_{address} {}
 
+template <typename T>
+    requires(MemoryReadSupported<T>)
+AsmData<T>::AsmData(Program& prog, TraceeAllocation allocation)
+    : prog_{&prog}
+    , address_{allocation.get_address()}
+    , allocation_{std::move(allocation)} {}
+
 } // namespace asmgrader
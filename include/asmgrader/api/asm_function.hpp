@@ -213,6 +213,19 @@ public:
         return res;
     }
 
+    /// Calls the function once for each set of arguments in `arg_sets`, all within a single run of the program.
+    /// This is much faster than calling the function repeatedly, for table-driven or randomized tests.
+    ///
+    /// Only integral and pointer parameter and return types are supported.
+    /// \see Program::call_function_batch
+    BatchCallResult<Ret> call_batch(std::span<const std::tuple<Args...>> arg_sets) {
+        if (resolution_err_.has_value()) {
+            return *resolution_err_;
+        }
+
+        return prog_->call_function_batch<Ret(Args...)>(address_, arg_sets);
+    }
+
     const std::string& get_name() const { return name_; }
 
 private:
@@ -7,6 +7,7 @@
 #include <boost/mp11/integral.hpp>
 #include <boost/mp11/list.hpp>
 
+#include <chrono>
 #include <concepts>
 #include <cstddef>
 #include <functional>
@@ -52,6 +53,41 @@ struct Weight
     constexpr bool operator==(const Weight&) const = default;
 };
 
+/// Let the program under test run to completion once the test is over, rather than killing it
+///
+/// Only useful for tests with side effects beyond the program itself (e.g., files written).
+struct DrainProgramTag
+{
+    constexpr bool operator==(const DrainProgramTag&) const = default;
+};
+
+constexpr auto DrainProgram = DrainProgramTag{}; // NOLINT
+
+/// Never run the test concurrently with any other test of the same assignment (see `--test-jobs`). It's run once every
+/// test declared before it is done, and before any test declared after it is started.
+///
+/// For tests with side effects beyond the program itself that other tests may observe (e.g., files written).
+struct SerialTag
+{
+    constexpr bool operator==(const SerialTag&) const = default;
+};
+
+constexpr auto Serial = SerialTag{}; // NOLINT
+
+/// Limits on the CPU time the program under test may use, rather than the wall-clock time
+///
+/// Example: `TEST("Sort a large array", CpuTimeBudget{.per_call = 500ms, .per_test = 2s})`
+struct CpuTimeBudget
+{
+    /// Per function call (or run of the program); zero for the default
+    std::chrono::milliseconds per_call{};
+
+    /// Over the whole test; zero for no limit
+    std::chrono::milliseconds per_test{};
+
+    constexpr bool operator==(const CpuTimeBudget&) const = default;
+};
+
 namespace detail::meta {
 
 using namespace boost::mp11;
@@ -70,7 +106,7 @@ consteval bool is_normalized() {
 static_assert(
     std::same_as<NormalizedTypeList<std::tuple, int, int&, const int, const int&>, std::tuple<int, int, int, int>>);
 
-using MetadataAttrTs = mp_list<Assignment, ProfOnlyTag, Weight>;
+using MetadataAttrTs = mp_list<Assignment, ProfOnlyTag, Weight, CpuTimeBudget, DrainProgramTag, SerialTag>;
 
 // The type `T` if `T` is not void, otherwise std::monostate
 template <typename T>
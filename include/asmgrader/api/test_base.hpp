@@ -22,7 +22,10 @@ public:
         : name_{name}
         , assignment_{&assignment}
         , is_prof_only_{metadata.template get<metadata::ProfOnlyTag>()}
-        , weight_{metadata.template get<metadata::Weight>()} {}
+        , weight_{metadata.template get<metadata::Weight>()}
+        , cpu_time_budget_{metadata.template get<metadata::CpuTimeBudget>()}
+        , drains_program_{metadata.template get<metadata::DrainProgramTag>()}
+        , is_serial_{metadata.template get<metadata::SerialTag>()} {}
 
     virtual ~TestBase() noexcept = default;
 
@@ -36,6 +39,12 @@ public:
 
     std::optional<metadata::Weight> get_weight() const noexcept { return weight_; }
 
+    std::optional<metadata::CpuTimeBudget> get_cpu_time_budget() const noexcept { return cpu_time_budget_; }
+
+    bool get_drains_program() const noexcept { return drains_program_; }
+
+    bool get_is_serial() const noexcept { return is_serial_; }
+
 private:
     std::string_view name_;
     const Assignment* assignment_;
@@ -44,6 +53,9 @@ private:
     // Name could also be considered metadata...
     bool is_prof_only_;
     std::optional<metadata::Weight> weight_;
+    std::optional<metadata::CpuTimeBudget> cpu_time_budget_;
+    bool drains_program_;
+    bool is_serial_;
 };
 
 } // namespace asmgrader
@@ -13,7 +13,9 @@
 #include <asmgrader/program/program.hpp>
 #include <asmgrader/subprocess/memory/concepts.hpp>
 #include <asmgrader/subprocess/run_result.hpp>
+#include <asmgrader/subprocess/syscall_log.hpp>
 #include <asmgrader/subprocess/syscall_record.hpp>
+#include <asmgrader/subprocess/tracer_options.hpp>
 
 #include <fmt/base.h>
 #include <fmt/format.h>
@@ -67,25 +69,36 @@ public:
     /// Restarts the entire program
     ///
     /// Note: if the asm executable has changed, this will launch with the NEW executable
-    /// Important: this has the almost certain effect of invalidating all buffers or other
-    ///            addressable references to said program, as the address space WILL change
+    ///
+    /// Buffers allocated in the program (e.g., \ref AsmBuffer) stay valid at the same addresses where possible.
+    /// They keep their contents if the program is restored in place, and are zeroed if it must be spawned anew.
     void restart_program();
 
     // Low-level exececutor of an arbitrary syscall
     Result<SyscallRecord> exec_syscall(u64 sys_nr, std::array<std::uint64_t, 6> args);
 
     /// Get any **new** stdout from the program since the last call to this function
-    std::string get_stdout();
+    /// The result refers to the captured output, and is only valid until stdout is next read.
+    std::string_view get_stdout();
 
     /// Get all stdout from since the beginning of the test invokation
-    std::string get_full_stdout();
+    /// The result refers to the captured output, and is only valid until stdout is next read.
+    std::string_view get_full_stdout();
 
     /// Flushes any reamaining unread data in the stdin buffer
     /// Returns: number of bytes flushed, or error kind if failure occured
     std::size_t flush_stdin();
 
+    /// Number of bytes of stdin that the program has read so far
+    std::size_t get_stdin_consumed() const;
+
     /// Obtain a list of the syscalls that have been executed so far
-    const std::vector<SyscallRecord>& get_syscall_records() const;
+    SyscallRecordsView get_syscall_records() const;
+
+    /// Which syscalls made by called functions are recorded. By default, none but exits are, which keeps calls fast;
+    /// tests that inspect the syscalls of called functions should set \ref TracingPolicy::Full.
+    /// Every syscall made during \ref run is always recorded.
+    void set_call_tracing_policy(TracingPolicy policy);
 
     /// Get the current register state of the program
     RegistersState get_registers() const;
@@ -15,6 +15,7 @@ enum class ErrorKind {
     BadArgument,      ///< Bad argument to an AsmFunction. For an unwrappable type with no inner value.
     SyscallFailure,   ///< A Linux syscall failed
     SyscallPredSat,   ///< The syscall predicate passed to \ref Tracer::run_until was satisfied
+    Blocked,          ///< Program was blocked in the kernel (e.g., waiting on input) for longer than allowed
 
     UnknownError, ///< As named; use this as little as possible
 
@@ -27,7 +28,7 @@ using Result = Expected<T, ErrorKind>;
 } // namespace asmgrader
 
 FMT_SERIALIZE_ENUM(::asmgrader::ErrorKind, TimedOut, UnresolvedSymbol, UnexpectedReturn, BadArgument, SyscallPredSat,
-                   UnknownError, SyscallFailure, MaxErrorNum);
+                   Blocked, UnknownError, SyscallFailure, MaxErrorNum);
 
 /// If the supplied argument is an error (unexpected) type, then propegate the error type `e` up
 /// the call stack. Otherwise, continue execution as normal
@@ -18,6 +18,7 @@
 #include <cstdlib>
 #include <ctime>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <system_error>
@@ -25,15 +26,20 @@
 
 #include <bits/types/siginfo_t.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sched.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
 #include <sys/ptrace.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -78,6 +84,21 @@ inline Expected<std::string> read(int fd, size_t count) { // NOLINT
     return buffer;
 }
 
+/// reads from a file descriptor into `buf`. See read(2)
+/// returns the number of bytes read (which may be less than requested); logs failure at debug level
+inline Expected<ssize_t> read(int fd, void* buf, std::size_t count) {
+    ssize_t res = ::read(fd, buf, count);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+
+        LOG_DEBUG("read failed: '{}'", err);
+        return err;
+    }
+
+    return res;
+}
+
 /// closes a file descriptor. See close(2)
 /// returns success/failure; logs failure at debug level
 inline Expected<> close(int fd) {
@@ -181,6 +202,36 @@ inline Expected<Fork> fork() {
     return Fork{.which = Fork::Parent, .pid = res};
 }
 
+/// see clone(2). With CLONE_PIDFD in `flags`, a pidfd referring to the child is written to `pidfd`.
+/// returns the child's pid; logs failure at debug level
+inline Expected<pid_t> clone(int (*func)(void*), void* stack_top, int flags, void* arg, int* pidfd = nullptr) {
+    // NOLINTNEXTLINE(*vararg)
+    pid_t res = ::clone(func, stack_top, flags, arg, pidfd);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+        LOG_DEBUG("clone failed: '{}'", err);
+        return err;
+    }
+
+    return res;
+}
+
+/// see pidfd_send_signal(2)
+/// returns success/failure; logs failure at debug level
+inline Expected<> pidfd_send_signal(int pidfd, int sig) {
+    // NOLINTNEXTLINE(*vararg)
+    long res = ::syscall(SYS_pidfd_send_signal, pidfd, sig, nullptr, 0);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+        LOG_DEBUG("pidfd_send_signal failed: '{}'", err);
+        return err;
+    }
+
+    return {};
+}
+
 /// see open(2)
 /// returns success/failure; logs failure at debug level
 inline Expected<int> open(const std::string& pathname, int flags, mode_t mode = 0) {
@@ -210,6 +261,119 @@ inline Expected<off_t> lseek(int fd, off_t offset, int whence) {
     return res;
 }
 
+/// see pread(2)
+/// returns the number of bytes read (which may be less than requested); logs failure at debug level
+inline Expected<ssize_t> pread(int fd, void* buf, std::size_t count, off_t offset) {
+    ssize_t res = ::pread(fd, buf, count, offset);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+        LOG_DEBUG("pread failed: '{}'", err);
+        return err;
+    }
+
+    return res;
+}
+
+/// see pwrite(2)
+/// returns the number of bytes written (which may be less than requested); logs failure at debug level
+inline Expected<ssize_t> pwrite(int fd, const void* buf, std::size_t count, off_t offset) {
+    ssize_t res = ::pwrite(fd, buf, count, offset);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+        LOG_DEBUG("pwrite failed: '{}'", err);
+        return err;
+    }
+
+    return res;
+}
+
+/// see memfd_create(2)
+/// returns success/failure; logs failure at debug level
+inline Expected<int> memfd_create(gsl::czstring name, unsigned int flags) {
+    int res = ::memfd_create(name, flags);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+        LOG_DEBUG("memfd_create failed: '{}'", err);
+        return err;
+    }
+
+    return res;
+}
+
+/// see ftruncate(2)
+/// returns success/failure; logs failure at debug level
+inline Expected<> ftruncate(int fd, off_t length) {
+    int res = ::ftruncate(fd, length);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+        LOG_DEBUG("ftruncate failed: '{}'", err);
+        return err;
+    }
+
+    return {};
+}
+
+/// see mmap(2)
+/// returns success/failure; logs failure at debug level
+inline Expected<void*> mmap(void* addr, std::size_t length, int prot, int flags, int fd, off_t offset) {
+    void* res = ::mmap(addr, length, prot, flags, fd, offset);
+
+    if (res == MAP_FAILED) {
+        auto err = make_error_code(errno);
+        LOG_DEBUG("mmap failed: '{}'", err);
+        return err;
+    }
+
+    return res;
+}
+
+/// see munmap(2)
+/// returns success/failure; logs failure at debug level
+inline Expected<> munmap(void* addr, std::size_t length) {
+    int res = ::munmap(addr, length);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+        LOG_DEBUG("munmap failed: '{}'", err);
+        return err;
+    }
+
+    return {};
+}
+
+/// see clock_getcpuclockid(3)
+/// returns the id of the CPU-time clock of process `pid`; logs failure at debug level
+inline Expected<clockid_t> clock_getcpuclockid(pid_t pid) {
+    clockid_t clock_id{};
+
+    // Returns an error number directly, rather than setting errno
+    if (int err = ::clock_getcpuclockid(pid, &clock_id); err != 0) {
+        auto ec = make_error_code(err);
+        LOG_DEBUG("clock_getcpuclockid failed: '{}'", ec);
+        return ec;
+    }
+
+    return clock_id;
+}
+
+/// see clock_gettime(2)
+/// returns success/failure; logs failure at debug level
+inline Expected<timespec> clock_gettime(clockid_t clock_id) {
+    timespec res_ts{};
+
+    if (::clock_gettime(clock_id, &res_ts) == -1) {
+        auto err = make_error_code(errno);
+        LOG_DEBUG("clock_gettime failed: '{}'", err);
+        return err;
+    }
+
+    return res_ts;
+}
+
 /// see dup(2)
 /// returns success/failure; logs failure at debug level
 inline Expected<> dup2(int oldfd, int newfd) {
@@ -332,6 +496,22 @@ inline Expected<Pipe> pipe2(int flags = 0) {
     return pipe;
 }
 
+/// see poll(2)
+/// returns the number of fds with events; logs failure at debug level
+inline Expected<int> poll(std::span<pollfd> fds, int timeout_ms) {
+    int res = ::poll(fds.data(), fds.size(), timeout_ms);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+
+        LOG_DEBUG("poll failed: '{}'", err);
+
+        return err;
+    }
+
+    return res;
+}
+
 /// see ptrace(2)
 /// returns success/failure; logs failure at debug level
 // NOLINTBEGIN(google-runtime-int)
@@ -366,6 +546,79 @@ inline Expected<long> ptrace(int request, pid_t pid = 0, AddrT addr = NULL, Data
     return res;
 }
 
+/// see process_vm_readv(2)
+/// returns the number of bytes read (which may be less than requested); logs failure at debug level
+inline Expected<ssize_t> process_vm_readv(pid_t pid, std::span<const iovec> local_iov, std::span<const iovec> remote_iov) {
+    ssize_t res =
+        ::process_vm_readv(pid, local_iov.data(), local_iov.size(), remote_iov.data(), remote_iov.size(), /*flags=*/0);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+
+        LOG_DEBUG("process_vm_readv failed: '{}'", err);
+
+        return err;
+    }
+
+    return res;
+}
+
+/// see process_vm_writev(2)
+/// returns the number of bytes written (which may be less than requested); logs failure at debug level
+inline Expected<ssize_t> process_vm_writev(pid_t pid, std::span<const iovec> local_iov,
+                                           std::span<const iovec> remote_iov) {
+    ssize_t res =
+        ::process_vm_writev(pid, local_iov.data(), local_iov.size(), remote_iov.data(), remote_iov.size(), /*flags=*/0);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+
+        LOG_DEBUG("process_vm_writev failed: '{}'", err);
+
+        return err;
+    }
+
+    return res;
+}
+
+/// see prctl(2)
+/// returns success/failure; logs failure at debug level
+// NOLINTBEGIN(google-runtime-int) - based on prctl(2) spec
+inline Expected<int> prctl(int option, unsigned long arg2 = 0, unsigned long arg3 = 0, unsigned long arg4 = 0,
+                           unsigned long arg5 = 0) {
+    // NOLINTNEXTLINE(*vararg)
+    int res = ::prctl(option, arg2, arg3, arg4, arg5);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+
+        LOG_DEBUG("prctl failed: '{}'", err);
+
+        return err;
+    }
+
+    return res;
+}
+// NOLINTEND(google-runtime-int)
+
+/// see seccomp(2)
+/// returns success/failure; logs failure at debug level
+inline Expected<long> seccomp(unsigned int operation, unsigned int flags, void* args) { // NOLINT(google-runtime-int)
+    // no glibc wrapper exists
+    // NOLINTNEXTLINE(*vararg)
+    long res = ::syscall(SYS_seccomp, operation, flags, args); // NOLINT(google-runtime-int)
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+
+        LOG_DEBUG("seccomp failed: '{}'", err);
+
+        return err;
+    }
+
+    return res;
+}
+
 /// see stat(2)
 inline Expected<struct ::stat> stat(const std::string& pathname) {
     struct ::stat data_result{};
@@ -432,4 +685,40 @@ inline Expected<SignalHandlerT> signal(Signal sig, SignalHandlerT handler) {
     return prev_handler;
 }
 
+/// see sigaction(2)
+/// sets the action for `sig` to `act`, returning the previous action; logs failure at debug level
+inline Expected<struct ::sigaction> sigaction(Signal sig, const struct ::sigaction& act) {
+    struct ::sigaction prev_act{};
+
+    int res = ::sigaction(sig, &act, &prev_act);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+
+        LOG_DEBUG("sigaction failed: '{}'", err);
+
+        return err;
+    }
+
+    return prev_act;
+}
+
+/// see sigaction(2)
+/// obtains the current action for `sig` without modifying it; logs failure at debug level
+inline Expected<struct ::sigaction> sigaction(Signal sig) {
+    struct ::sigaction cur_act{};
+
+    int res = ::sigaction(sig, nullptr, &cur_act);
+
+    if (res == -1) {
+        auto err = make_error_code(errno);
+
+        LOG_DEBUG("sigaction failed: '{}'", err);
+
+        return err;
+    }
+
+    return cur_act;
+}
+
 } // namespace asmgrader::linux
@@ -21,6 +21,7 @@
 #include <range/v3/view/transform.hpp>
 
 #include <chrono>
+#include <cstddef>
 #include <filesystem>
 #include <functional>
 #include <optional>
@@ -106,6 +107,16 @@ struct TestResult
 
     std::optional<ContextInternalError> error;
 
+    /// Whether any call into the program exceeded its CPU time limits, even if the test carried on (e.g., treating
+    /// it as a failed requirement)
+    bool timed_out = false;
+
+    /// Whether the result was replayed from a \ref ResultCache, rather than the test being run
+    bool from_cache = false;
+
+    /// Wall-clock time taken to run the test (when it was originally run, if replayed from a cache)
+    std::chrono::milliseconds duration{};
+
     constexpr bool passed() const noexcept { return !error && num_failed() == 0; }
 
     constexpr int num_failed() const noexcept { return num_total - num_passed; }
@@ -121,6 +132,10 @@ struct AssignmentResult
     std::vector<TestResult> test_results;
     int num_requirements_total{};
 
+    /// Wall-clock time taken to run (or replay) every test. Less than the sum of their durations if they were run
+    /// concurrently.
+    std::chrono::milliseconds duration{};
+
     double get_percentage() const noexcept {
         using ranges::fold_left, ranges::views::transform;
 
@@ -178,6 +193,27 @@ struct MultiStudentResult
     std::vector<StudentResult> results;
 };
 
+/// How many test results were replayed from a \ref ResultCache over a run, rather than the tests being run
+struct CacheStats
+{
+    std::size_t hits{};
+    std::size_t misses{};
+};
+
+/// Predicted and actual time taken to run the tests of each student, to check the predictions used for scheduling
+/// (see \ref TimingDb)
+struct TimingReport
+{
+    struct Entry
+    {
+        std::string student;
+        std::chrono::milliseconds predicted;
+        std::chrono::milliseconds actual;
+    };
+
+    std::vector<Entry> entries;
+};
+
 } // namespace asmgrader
 
 // I'm crying, please give me reflection :(
@@ -113,7 +113,8 @@ inline void init_loggers() {
 #endif
 
     // Log to stderr. See https://github.com/gabime/spdlog/wiki/FAQ#switch-the-default-logger-to-stderr
-    spdlog::set_default_logger(spdlog::stderr_color_st("default"));
+    // Thread-safe, as students may be graded concurrently (see --jobs)
+    spdlog::set_default_logger(spdlog::stderr_color_mt("default"));
 }
 
 } // namespace asmgrader
@@ -1,16 +1,23 @@
 #pragma once
 
+#include <asmgrader/common/aliases.hpp>
+#include <asmgrader/common/bit_casts.hpp>
+#include <asmgrader/common/byte_vector.hpp>
 #include <asmgrader/common/class_traits.hpp>
 #include <asmgrader/common/error_types.hpp>
 #include <asmgrader/common/expected.hpp>
 #include <asmgrader/common/os.hpp>
 #include <asmgrader/logging.hpp>
 #include <asmgrader/meta/functional_traits.hpp>
+#include <asmgrader/subprocess/fork_server.hpp>
 #include <asmgrader/subprocess/memory/concepts.hpp>
+#include <asmgrader/subprocess/memory/memory_io_base.hpp>
+#include <asmgrader/subprocess/memory/tracee_heap.hpp>
 #include <asmgrader/subprocess/run_result.hpp>
 #include <asmgrader/subprocess/syscall_record.hpp>
 #include <asmgrader/subprocess/traced_subprocess.hpp>
 #include <asmgrader/subprocess/tracer.hpp>
+#include <asmgrader/subprocess/tracer_options.hpp>
 #include <asmgrader/symbols/symbol_table.hpp>
 
 #include <fmt/format.h>
@@ -18,20 +25,33 @@
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <functional>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include <sys/syscall.h>
+
 namespace asmgrader {
 
+/// Return values of each call of \ref Program::call_function_batch, or nothing for a void function
+template <typename Ret>
+using BatchCallResult = std::conditional_t<std::same_as<Ret, void>, Result<void>, Result<std::vector<Ret>>>;
+
 class Program : NonCopyable
 {
 public:
-    explicit Program(std::filesystem::path path, std::vector<std::string> args = {});
+    explicit Program(std::filesystem::path path, std::vector<std::string> args = {}, TracerOptions tracer_options = {});
+
+    /// Runs a copy of the pristine tracee of `fork_server`. \see TracedSubprocess::TracedSubprocess(ForkServer&)
+    explicit Program(ForkServer& fork_server);
 
     Program(Program&& other) = default;
     Program& operator=(Program&& rhs) = default;
@@ -39,10 +59,18 @@ public:
     ~Program() = default;
 
     /// \see Tracer::run
-    Result<RunResult> run();
+    Result<RunResult> run(TracingPolicy policy = TracingPolicy::Filtered);
 
     /// \see Tracer::run
-    Result<RunResult> run_until(const std::function<bool(SyscallRecord)>& pred);
+    Result<RunResult> run_until(const std::function<bool(SyscallRecord)>& pred,
+                                TracingPolicy policy = TracingPolicy::Filtered);
+
+    /// Which syscalls are traced and recorded during \ref call_function and \ref call_function_batch.
+    /// By default (\ref TracingPolicy::ExitOnly), functions stop only if they try to exit, which makes calls fast with
+    /// a seccomp filter but records none of their other syscalls; use \ref TracingPolicy::Full to record them all.
+    /// With \ref TracingPolicy::None, not even exits stop, so a function that exits restarts the program anew
+    /// (invalidating its memory IO and shared memory) rather than restoring it in place.
+    void set_call_tracing_policy(TracingPolicy policy) { call_tracing_policy_ = policy; }
 
     TracedSubprocess& get_subproc();
     const TracedSubprocess& get_subproc() const;
@@ -60,19 +88,39 @@ public:
     template <typename Func, typename... Args>
     Result<typename FunctionTraits<Func>::Ret> call_function(std::uintptr_t addr, Args&&... args);
 
-    // TODO: Proper allocation (and deallocation!!)
-    std::uintptr_t alloc_mem(std::size_t amt);
+    /// Calls the function at `addr` once for each element of `arg_sets`, all within a single run of the program
+    /// (see \ref Tracer::setup_batch_call). This is much faster than separate calls to \ref call_function.
+    ///
+    /// Only integral and pointer parameter and return types are supported. The batch fails as a whole if any
+    /// of the calls fails, and is subject to a single timeout.
+    ///
+    /// Returns: the return value of each call, in order
+    template <typename Func, typename... Args>
+    BatchCallResult<typename FunctionTraits<Func>::Ret> call_function_batch(std::uintptr_t addr,
+                                                                          std::span<const std::tuple<Args...>> arg_sets);
+
+    /// Allocates `amt` bytes of memory in the program. \see Tracer::allocate
+    Result<TraceeAllocation> alloc_mem(std::size_t amt);
+
+    /// Frees all memory allocated with \ref alloc_mem, such as in between tests sharing this program.
+    /// Handles to existing allocations no longer have any effect.
+    void reset_heap();
 
     static Expected<void, std::string> check_is_compat_elf(const std::filesystem::path& path);
 
 private:
+    /// Runs the program until the breakpoint that a called function returns to.
+    /// Fails with UnexpectedReturn if it stopped for any other reason. If the program exited
+    /// (or was about to, if exits are traced as per \ref call_tracing_policy_), it is restarted.
+    Result<void> run_to_return_breakpoint();
+
     std::filesystem::path path_;
     std::vector<std::string> args_;
 
     std::unique_ptr<TracedSubprocess> subproc_;
     std::unique_ptr<SymbolTable> symtab_;
 
-    std::size_t alloced_mem_{};
+    TracingPolicy call_tracing_policy_ = TracingPolicy::ExitOnly;
 };
 
 template <typename Func, typename... Args>
@@ -96,49 +144,94 @@ Result<typename FunctionTraits<Func>::Ret> Program::call_function(std::uintptr_t
     LOG_TRACE("Jumping to: {:#X} from {:#X}", addr, instr_pointer);
     TRY(tracer.jump_to(addr));
 
-    auto run_res = tracer.run();
+    TRY(run_to_return_breakpoint());
+
+    if constexpr (std::same_as<Ret, void>) {
+        return {};
+    } else {
+        std::optional<Ret> return_val = TRY(tracer.process_function_ret<Ret>());
+
+        if (!return_val) {
+            return ErrorKind::UnknownError;
+        }
 
-    if (!run_res) {
-        return run_res.error();
+        return *return_val;
     }
+}
 
-    using enum RunResult::Kind;
+template <typename Func, typename... Args>
+BatchCallResult<typename FunctionTraits<Func>::Ret>
+Program::call_function_batch(std::uintptr_t addr, std::span<const std::tuple<Args...>> arg_sets) {
+    using Ret = typename FunctionTraits<Func>::Ret;
 
-    // If the subprocess is no longer alive, restart it
-    // TODO: Should instead catch exit condition before it has an effect
-    if (run_res->get_kind() == Exited || run_res->get_kind() == Killed) {
-        TRY(subproc_->restart());
+    static_assert(sizeof...(Args) <= Tracer::BATCH_CALL_MAX_ARGS, "Too many arguments for a batch call");
+    static_assert((true && ... && (std::integral<Args> || std::is_pointer_v<Args>)),
+                  "Only integral and pointer arguments are supported for batch calls");
+    static_assert(std::same_as<Ret, void> || std::integral<Ret> || std::is_pointer_v<Ret>,
+                  "Only integral, pointer and void return types are supported for batch calls");
+
+    constexpr std::size_t ENTRY_WORDS = Tracer::BATCH_CALL_ENTRY_WORDS;
+    constexpr std::size_t RET_WORD = ENTRY_WORDS - 1;
+
+    // Layout of each entry: arguments, padded with zeros, then the return value
+    std::vector<u64> table(arg_sets.size() * ENTRY_WORDS);
+
+    for (std::size_t i = 0; i < arg_sets.size(); ++i) {
+        std::apply(
+            [&table, word = i * ENTRY_WORDS]<typename... Ts>(const Ts&... args) mutable {
+                auto to_word = []<typename T>(const T& arg) -> u64 {
+                    if constexpr (std::is_pointer_v<T>) {
+                        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                        return reinterpret_cast<u64>(arg);
+                    } else {
+                        return static_cast<u64>(arg);
+                    }
+                };
+
+                ((table[word++] = to_word(args)), ...);
+            },
+            arg_sets[i]);
     }
 
-    // We expect that the function returns to our written instruction, which is essentially a breakpoint
-    // that raises SIGTRAP
-    if (run_res->get_kind() != SignalCaught || run_res->get_code() != SIGTRAP) {
-        LOG_DEBUG("Unexpected return from function: kind={}, code={}", fmt::underlying(run_res->get_kind()),
-                  run_res->get_code());
-
-        std::uintptr_t instr_addr =
-#ifdef __aarch64__
-            subproc_->get_tracer().get_registers()->pc;
-#else
-            subproc_->get_tracer().get_registers()->rip;
-#endif
-        if (auto res = subproc_->get_tracer().get_memory_io().read_bytes(instr_addr, 16); res) {
-            LOG_TRACE("Memory (16 bytes) at point of instruction ptr (0x{:x}): {::x}", instr_addr, *res);
+    if (table.empty()) {
+        if constexpr (std::same_as<Ret, void>) {
+            return {};
+        } else {
+            return std::vector<Ret>{};
         }
-
-        return ErrorKind::UnexpectedReturn;
     }
 
+    Tracer& tracer = subproc_->get_tracer();
+    MemoryIOBase& mio = tracer.get_memory_io();
+
+    const TraceeAllocation table_mem = TRY(alloc_mem(table.size() * sizeof(u64)));
+    TRY(mio.write(table_mem.get_address(), to_bytes<NativeByteVector>(table)));
+
+    LOG_TRACE("Calling function at {:#X} in a batch of {}", addr, arg_sets.size());
+    TRY(tracer.setup_batch_call(addr, table_mem.get_address(), arg_sets.size()));
+
+    TRY(run_to_return_breakpoint());
+
     if constexpr (std::same_as<Ret, void>) {
         return {};
     } else {
-        std::optional<Ret> return_val = TRY(tracer.process_function_ret<Ret>());
-
-        if (!return_val) {
-            return ErrorKind::UnknownError;
+        const NativeByteVector results_bytes = TRY(mio.read_bytes(table_mem.get_address(), table.size() * sizeof(u64)));
+        std::vector<Ret> results;
+        results.reserve(arg_sets.size());
+
+        for (std::size_t i = 0; i < arg_sets.size(); ++i) {
+            u64 ret{};
+            std::memcpy(&ret, results_bytes.data() + ((i * ENTRY_WORDS) + RET_WORD) * sizeof(u64), sizeof(u64));
+
+            if constexpr (std::is_pointer_v<Ret>) {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast,performance-no-int-to-ptr)
+                results.push_back(reinterpret_cast<Ret>(ret));
+            } else {
+                results.push_back(static_cast<Ret>(ret));
+            }
         }
 
-        return *return_val;
+        return results;
     }
 }
 
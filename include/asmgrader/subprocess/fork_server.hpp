@@ -0,0 +1,51 @@
+#pragma once
+
+#include <asmgrader/common/class_traits.hpp>
+#include <asmgrader/common/error_types.hpp>
+#include <asmgrader/subprocess/traced_subprocess.hpp>
+#include <asmgrader/subprocess/tracer.hpp>
+#include <asmgrader/subprocess/tracer_options.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace asmgrader {
+
+/// Keeps a pristine tracee of an executable, stopped right after exec, from which ready-to-run
+/// copies are forked on demand.
+///
+/// Forking a stopped tracee is much cheaper than a fresh fork+exec and tracer setup, as the
+/// executable does not need to be loaded again. \see TracedSubprocess::TracedSubprocess(ForkServer&)
+class ForkServer : NonMovable
+{
+public:
+    ForkServer(std::string exec, std::vector<std::string> args, TracerOptions options = {});
+
+    ~ForkServer();
+
+    /// Start the pristine tracee
+    Result<void> start();
+
+    /// Fork a copy of the pristine tracee. See \ref Tracer::fork_tracee
+    Result<pid_t> fork_child();
+
+    const Tracer& get_tracer() const { return pristine_->get_tracer(); }
+
+    const std::string& get_exec() const { return exec_; }
+
+    const std::vector<std::string>& get_args() const { return args_; }
+
+    const TracerOptions& get_options() const { return options_; }
+
+private:
+    std::string exec_;
+    std::vector<std::string> args_;
+    TracerOptions options_;
+
+    std::unique_ptr<TracedSubprocess> pristine_;
+};
+
+} // namespace asmgrader
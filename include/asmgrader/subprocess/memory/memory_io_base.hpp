@@ -98,6 +98,9 @@ private:
     template <typename T>
     friend struct MemoryIOSerde;
 
+    // Delegates to the backend it decorates
+    friend class SharedMemoryIO;
+
     virtual Result<NativeByteVector> read_until(std::uintptr_t address, const std::function<bool(Byte)>& predicate);
     virtual Result<NativeByteVector> read_until(std::uintptr_t address,
                                             const std::function<bool(std::span<const Byte>)>& predicate,
@@ -105,6 +108,14 @@ private:
 
     virtual Result<NativeByteVector> read_block_impl(std::uintptr_t address, std::size_t length) = 0;
     virtual Result<void> write_block_impl(std::uintptr_t address, const NativeByteVector& data) = 0;
+
+    /// Number of bytes that \ref read_until should request per \ref read_block_impl call
+    ///
+    /// Backends that transfer a whole block in a single syscall should return something larger
+    /// than the default (one machine word), so that reading e.g. a C string is not one syscall per word.
+    /// Reads are always clamped to the end of the current page, so that a larger block size never faults
+    /// on an unmapped page that the predicate would not have reached.
+    virtual std::size_t preferred_block_size() const { return sizeof(std::uint64_t); }
 };
 
 } // namespace asmgrader
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <asmgrader/common/byte_vector.hpp>
+#include <asmgrader/common/error_types.hpp>
+#include <asmgrader/subprocess/memory/memory_io_base.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace asmgrader {
+
+/// A copy of the contents of every writable mapping of a stopped tracee, which may later be
+/// written back to restore the tracee's memory to the state at the time of the snapshot.
+///
+/// Ranges of memory may be excluded from a snapshot (e.g., memory handed out to the grader), in which case
+/// their contents are left as-is upon restoring it.
+///
+/// Only pages that were modified since the snapshot (or since the last restore) are written back.
+/// Modified pages are found with the kernel's soft-dirty bits if available (see the kernel's
+/// Documentation/admin-guide/mm/soft-dirty.rst), and otherwise by comparing against the tracee's memory.
+class MemorySnapshot
+{
+public:
+    static constexpr std::size_t PAGE_SIZE = 4096;
+
+    /// A mapping as listed in /proc/<pid>/maps
+    struct Mapping
+    {
+        std::uintptr_t start;
+        std::uintptr_t end;
+        std::string perms;
+        std::string pathname;
+
+        bool is_writable() const { return perms.find('w') != std::string::npos; }
+
+        bool is_stack() const { return pathname == "[stack]"; }
+
+        /// Memory shared with another process (e.g., the grader) is not the tracee's own state to restore
+        bool is_shared() const { return perms.find('s') != std::string::npos; }
+
+        /// Whether the mapping is part of a snapshot
+        bool is_snapshotted() const { return is_writable() && !is_shared(); }
+    };
+
+    /// A page-aligned range of addresses [start, end)
+    struct Range
+    {
+        std::uintptr_t start;
+        std::uintptr_t end;
+    };
+
+    /// Records the contents of all writable, private mappings of the stopped tracee `memory_io` refers to,
+    /// except for those parts of them within `excluded`
+    static Result<MemorySnapshot> take(MemoryIOBase& memory_io, std::span<const Range> excluded = {});
+
+    /// Writes back all pages modified since the snapshot was taken
+    ///
+    /// Memory within `excluded` is neither compared against the snapshot nor written. Ranges excluded from
+    /// the snapshot when it was taken should be excluded here too, but ranges mapped since may be as well.
+    ///
+    /// Fails with BadArgument if the tracee's writable mappings (outside of `excluded`) have changed in a way
+    /// that a write-back cannot undo (e.g., new mappings or a moved program break). The stack may have grown.
+    ///
+    /// Returns: the number of pages that were written
+    Result<std::size_t> restore(MemoryIOBase& memory_io, std::span<const Range> excluded = {});
+
+    /// Whether modified pages are tracked with soft-dirty bits, rather than by comparison
+    bool uses_soft_dirty() const { return soft_dirty_; }
+
+    /// Total number of bytes recorded
+    std::size_t size() const;
+
+    /// Parses the mappings of process `pid` from /proc/<pid>/maps
+    static Result<std::vector<Mapping>> read_mappings(pid_t pid);
+
+private:
+    /// The recorded part of a mapping; all of it, unless part of the mapping was excluded
+    struct Region
+    {
+        Mapping mapping;
+        std::uintptr_t start;
+        NativeByteVector data;
+
+        std::uintptr_t end() const { return start + data.size(); }
+    };
+
+    MemorySnapshot(pid_t pid, std::vector<Region> regions)
+        : pid_{pid}
+        , regions_{std::move(regions)} {}
+
+    /// Whether the current mappings of the tracee, outside of `excluded`, can be restored to those of the
+    /// snapshot in place
+    Result<bool> mappings_compatible(std::span<const Range> excluded) const;
+
+    /// Clears soft-dirty bits of every page of the tracee
+    Result<void> clear_soft_dirty() const;
+
+    /// Checks that soft-dirty bits are set upon writing to the tracee
+    /// (they are not on kernels without CONFIG_MEM_SOFT_DIRTY, for instance)
+    Result<bool> probe_soft_dirty(MemoryIOBase& memory_io) const;
+
+    /// Returns: for each page in `region`, whether its soft-dirty bit is set
+    Result<std::vector<bool>> read_soft_dirty_bits(const Region& region) const;
+
+    /// Returns: for each page in `region`, whether it has been modified since the snapshot or last restore
+    Result<std::vector<bool>> get_dirty_pages(MemoryIOBase& memory_io, const Region& region) const;
+
+    pid_t pid_;
+    std::vector<Region> regions_;
+    bool soft_dirty_ = false;
+};
+
+} // namespace asmgrader
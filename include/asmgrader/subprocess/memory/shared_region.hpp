@@ -0,0 +1,55 @@
+#pragma once
+
+#include <asmgrader/common/aliases.hpp>
+#include <asmgrader/common/error_types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace asmgrader {
+
+/// Anonymous memory (a memfd) mapped into the grader, which may also be mapped into a tracee
+///
+/// Memory mapped from the same memfd in both processes is truly shared, so the grader can access
+/// the tracee's copy with a plain memcpy instead of a syscall per transfer.
+class SharedRegion
+{
+public:
+    SharedRegion() = default;
+
+    /// Create a memfd of `size` bytes (rounded up to a page) and map it into the grader
+    static Result<SharedRegion> create(std::size_t size);
+
+    SharedRegion(const SharedRegion&) = delete;
+    SharedRegion& operator=(const SharedRegion&) = delete;
+
+    SharedRegion(SharedRegion&& other) noexcept;
+    SharedRegion& operator=(SharedRegion&& other) noexcept;
+
+    ~SharedRegion();
+
+    /// The memfd, for mapping into a tracee. Closed upon destruction.
+    int get_fd() const { return fd_; }
+
+    /// The grader's mapping of the region
+    std::span<std::byte> get_data() const { return {data_, size_}; }
+
+    std::size_t size() const { return size_; }
+
+    explicit operator bool() const { return fd_ != -1; }
+
+private:
+    SharedRegion(int fd, std::byte* data, std::size_t size)
+        : fd_{fd}
+        , data_{data}
+        , size_{size} {}
+
+    void reset();
+
+    int fd_ = -1;
+    std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace asmgrader
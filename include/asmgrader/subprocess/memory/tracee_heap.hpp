@@ -0,0 +1,163 @@
+#pragma once
+
+#include <asmgrader/common/aliases.hpp>
+#include <asmgrader/common/error_types.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace asmgrader {
+
+class TraceeHeap;
+
+/// A block of tracee memory allocated from a \ref TraceeHeap, which is freed once the last copy
+/// of the handle is destroyed.
+///
+/// If the heap was reset or destroyed in the meantime, destroying the handle has no effect.
+class TraceeAllocation
+{
+public:
+    TraceeAllocation() = default;
+
+    std::uintptr_t get_address() const { return block_ ? block_->address : 0; }
+
+    /// Usable size of the block, which is at least the requested size
+    std::size_t size() const { return block_ ? block_->size : 0; }
+
+    explicit operator bool() const { return block_ != nullptr; }
+
+private:
+    friend class TraceeHeap;
+
+    struct Block
+    {
+        Block(std::weak_ptr<TraceeHeap> heap, u64 generation, std::uintptr_t address, std::size_t size)
+            : heap{std::move(heap)}
+            , generation{generation}
+            , address{address}
+            , size{size} {}
+
+        Block(const Block&) = delete;
+        Block& operator=(const Block&) = delete;
+        Block(Block&&) = delete;
+        Block& operator=(Block&&) = delete;
+
+        ~Block();
+
+        std::weak_ptr<TraceeHeap> heap;
+        u64 generation;
+        std::uintptr_t address;
+        std::size_t size;
+    };
+
+    explicit TraceeAllocation(std::shared_ptr<Block> block)
+        : block_{std::move(block)} {}
+
+    std::shared_ptr<Block> block_;
+};
+
+/// Bookkeeping of a heap in tracee memory
+///
+/// Small requests are rounded up to a power-of-two size class, each with its own free list. Blocks of
+/// a size class are carved as needed from a run of pages reserved for small blocks. Large requests are
+/// given a dedicated run of pages, which returns to the pool of free pages upon deallocation.
+///
+/// The heap does not map memory itself, as that requires running the tracee; when \ref allocate
+/// reports that more memory is needed, map an arena of \ref arena_size_for bytes and \ref add_arena it.
+class TraceeHeap : public std::enable_shared_from_this<TraceeHeap>
+{
+public:
+    static constexpr std::size_t PAGE_SIZE = 4096;
+
+    /// Size and alignment of the smallest size class
+    static constexpr std::size_t MIN_BLOCK_SIZE = 16;
+
+    /// Size of the largest size class; larger requests get a dedicated run of pages
+    static constexpr std::size_t MAX_SMALL_BLOCK_SIZE = 16 * PAGE_SIZE;
+
+    /// Size of the runs of pages that small blocks are carved from
+    static constexpr std::size_t SMALL_RUN_SIZE = 4 * MAX_SMALL_BLOCK_SIZE;
+
+    struct Arena
+    {
+        std::uintptr_t start;
+        std::size_t length;
+
+        /// Mapped from memory shared with the grader, rather than privately; see \ref SharedRegion
+        bool shared = false;
+    };
+
+    /// Allocates a block of at least `size` bytes
+    ///
+    /// Returns: the allocation, or nullopt if an arena of \ref arena_size_for(size) bytes must be added first
+    std::optional<TraceeAllocation> allocate(std::size_t size);
+
+    /// Length of the arena to add to satisfy an allocation of `size` bytes which failed
+    static std::size_t arena_size_for(std::size_t size);
+
+    /// Adds memory mapped in the tracee with a length obtained from \ref arena_size_for, or any
+    /// multiple of PAGE_SIZE for memory that was mapped up front
+    void add_arena(std::uintptr_t start, std::size_t length, bool shared = false);
+
+    /// Returns a block to its free list. Fails with BadArgument if `address` is not a live allocation.
+    Result<void> deallocate(std::uintptr_t address);
+
+    /// Frees every allocation, keeping the arenas for reuse. Existing handles become inert.
+    void reset();
+
+    /// Forgets about all arenas, such as when the tracee's address space is gone. Existing handles become inert.
+    ///
+    /// Returns: the arenas that were in use
+    std::vector<Arena> release();
+
+    const std::vector<Arena>& get_arenas() const { return arenas_; }
+
+    /// Number of live allocations
+    std::size_t num_allocated() const { return live_.size(); }
+
+    /// Incremented whenever handles are made inert by \ref reset or \ref release
+    u64 get_generation() const { return generation_; }
+
+private:
+    static constexpr std::size_t NUM_SIZE_CLASSES = 13; // 16B to 64KiB
+
+    static_assert((MIN_BLOCK_SIZE << (NUM_SIZE_CLASSES - 1)) == MAX_SMALL_BLOCK_SIZE);
+
+    /// Index of the smallest size class that fits `size`. Precondition: size <= MAX_SMALL_BLOCK_SIZE
+    static std::size_t size_class_of(std::size_t size);
+
+    static std::size_t size_of_class(std::size_t size_class) { return MIN_BLOCK_SIZE << size_class; }
+
+    TraceeAllocation make_allocation(std::uintptr_t address, std::size_t size);
+
+    /// Takes a free run of at least `length` bytes (a multiple of PAGE_SIZE), returning the rest to the pool
+    std::optional<std::uintptr_t> take_pages(std::size_t length);
+
+    /// Splits the unused part of the current small run among the free lists
+    void retire_small_run();
+
+    std::vector<Arena> arenas_;
+
+    std::array<std::vector<std::uintptr_t>, NUM_SIZE_CLASSES> free_lists_;
+
+    /// Unused part of the run of pages that small blocks are currently carved from
+    std::uintptr_t bump_ptr_{};
+    std::uintptr_t bump_end_{};
+
+    /// Free runs of pages; length -> start addresses
+    std::multimap<std::size_t, std::uintptr_t> free_pages_;
+
+    /// Usable size of each live block, by address
+    std::unordered_map<std::uintptr_t, std::size_t> live_;
+
+    u64 generation_ = 0;
+};
+
+} // namespace asmgrader
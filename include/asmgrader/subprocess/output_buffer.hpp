@@ -0,0 +1,93 @@
+#pragma once
+
+#include <asmgrader/common/error_types.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace asmgrader {
+
+/// What \ref OutputBuffer does with new output once its capacity is reached
+enum class OutputOverflow {
+    DropNewest, ///< Keep the oldest output; new output is read from the pipe and discarded
+    Ring,       ///< Keep the newest output; the oldest output is discarded to make room
+};
+
+/// Configuration for capturing the stdout of a \ref Subprocess
+struct OutputCaptureOptions
+{
+    static constexpr std::size_t DEFAULT_CAPACITY = std::size_t{16} * 1024 * 1024;
+    static constexpr std::size_t DEFAULT_PIPE_SIZE = std::size_t{1024} * 1024;
+
+    /// Maximum number of bytes kept; unlimited if unset
+    std::optional<std::size_t> capacity = DEFAULT_CAPACITY;
+
+    OutputOverflow overflow = OutputOverflow::DropNewest;
+
+    /// Requested capacity of the pipe, so that a program printing in a loop fills it less often (a traced program's
+    /// stdout is drained while it runs; see \ref Tracer::set_stdout_buffer).
+    /// Silently limited by /proc/sys/fs/pipe-max-size for unprivileged users. See F_SETPIPE_SZ in fcntl(2).
+    std::size_t pipe_size = DEFAULT_PIPE_SIZE;
+};
+
+/// Contiguous buffer of output drained from a pipe, with an optional cap on the bytes kept
+///
+/// Data is read straight from the pipe into the buffer's storage, and handed out as views rather
+/// than copies. Views remain valid until the next call to \ref drain, \ref append or \ref clear.
+class OutputBuffer
+{
+public:
+    OutputBuffer() = default;
+
+    OutputBuffer(std::optional<std::size_t> capacity, OutputOverflow overflow);
+
+    /// Read all data currently available from `fd`, which should be non-blocking.
+    /// Returns the number of bytes read, including any that were dropped due to the capacity.
+    Result<std::size_t> drain(int fd);
+
+    /// Append `data` as if it had been read from the pipe
+    void append(std::string_view data);
+
+    /// All output kept, from the oldest byte
+    std::string_view view() const { return std::string_view{data_}.substr(head_); }
+
+    /// \ref view as raw bytes
+    std::span<const std::byte> bytes() const { return std::as_bytes(std::span{view()}); }
+
+    /// Output that has not yet been consumed
+    std::string_view unread() const { return std::string_view{data_}.substr(cursor_); }
+
+    /// \ref unread, marking it as consumed
+    std::string_view consume();
+
+    std::size_t size() const { return data_.size() - head_; }
+
+    bool empty() const { return size() == 0; }
+
+    /// Number of bytes that were discarded due to the capacity
+    std::size_t num_dropped() const { return num_dropped_; }
+
+    void clear();
+
+private:
+    /// Discard data in excess of the capacity, according to the overflow policy
+    void enforce_capacity();
+
+    /// Moves kept data to the front of the storage, if discarded data takes up a sizable portion of it
+    void maybe_compact();
+
+    std::optional<std::size_t> capacity_;
+    OutputOverflow overflow_ = OutputOverflow::DropNewest;
+
+    std::string data_;
+    /// Offset of the oldest byte kept; only nonzero in ring mode
+    std::size_t head_ = 0;
+    /// Offset of the oldest unread byte
+    std::size_t cursor_ = 0;
+    std::size_t num_dropped_ = 0;
+};
+
+} // namespace asmgrader
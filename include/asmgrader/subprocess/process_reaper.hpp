@@ -0,0 +1,65 @@
+#pragma once
+
+#include <asmgrader/common/class_traits.hpp>
+#include <asmgrader/common/expected.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <signal.h>
+#include <sys/types.h>
+
+namespace asmgrader {
+
+/// Reaps terminated child processes on a background thread
+///
+/// A process that was sent SIGKILL may still take a while to actually exit (e.g., to tear down its address space).
+/// Handing it off to a reaper lets the caller move on immediately instead of waiting for that.
+class ProcessReaper : NonMovable
+{
+public:
+    ProcessReaper();
+
+    /// Reaps any remaining processes, then stops the background thread
+    ~ProcessReaper();
+
+    /// Reap `pid`, which must be a child of this process that is certain to exit (e.g., after SIGKILL).
+    /// Takes ownership of `pidfd` referring to the same process, if not -1, which is used for the wait.
+    void reap(pid_t pid, int pidfd);
+
+    /// Blocks until every process handed off so far has been reaped
+    void wait_idle();
+
+    /// Number of processes reaped so far
+    std::size_t num_reaped() const;
+
+    /// Blocks until `pid` has exited, and reaps it. The wait is done by way of `pidfd` if it's not -1.
+    static Expected<siginfo_t> reap_now(pid_t pid, int pidfd);
+
+private:
+    struct Child
+    {
+        pid_t pid;
+        int pidfd;
+    };
+
+    void run();
+
+    mutable std::mutex mutex_;
+    std::condition_variable pending_cv_;
+    std::condition_variable idle_cv_;
+
+    std::deque<Child> pending_;
+    /// Number of processes taken off pending_ that are still being waited on
+    std::size_t num_in_progress_ = 0;
+    std::size_t num_reaped_ = 0;
+    bool stopping_ = false;
+
+    // Must be last, as the thread uses all other members
+    std::thread thread_;
+};
+
+} // namespace asmgrader
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <asmgrader/common/aliases.hpp>
+#include <asmgrader/common/error_types.hpp>
+#include <asmgrader/common/expected.hpp>
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include <linux/filter.h>
+#include <sys/types.h>
+
+namespace asmgrader {
+
+/// A seccomp-BPF program that requests a ptrace(2) stop (SECCOMP_RET_TRACE) upon entry to each of a set of
+/// syscalls, and allows all others to run without any involvement of the tracer.
+///
+/// Syscalls made with a foreign ABI (e.g., `int 0x80` on x86_64) are always traced.
+class SeccompTraceFilter
+{
+public:
+    explicit SeccompTraceFilter(std::span<const u64> syscall_nrs);
+
+    /// Install the filter for the calling process
+    ///
+    /// To be called in the child process after it has been stopped for the tracer to set
+    /// PTRACE_O_TRACESECCOMP. Otherwise, filtered syscalls will fail with ENOSYS.
+    /// Performs no allocations (not even to log failures), so this is safe to call after fork(2).
+    /// Returns the errno of the failing syscall on failure.
+    Expected<> install() const;
+
+    std::size_t size() const { return program_.size(); }
+
+    /// Whether a seccomp filter is in effect for the process `pid`
+    static Result<bool> is_installed(pid_t pid);
+
+private:
+    std::vector<sock_filter> program_;
+};
+
+} // namespace asmgrader
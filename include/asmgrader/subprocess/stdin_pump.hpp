@@ -0,0 +1,67 @@
+#pragma once
+
+#include <asmgrader/common/error_types.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+
+namespace asmgrader {
+
+/// Feeds queued input to the stdin pipe of a child process without ever blocking
+///
+/// Input is written whenever the pipe has room, by way of \ref pump. This is done upon every
+/// \ref push, and by \ref Tracer while it waits on the tracee (see \ref Tracer::set_stdin_pump),
+/// so that input larger than the pipe is delivered as the child reads it.
+///
+/// The pump does not own the pipe's file descriptors.
+class StdinPump
+{
+public:
+    StdinPump() = default;
+
+    /// Feed the pipe with write end `write_fd`, which must be non-blocking. The read end `read_fd` is
+    /// only used to discard unread input (see \ref discard); it is never read from otherwise.
+    /// Resets all state.
+    void attach(int write_fd, int read_fd);
+
+    /// Stop feeding the pipe. Any queued input is discarded.
+    void detach() { attach(-1, -1); }
+
+    /// Queue `input` to be written after all previously queued input, and try writing it right away
+    Result<void> push(std::string_view input);
+
+    /// Write as much queued input as the pipe can take. Returns the number of bytes written.
+    Result<std::size_t> pump();
+
+    bool has_queued() const { return num_queued_ != 0; }
+
+    /// Number of bytes that have yet to be written to the pipe
+    std::size_t num_queued() const { return num_queued_; }
+
+    /// Number of bytes written to the pipe, but not yet read by the child
+    Result<std::size_t> num_unread() const;
+
+    /// Number of bytes that the child has read
+    Result<std::size_t> num_consumed() const;
+
+    /// Discard all queued and unread input, so that the child's next read finds nothing.
+    /// Returns the number of bytes discarded.
+    Result<std::size_t> discard();
+
+private:
+    int write_fd_ = -1;
+    int read_fd_ = -1;
+
+    std::deque<std::string> queue_;
+    /// Bytes of queue_.front() that have already been written
+    std::size_t front_offset_ = 0;
+    std::size_t num_queued_ = 0;
+
+    std::size_t num_written_ = 0;
+    /// Bytes written to the pipe that were discarded instead of being read by the child
+    std::size_t num_discarded_ = 0;
+};
+
+} // namespace asmgrader
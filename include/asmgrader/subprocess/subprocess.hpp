@@ -4,6 +4,8 @@
 #include <asmgrader/common/error_types.hpp>
 #include <asmgrader/common/expected.hpp>
 #include <asmgrader/common/linux.hpp>
+#include <asmgrader/subprocess/output_buffer.hpp>
+#include <asmgrader/subprocess/stdin_pump.hpp>
 
 #include <chrono>
 #include <cstddef>
@@ -18,6 +20,8 @@
 
 namespace asmgrader {
 
+class ProcessReaper;
+
 class Subprocess : NonCopyable
 {
 public:
@@ -28,18 +32,38 @@ public:
     Subprocess(Subprocess&&) noexcept;
     Subprocess& operator=(Subprocess&&) noexcept;
 
+    /// Configure how stdout is captured. Discards any stdout captured so far; the pipe size takes
+    /// effect upon the next \ref start or \ref restart.
+    void set_stdout_capture(const OutputCaptureOptions& options);
+
+    /// Get any **new** stdout since the last read, waiting up to `timeout` for some to arrive
+    /// The result is only valid until stdout is next read (by any means).
     template <typename Rep, typename Period>
-    Result<std::string> read_stdout(const std::chrono::duration<Rep, Period>& timeout) {
+    Result<std::string_view> read_stdout(const std::chrono::duration<Rep, Period>& timeout) {
         return read_stdout_poll_impl(std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count());
     }
 
-    Result<std::string> read_stdout();
+    /// Get any **new** stdout since the last read
+    /// The result is only valid until stdout is next read (by any means).
+    Result<std::string_view> read_stdout();
+
+    /// Get all stdout since the program has launched, subject to the capture capacity
+    /// The result is only valid until stdout is next read (by any means).
+    std::string_view get_full_stdout();
 
-    /// Get all stdout since the program has launched
-    const std::string& get_full_stdout();
+    /// The captured stdout, without reading any more from the pipe
+    OutputBuffer& get_stdout_buffer() { return stdout_buffer_; }
 
+    const OutputBuffer& get_stdout_buffer() const { return stdout_buffer_; }
+
+    /// Queue `str` to be written to the child's stdin, writing as much as possible right away.
+    /// Never blocks; the remainder is written as the child reads (see \ref StdinPump).
     Result<void> send_stdin(std::string_view str);
 
+    StdinPump& get_stdin_pump() { return stdin_pump_; }
+
+    const StdinPump& get_stdin_pump() const { return stdin_pump_; }
+
     // Forks the current process to start a new subprocess as specified
     virtual Result<void> start();
 
@@ -58,32 +82,82 @@ public:
 
     pid_t get_pid() const { return child_pid_; }
 
+    /// A pidfd referring to the child, if it was spawned with one (see \ref SpawnMethod); -1 otherwise
+    int get_pidfd() const { return pidfd_; }
+
     std::optional<int> get_exit_code() const { return exit_code_; }
 
-    /// Manually kill subprocess with SIGKILL
+    /// Manually kill subprocess with SIGKILL, then reap it (see \ref set_reaper)
     virtual Result<void> kill();
 
+    /// Leave reaping killed children to `reaper` (which must outlive this object) instead of waiting on them,
+    /// or go back to waiting if nullptr
+    void set_reaper(ProcessReaper* reaper) { reaper_ = reaper; }
+
     virtual Result<void> restart();
 
 protected:
+    /// How \ref create obtains the child process
+    enum class SpawnMethod {
+        /// fork(2), then \ref init_child in the child before execve
+        Fork,
+        /// clone(2) with CLONE_VM | CLONE_VFORK | CLONE_PIDFD. The grader's page tables are not copied, and
+        /// the child only sets up its stdio before execve; \ref init_child is not run. Falls back to
+        /// \ref Fork if unsupported by the kernel.
+        Vfork,
+        /// As \ref Vfork, but the child also requests to be traced (PTRACE_TRACEME), and thus stops with
+        /// a SIGTRAP after execve
+        VforkTraced,
+    };
+
     // Allow derived classes to customize initialization
     Subprocess() = default;
+
+    virtual SpawnMethod get_spawn_method() const { return SpawnMethod::Vfork; }
     virtual Result<void> create(const std::string& exec, const std::vector<std::string>& args);
 
     virtual Result<void> init_child();
     virtual Result<void> init_parent();
 
+    /// Creates new pipes for the stdin and stdout of the next child process
+    Result<void> create_pipes();
+
+    /// For derived classes that obtain a child process by means other than \ref create
+    void set_child_pid(pid_t pid) { child_pid_ = pid; }
+
+    const linux::Pipe& get_stdin_pipe() const { return stdin_pipe_; }
+
+    const linux::Pipe& get_stdout_pipe() const { return stdout_pipe_; }
+
 private:
     pid_t child_pid_{};
     /// pipes to communicate with subprocess' stdout and stdin respectively
-    /// The parent process will only make use of the write end of stdin_pipe_, and the read end of stdout_pipe_
+    /// The parent process will only make use of the write end of stdin_pipe_, and the read end of stdout_pipe_.
+    /// The read end of stdin_pipe_ is also kept open, but only to discard unread input.
     linux::Pipe stdin_pipe_{};
     linux::Pipe stdout_pipe_{};
 
-    std::string stdout_buffer_;
-    std::size_t stdout_cursor_{};
+    StdinPump stdin_pump_;
+
+    OutputCaptureOptions stdout_capture_options_;
+    OutputBuffer stdout_buffer_{stdout_capture_options_.capacity, stdout_capture_options_.overflow};
+
+    /// Refers to the child, if obtained by \ref spawn; -1 otherwise
+    int pidfd_ = -1;
+
+    /// Whether the child has been sent SIGKILL by \ref kill
+    bool killed_ = false;
+
+    /// Not owned; see \ref set_reaper
+    ProcessReaper* reaper_ = nullptr;
+
+    /// Spawns the child as per \ref SpawnMethod::Vfork. Returns false if that's unsupported, in which case
+    /// no child was created.
+    Result<bool> spawn(const std::string& exec, const std::vector<std::string>& args, bool traced);
+
+    void close_pidfd();
 
-    Result<std::string> read_stdout_poll_impl(int timeout_ms);
+    Result<std::string_view> read_stdout_poll_impl(int timeout_ms);
 
     /// Reads any data on the stdout pipe to stdout_buffer_
     Result<void> read_stdout_impl();
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <asmgrader/common/aliases.hpp>
+#include <asmgrader/common/expected.hpp>
+#include <asmgrader/subprocess/syscall_record.hpp>
+#include <asmgrader/subprocess/tracer_options.hpp>
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace asmgrader {
+
+class SyscallRecordsView;
+
+/// Compact, append-only storage of \ref SyscallRecord%s
+///
+/// Fields are stored column-wise, so that each record costs a fixed number of bytes, regardless of
+/// its arguments. Arguments that were decoded upon syscall entry (see \ref TracerOptions::eagerly_decoded_syscalls)
+/// are serialized into a single bump-allocated arena, rather than held in many small allocations.
+///
+/// Optionally, the number of records may be capped; see \ref TracerOptions::syscall_log_capacity.
+class SyscallLog
+{
+public:
+    SyscallLog() = default;
+
+    /// `tracee_state` is attached to each record upon retrieval; see \ref SyscallRecord::args
+    SyscallLog(std::optional<std::size_t> capacity, SyscallLogOverflow overflow,
+               std::weak_ptr<const TraceeStopState> tracee_state);
+
+    /// Append a record of a syscall entry. The record's return value is ignored; see \ref set_last_ret.
+    void push(const SyscallRecord& record);
+
+    /// Whether the most recently pushed syscall has not yet had its return value set,
+    /// including if it was not kept due to the capacity
+    bool awaiting_ret() const { return awaiting_ret_; }
+
+    /// Set the return value of the most recently pushed syscall
+    void set_last_ret(const Expected<i64>& ret);
+
+    std::size_t size() const { return nums_.size(); }
+
+    bool empty() const { return size() == 0; }
+
+    /// Number of records that were discarded or overwritten due to the capacity
+    std::size_t num_dropped() const { return num_dropped_; }
+
+    /// Reconstruct the record at `idx`, where 0 is the oldest record kept
+    SyscallRecord at(std::size_t idx) const;
+
+    /// The syscall number of the record at `idx`, without reconstructing the entire record
+    u64 num_at(std::size_t idx) const { return nums_.at(physical_index(idx)); }
+
+    void clear();
+
+    SyscallRecordsView view() const;
+
+private:
+    static constexpr std::size_t NO_PAYLOAD = std::numeric_limits<std::size_t>::max();
+
+    enum class RetState : u8 { None, Value, Error };
+
+    std::size_t physical_index(std::size_t idx) const;
+
+    /// Index to write the next record to, evicting a record if necessary.
+    /// Returns nullopt if the record is to be dropped.
+    std::optional<std::size_t> next_slot();
+
+    /// Serializes the memory-backed arguments in `args` into arena_. Returns the offset of the payload.
+    std::size_t append_payload(u64 num, const std::vector<SyscallRecord::SyscallArg>& args);
+
+    /// Inverse of \ref append_payload
+    std::vector<SyscallRecord::SyscallArg> read_payload(std::size_t idx) const;
+
+    /// Drops payloads of evicted records from arena_, if they take up a sizable portion of it
+    void maybe_compact_arena();
+
+    std::optional<std::size_t> capacity_;
+    SyscallLogOverflow overflow_ = SyscallLogOverflow::DropNewest;
+    std::weak_ptr<const TraceeStopState> tracee_state_;
+
+    // Columns; one element per record kept
+    std::vector<u64> nums_;
+    std::vector<std::array<u64, 6>> raw_args_;
+    std::vector<i64> rets_;
+    std::vector<RetState> ret_states_;
+    std::vector<u64> instruction_pointers_;
+    std::vector<u64> stack_pointers_;
+    std::vector<u64> stop_ids_;
+    std::vector<std::size_t> payload_offsets_;
+    std::vector<std::size_t> payload_sizes_;
+
+    /// Bump-allocated serialized argument payloads
+    std::vector<char> arena_;
+    std::size_t live_payload_bytes_ = 0;
+
+    /// Physical index of the oldest record; only nonzero in ring mode after wrapping around
+    std::size_t head_ = 0;
+    std::optional<std::size_t> last_slot_;
+    bool awaiting_ret_ = false;
+    std::size_t num_dropped_ = 0;
+};
+
+/// Read-only, random-access view of a \ref SyscallLog, producing \ref SyscallRecord%s by value.
+/// Only valid for as long as the log is.
+class SyscallRecordsView
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using iterator_concept = std::random_access_iterator_tag;
+        using value_type = SyscallRecord;
+        using difference_type = std::ptrdiff_t;
+        using reference = SyscallRecord;
+
+        Iterator() = default;
+
+        Iterator(const SyscallLog* log, std::size_t idx)
+            : log_{log}
+            , idx_{idx} {}
+
+        SyscallRecord operator*() const { return log_->at(idx_); }
+
+        SyscallRecord operator[](difference_type offset) const { return *(*this + offset); }
+
+        Iterator& operator++() {
+            ++idx_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            auto tmp = *this;
+            ++idx_;
+            return tmp;
+        }
+
+        Iterator& operator--() {
+            --idx_;
+            return *this;
+        }
+
+        Iterator operator--(int) {
+            auto tmp = *this;
+            --idx_;
+            return tmp;
+        }
+
+        Iterator& operator+=(difference_type offset) {
+            idx_ = static_cast<std::size_t>(static_cast<difference_type>(idx_) + offset);
+            return *this;
+        }
+
+        Iterator& operator-=(difference_type offset) { return *this += -offset; }
+
+        friend Iterator operator+(Iterator iter, difference_type offset) { return iter += offset; }
+
+        friend Iterator operator+(difference_type offset, Iterator iter) { return iter += offset; }
+
+        friend Iterator operator-(Iterator iter, difference_type offset) { return iter -= offset; }
+
+        friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) {
+            return static_cast<difference_type>(lhs.idx_) - static_cast<difference_type>(rhs.idx_);
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) { return lhs.idx_ == rhs.idx_; }
+
+        friend auto operator<=>(const Iterator& lhs, const Iterator& rhs) { return lhs.idx_ <=> rhs.idx_; }
+
+    private:
+        const SyscallLog* log_{};
+        std::size_t idx_{};
+    };
+
+    explicit SyscallRecordsView(const SyscallLog& log)
+        : log_{&log} {}
+
+    std::size_t size() const { return log_->size(); }
+
+    bool empty() const { return log_->empty(); }
+
+    SyscallRecord at(std::size_t idx) const { return log_->at(idx); }
+
+    SyscallRecord operator[](std::size_t idx) const { return log_->at(idx); }
+
+    SyscallRecord front() const { return at(0); }
+
+    SyscallRecord back() const { return at(size() - 1); }
+
+    /// \see SyscallLog::num_dropped
+    std::size_t num_dropped() const { return log_->num_dropped(); }
+
+    Iterator begin() const { return {log_, 0}; }
+
+    Iterator end() const { return {log_, size()}; }
+
+private:
+    const SyscallLog* log_;
+};
+
+inline SyscallRecordsView SyscallLog::view() const {
+    return SyscallRecordsView{*this};
+}
+
+} // namespace asmgrader
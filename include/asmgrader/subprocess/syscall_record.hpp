@@ -9,7 +9,9 @@
 
 #include <fmt/base.h>
 
+#include <array>
 #include <ctime>
+#include <memory>
 #include <optional>
 #include <string>
 #include <variant>
@@ -17,6 +19,19 @@
 
 namespace asmgrader {
 
+class MemoryIOBase;
+
+/// The state of a tracer's tracee that is needed to decode syscall arguments after the fact.
+/// Shared between a \ref Tracer and the records it produces.
+struct TraceeStopState
+{
+    /// Memory of the tracee; only valid to use while it is stopped at stop `stop_id`
+    MemoryIOBase* memory_io{};
+
+    /// Incremented each time the tracee is resumed, as its memory may change thereafter
+    u64 stop_id{};
+};
+
 /// Record of a syscall for use with Tracer to keep track of which syscalls a child process invokes.
 struct SyscallRecord
 {
@@ -26,11 +41,38 @@ struct SyscallRecord
                                     void*, Result<std::timespec>>;
 
     u64 num;
-    std::vector<SyscallArg> args;
+
+    /// Raw values of the argument registers, in order. Not all are meaningful for every syscall.
+    std::array<u64, 6> raw_args;
+
     std::optional<Expected<i64>> ret;
 
     u64 instruction_pointer;
     u64 stack_pointer;
+
+    /// Stop of the tracee at which this syscall was entered; see \ref TraceeStopState
+    u64 stop_id;
+
+    /// Used to decode arguments that point to tracee memory
+    std::weak_ptr<const TraceeStopState> tracee_state;
+
+    /// Cache of \ref args. May be filled upon syscall entry, as per \ref TracerOptions::eagerly_decoded_syscalls
+    mutable std::optional<std::vector<SyscallArg>> decoded_args;
+
+    /// Arguments of the syscall, decoded as per its entry in \ref SYSCALL_MAP
+    ///
+    /// Decoding is done upon the first call. Integral and pointer arguments are always available.
+    /// Arguments that must be read from tracee memory (strings, timespecs, etc.) are only available if
+    /// the tracee is still stopped at this syscall, or if they were decoded upon entry. Otherwise, they
+    /// hold an error.
+    const std::vector<SyscallArg>& args() const;
+
+    /// Whether all arguments may be accurately decoded with \ref args
+    bool can_decode_args() const;
+
+    /// Decodes a raw syscall argument value of type `type`.
+    /// If `memory_io` is null, arguments that refer to tracee memory hold an error.
+    static SyscallArg decode_arg(u64 value, SyscallEntry::Type type, MemoryIOBase* memory_io);
 };
 
 #include <asmgrader/common/timespec_operator_eq.hpp> // IWYU pragma: keep; To permit default comparison of `SyscallRecord::SyscallArg`
@@ -45,7 +87,7 @@ struct fmt::formatter<::asmgrader::SyscallRecord> : ::asmgrader::DebugFormatter
         if (is_debug_format) {
             return fmt::format_to(ctx.out(),
                              "SyscallRecord{{.num = {} [SYS_{}], .args = {}, .ret = {}, .ip = 0x{:X}, .sp = 0x{:X}}}",
-                             from.num, ::asmgrader::SYSCALL_MAP.at(from.num).name(), from.args, from.ret,
+                             from.num, ::asmgrader::SYSCALL_MAP.at(from.num).name(), from.args(), from.ret,
                              from.instruction_pointer, from.stack_pointer);
         }
         UNIMPLEMENTED("Use debug format spec `{:?}` for SyscallRecord");
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <asmgrader/common/class_traits.hpp>
+#include <asmgrader/common/error_types.hpp>
+#include <asmgrader/subprocess/run_result.hpp>
+#include <asmgrader/subprocess/syscall_record.hpp>
+#include <asmgrader/subprocess/tracer.hpp>
+#include <asmgrader/subprocess/tracer_options.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace asmgrader {
+
+/// Drives the runs of many tracees at once, all on a single thread
+///
+/// Each run is advanced by its own \ref Tracer (see \ref Tracer::start_run), so syscalls are recorded and CPU time
+/// limits are enforced just as for \ref Tracer::run_until. The loop merely waits on every tracee at once and
+/// dispatches each state change to the right tracer. A run's callback may start another run, of the same tracee
+/// or of any other, which makes for a state machine per tracee without a thread per tracee.
+///
+/// As ptrace(2) only permits the thread that began tracing a tracee to operate on it, every tracee must have been
+/// started on the thread that uses the loop.
+class TraceLoop : NonMovable
+{
+public:
+    using Callback = std::function<void(Result<RunResult>)>;
+
+    TraceLoop() = default;
+
+    /// Starts a run of the tracee of `tracer`, calling `on_done` with its result once it's over.
+    /// `tracer` must outlive the run. \see Tracer::start_run
+    Result<void> start(Tracer& tracer, Callback on_done, std::function<bool(SyscallRecord)> pred = {},
+                       TracingPolicy policy = TracingPolicy::Filtered);
+
+    /// Waits for up to `timeout` on the tracees of all runs in flight, handling every state change.
+    /// Returns the number of runs that are over, whose callbacks have been called by then.
+    std::size_t poll(std::chrono::nanoseconds timeout);
+
+    /// Drives every run (including those started by callbacks in the meantime) until all are over
+    void run();
+
+    std::size_t num_in_flight() const { return runs_.size(); }
+
+private:
+    struct Run
+    {
+        Tracer* tracer;
+        Callback on_done;
+    };
+
+    std::vector<Run> runs_;
+
+    /// Scratch space for the pids of runs_, kept to avoid an allocation per poll
+    std::vector<pid_t> pids_;
+};
+
+} // namespace asmgrader
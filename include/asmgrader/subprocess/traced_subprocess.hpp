@@ -5,18 +5,37 @@
 #include <asmgrader/subprocess/subprocess.hpp>
 #include <asmgrader/subprocess/syscall_record.hpp>
 #include <asmgrader/subprocess/tracer.hpp>
+#include <asmgrader/subprocess/tracer_options.hpp>
 
 #include <chrono>
 #include <functional>
 #include <optional>
+#include <string>
+#include <vector>
 
 namespace asmgrader {
 
+class ForkServer;
+
+/// What \ref TracedSubprocess does upon destruction with a child that is still alive
+enum class TeardownPolicy {
+    /// SIGKILL the child right away, unless it is about to exit anyways (see \ref Tracer::will_exit_when_resumed)
+    Kill,
+    /// Let the child run to completion, within its CPU time limits and with its stdin closed, before resorting to
+    /// \ref Kill
+    Drain,
+};
+
 /// A subprocess managed by a tracer
 class TracedSubprocess : public Subprocess
 {
 public:
-    using Subprocess::Subprocess;
+    /// \see Subprocess::Subprocess
+    explicit TracedSubprocess(std::string exec, std::vector<std::string> args, TracerOptions options = {});
+
+    /// Obtains the child process by forking the pristine tracee of `fork_server`, rather than by
+    /// a fresh fork+exec. `fork_server` must be started, and must outlive this object.
+    explicit TracedSubprocess(ForkServer& fork_server);
 
     ~TracedSubprocess() override;
 
@@ -25,21 +44,48 @@ public:
     const Tracer& get_tracer() const { return tracer_; }
 
     /// \see Tracer::run
-    Result<RunResult> run();
+    Result<RunResult> run(TracingPolicy policy = TracingPolicy::Filtered);
 
     /// \see Tracer::run
-    Result<RunResult> run_until(const std::function<bool(SyscallRecord)>& pred);
+    Result<RunResult> run_until(const std::function<bool(SyscallRecord)>& pred,
+                                TracingPolicy policy = TracingPolicy::Filtered);
+
+    /// Restores the process to its state directly after startup
+    ///
+    /// This is done in place from the tracer's checkpoint if possible (see \ref Tracer::restore_checkpoint),
+    /// with any unread stdin discarded. Otherwise, the process is killed and started anew.
+    Result<void> restart() override;
 
     /// Blocks until exit or timeout
     Result<int> wait_for_exit(std::chrono::microseconds timeout) override;
 
     std::optional<int> get_exit_code() const { return tracer_.get_exit_code(); }
 
+    void set_teardown_policy(TeardownPolicy policy) { teardown_policy_ = policy; }
+
+protected:
+    Result<void> create(const std::string& exec, const std::vector<std::string>& args) override;
+
+    /// Spawns without a fork unless the tracer must set up the child itself (see \ref Tracer::requires_init_child)
+    SpawnMethod get_spawn_method() const override {
+        return tracer_.requires_init_child() ? SpawnMethod::Fork : SpawnMethod::VforkTraced;
+    }
+
 private:
     Result<void> init_child() final;
     Result<void> init_parent() final;
 
+    /// Checkpoint the freshly started process, for use by \ref restart
+    void checkpoint_startup_state();
+
+    /// Discards any input queued for or unread from the child's stdin; see \ref StdinPump::discard
+    Result<void> discard_pending_stdin();
+
     Tracer tracer_;
+
+    ForkServer* fork_server_{};
+
+    TeardownPolicy teardown_policy_ = TeardownPolicy::Kill;
 };
 
 } // namespace asmgrader
@@ -7,9 +7,15 @@
 #include <asmgrader/meta/tuple_matcher.hpp>
 #include <asmgrader/subprocess/memory/concepts.hpp>
 #include <asmgrader/subprocess/memory/memory_io.hpp>
+#include <asmgrader/subprocess/memory/memory_snapshot.hpp>
+#include <asmgrader/subprocess/memory/shared_region.hpp>
+#include <asmgrader/subprocess/memory/tracee_heap.hpp>
 #include <asmgrader/subprocess/run_result.hpp>
+#include <asmgrader/subprocess/seccomp_filter.hpp>
 #include <asmgrader/subprocess/syscall.hpp>
+#include <asmgrader/subprocess/syscall_log.hpp>
 #include <asmgrader/subprocess/syscall_record.hpp>
+#include <asmgrader/subprocess/tracer_options.hpp>
 #include <asmgrader/subprocess/tracer_types.hpp>
 
 #include <fmt/format.h>
@@ -24,6 +30,7 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <string>
 #include <tuple>
 #include <type_traits>
 #include <variant>
@@ -36,6 +43,14 @@
 
 namespace asmgrader {
 
+class OutputBuffer;
+class SharedMemoryIO;
+class StdinPump;
+
+namespace linux {
+struct Pipe;
+} // namespace linux
+
 // HACK: Temporary fix for aarch64
 #ifdef __aarch64__
 using user_fpregs_struct = user_fpsimd_struct;
@@ -44,7 +59,8 @@ using user_fpregs_struct = user_fpsimd_struct;
 /// A lightweight wrapper of ptrace(2)
 ///
 /// Instantiate and use this class in the parent process to trace a child.
-/// In the child process, call Tracer::init_child.
+/// In the child process, call Tracer::init_child (or, if \ref requires_init_child is false, merely
+/// request to be traced with PTRACE_TRACEME).
 class Tracer
 {
 public:
@@ -52,12 +68,50 @@ public:
 
     Tracer() = default;
 
+    explicit Tracer(TracerOptions options);
+
     /// Sets up tracing in parent process, then stops child immediately after exec call
+    ///
+    /// The child must either be stopped by \ref init_child, or have requested to be traced with PTRACE_TRACEME
+    /// before exec (thus stopping with a SIGTRAP after it). The latter is only allowed if
+    /// \ref requires_init_child is false.
     Result<void> begin(pid_t pid);
 
-    /// Run the child process. Records each syscall execution.
-    /// Equivalent to \ref run_until({})
-    Result<RunResult> run();
+    /// Sets up tracing of a tracee that was forked from the tracee of `parent` with \ref fork_tracee
+    ///
+    /// Unlike \ref begin, the process is already stopped after exec, with the same state as the parent.
+    Result<void> begin_forked(pid_t pid, const Tracer& parent);
+
+    /// Forks the stopped tracee, producing an identical copy of it, which is stopped and traced by this process
+    ///
+    /// The new process is a child of *this* process (not of the tracee), and has inherited the tracee's
+    /// file descriptors. Pass the result to \ref begin_forked of a new Tracer to take control of it.
+    Result<pid_t> fork_tracee();
+
+    /// Replaces file descriptor `target_fd` in the stopped tracee with `path` opened with `flags`
+    ///
+    /// Implemented by injecting openat, dup3 and close syscalls.
+    Result<void> redirect_fd(int target_fd, const std::string& path, int flags);
+
+    /// Records the registers and the contents of all writable mappings of the stopped tracee, other than the
+    /// heap (see \ref allocate), to later be restored by \ref restore_checkpoint. Replaces any previous checkpoint.
+    Result<void> checkpoint();
+
+    /// Restores the tracee in place to the state recorded by the last \ref checkpoint
+    ///
+    /// If the tracee is stopped at the entry to a syscall (e.g., exit(2)), that syscall is skipped.
+    /// Only memory that was modified since the checkpoint is written back. Note that kernel-side state,
+    /// such as file descriptors, is *not* restored.
+    ///
+    /// Fails if there is no checkpoint, or if the tracee's mappings have changed such that the
+    /// checkpoint may not be restored in place. See \ref MemorySnapshot::restore
+    Result<void> restore_checkpoint();
+
+    bool has_checkpoint() const { return checkpoint_.has_value(); }
+
+    /// Run the child process. Records each syscall execution selected by `policy`.
+    /// Equivalent to \ref run_until({}, policy)
+    Result<RunResult> run(TracingPolicy policy = TracingPolicy::Filtered);
 
     /// Run the child process until pred returns true.
     ///
@@ -69,36 +123,132 @@ public:
     /// It is valid to pass an empty pred value. This is equivalent to passing a predicate that
     /// always returns true, and also equivalent to a call to \ref run. \ref run should always be
     /// preferred, however.
-    Result<RunResult> run_until(const std::function<bool(SyscallRecord)>& pred);
+    ///
+    /// Only syscalls selected by `policy` are recorded and passed to pred. \see TracingPolicy
+    Result<RunResult> run_until(const std::function<bool(SyscallRecord)>& pred,
+                                TracingPolicy policy = TracingPolicy::Filtered);
+
+    /// Starts a run of the tracee like \ref run_until, but without waiting for it to finish, so that a single
+    /// thread may drive the runs of many tracees at once (see \ref TraceLoop)
+    ///
+    /// The run is then advanced with \ref tick_run and \ref handle_stop until it's over. As with every other
+    /// ptrace operation, these must be called from the thread that began tracing.
+    Result<void> start_run(std::function<bool(SyscallRecord)> pred, TracingPolicy policy = TracingPolicy::Filtered);
+
+    /// Feeds queued stdin to the tracee of the run in progress, and enforces its CPU time limits
+    ///
+    /// Returns the longest time to wait on the tracee before this should be called again. Once a limit is
+    /// exceeded, the tracee is stopped, the run is over, and this fails with ErrorKind::TimedOut, or with
+    /// ErrorKind::Blocked if the tracee was blocked for longer than \ref CpuTimeLimits::max_blocked.
+    Result<std::chrono::nanoseconds> tick_run();
+
+    /// Handles a state change of the tracee during the run in progress, resuming the tracee unless the run is over
+    ///
+    /// Returns the result of the run once it is over, or nullopt if it goes on.
+    std::optional<Result<RunResult>> handle_stop(const TracedWaitid& waitid_data);
+
+    /// Whether a run was started with \ref start_run and is not yet over
+    bool is_running() const { return active_run_.has_value(); }
+
+    pid_t get_pid() const { return pid_; }
 
     /// Executes a syscall with the given arguments as the stopped tracee
+    ///
+    /// Once the trampoline is installed, the syscall instruction there is used, and the tracee's own
+    /// code is left untouched. Registers are restored afterwards.
     Result<SyscallRecord> execute_syscall(u64 sys_nr, std::array<std::uint64_t, 6> args);
 
     /// Get the general purpose registers of the stopped tracee
     /// IMPORTANT: this is (obviously) architecture-dependent
+    ///
+    /// Registers are only read from the kernel once per stop of the tracee
     Result<user_regs_struct> get_registers() const;
     Result<user_fpregs_struct> get_fp_registers() const;
 
     /// Set the general purpose registers of the stopped tracee
     /// IMPORTANT: this is (obviously) architecture-dependent
+    ///
+    /// Registers are only written to the kernel once, right before the tracee is resumed
     Result<void> set_registers(user_regs_struct regs) const;
     Result<void> set_fp_registers(user_fpregs_struct regs) const;
 
+    /// Allocates a block of at least `size` bytes of tracee memory, mapping more memory into the tracee if needed
+    ///
+    /// Allocations remain valid, with their contents intact, across \ref restore_checkpoint. They also remain valid
+    /// across restarts of the tracee, which remap the heap's memory at the same addresses (with zeroed contents),
+    /// unless that proves impossible.
+    ///
+    /// Memory shared with the grader (see \ref TracerOptions::shared_heap_size) is handed out first.
+    Result<TraceeAllocation> allocate(std::size_t size);
+
+    TraceeHeap& get_heap() { return *heap_; }
+
     /// Obtain records of syscalls run so far in the child process
-    const std::vector<SyscallRecord>& get_records() const { return syscall_records_; }
+    ///
+    /// Note that records may be dropped as per \ref TracerOptions::syscall_log_capacity
+    SyscallRecordsView get_records() const { return syscall_log_.view(); }
 
     /// Obtain the process exit code, or nullopt if the process has not yet exited
     std::optional<int> get_exit_code() const { return exit_code_; }
 
+    /// Whether the tracee is stopped upon entry to exit(2) or exit_group(2), and thus will exit if resumed
+    bool will_exit_when_resumed() const;
+
+    /// Replaces the limits given by \ref TracerOptions::cpu_time_limits, such as for a single test
+    void set_cpu_time_limits(const CpuTimeLimits& limits) { options_.cpu_time_limits = limits; }
+
+    const CpuTimeLimits& get_cpu_time_limits() const { return options_.cpu_time_limits; }
+
+    /// Whether any run has exceeded the CPU time limits (or been blocked for too long), of any tracee since
+    /// construction. Such a run fails with ErrorKind::TimedOut (or ErrorKind::Blocked), which a test may well treat
+    /// as just a failure.
+    bool has_timed_out() const { return has_timed_out_; }
+
+    /// CPU time used by the tracee since \ref begin (or \ref begin_forked)
+    Result<std::chrono::nanoseconds> get_cpu_time_used() const;
+
+    /// Feed queued input to the tracee's stdin while waiting on it to stop, so that input larger than the pipe
+    /// can be delivered without the grader blocking. `pump` is not owned, and may be nullptr to stop.
+    void set_stdin_pump(StdinPump* pump) { stdin_pump_ = pump; }
+
+    /// Drain the tracee's stdout into `buffer` from the read end of `pipe` (if open) while waiting on it to stop, so
+    /// that a tracee printing more than the pipe holds doesn't block on writing, and the capacity of `buffer` applies.
+    /// Neither is owned, and both may be nullptr to stop. The pipe is looked up anew each time, as it may be replaced.
+    void set_stdout_buffer(OutputBuffer* buffer, const linux::Pipe* pipe) {
+        stdout_buffer_ = buffer;
+        stdout_pipe_ = pipe;
+    }
+
     /// Set up child process for tracing
     /// Call this within the newly-forked process
     ///
     /// Immediately after a call to this function should be a call to execve.
-    static Result<void> init_child();
+    Result<void> init_child() const;
+
+    /// Whether the child must run \ref init_child, rather than just PTRACE_TRACEME, before exec.
+    /// This is the case if a seccomp filter is to be installed (see \ref TracerOptions::traced_syscalls).
+    bool requires_init_child() const { return seccomp_filter_.has_value(); }
+
+    /// Maximum number of arguments per call of \ref setup_batch_call
+    constexpr static std::size_t BATCH_CALL_MAX_ARGS = 6;
+
+    /// Number of 8-byte words in each entry of a batch call table: the arguments, then the return value
+    constexpr static std::size_t BATCH_CALL_ENTRY_WORDS = BATCH_CALL_MAX_ARGS + 1;
+
+    /// Sets up the tracee such that, upon being resumed, it calls the function at `fn_addr` once for each
+    /// of the `num_calls` entries of the table at `table_addr` (see \ref BATCH_CALL_ENTRY_WORDS), passing the
+    /// entry's words as integer arguments and storing the return value in the entry. Once all calls are done,
+    /// a SIGTRAP is raised.
+    ///
+    /// Loop state is kept in the trampoline rather than in registers, so it survives functions that clobber
+    /// callee-saved registers.
+    Result<void> setup_batch_call(std::uintptr_t fn_addr, std::uintptr_t table_addr, std::size_t num_calls);
 
     /// Set the child process's instruction pointer to `address`
     Result<void> jump_to(std::uintptr_t address);
 
+    /// Wall-clock timeout for the tracee to reach stops that we cause ourselves, such as those of an injected syscall.
+    /// Running the tracee's own code is instead subject to \ref CpuTimeLimits.
     static constexpr auto DEFAULT_TIMEOUT = std::chrono::milliseconds{10};
 
     template <typename... Args>
@@ -113,6 +263,8 @@ public:
 
     MemoryIOBase& get_memory_io();
 
+    const TracerOptions& get_options() const { return options_; }
+
     std::uintptr_t get_mmapped_addr() const { return mmaped_address_; }
 
 private:
@@ -126,6 +278,78 @@ private:
 
     Result<void> setup_function_return();
 
+    /// Layout of the trampoline at the start of the mmapped page; see \ref install_trampoline
+    constexpr static std::size_t TRAMPOLINE_SYSCALL_OFFSET = 0;
+    constexpr static std::size_t TRAMPOLINE_RETURN_OFFSET = 16;
+    constexpr static std::size_t TRAMPOLINE_BATCH_STATE_OFFSET = 32;
+    constexpr static std::size_t TRAMPOLINE_BATCH_LOOP_OFFSET = 64;
+    constexpr static std::size_t TRAMPOLINE_SIZE = 256;
+
+    /// Writes code gadgets to the start of the mmapped page, once per tracee:
+    ///   a syscall instruction, used by \ref execute_syscall
+    ///   a breakpoint, used as the return address of called functions
+    ///   a loop calling a function for each entry of a table, used by \ref setup_batch_call
+    /// The rest of the trampoline is padded with breakpoints. Arguments written to the mmapped
+    /// page are placed after the trampoline.
+    Result<void> install_trampoline();
+
+    /// Options to set with PTRACE_SETOPTIONS for a tracee
+    int get_ptrace_options() const;
+
+    /// Create memory_io_ for the current tracee, which must have already exec'd
+    Result<void> init_memory_io();
+
+    /// Obtain the CPU-time clock of the current tracee, and start measuring from now
+    Result<void> init_cpu_clock();
+
+    /// Waits for a state change of the tracee of the run in progress, for as long as it's within the CPU time limits
+    ///
+    /// Returns ErrorKind::TimedOut once a limit is exceeded, or ErrorKind::Blocked once the tracee has been blocked
+    /// for too long.
+    Result<TracedWaitid> wait_within_cpu_limits();
+
+    /// Resumes the tracee of the run in progress until its next stop
+    Result<void> resume_run();
+
+    /// A register set of the stopped tracee; empty if it has not been read since the last resume
+    template <typename Regs>
+    struct RegisterCache
+    {
+        std::optional<Regs> regs;
+        bool dirty = false;
+    };
+
+    template <typename Regs>
+    Result<Regs> get_cached_regset(RegisterCache<Regs>& cache, int regset) const;
+
+    template <typename Regs>
+    Result<void> flush_regset(RegisterCache<Regs>& cache, int regset) const;
+
+    /// Writes back modified registers, then invalidates the register caches.
+    /// Must be called right before resuming the tracee.
+    Result<void> flush_registers() const;
+
+    /// Injects `sys_nr`, failing with SyscallFailure if the syscall itself fails
+    Result<i64> execute_checked_syscall(u64 sys_nr, std::array<std::uint64_t, 6> args);
+
+    /// Maps shared_region_ into the tracee and adds it to the heap, if enabled by the options
+    ///
+    /// The previous address of the region is preferred. If `replace_address` is set, the region
+    /// is instead mapped over whatever is at that address, such as a forked tracee's copy of its
+    /// parent's region.
+    Result<void> map_shared_region(std::optional<std::uintptr_t> replace_address = std::nullopt);
+
+    /// The memory of the heap's arenas, which checkpoints leave alone
+    std::vector<MemorySnapshot::Range> get_heap_ranges() const;
+
+    /// Maps the heap's private arenas into the tracee at their previous addresses. If that is not possible,
+    /// the heap is emptied, and existing allocations are abandoned.
+    Result<void> map_heap_arenas();
+
+    /// If the tracee is stopped at a syscall entry, prevents that syscall from executing
+    /// and resumes the tracee until the corresponding syscall exit stop
+    Result<void> skip_pending_syscall();
+
     /// Returns: value that should be written to the nth register
     template <typename Arg>
     Result<u64> setup_function_param(const Arg& arg);
@@ -149,24 +373,100 @@ private:
 
     /// Precondition: child process must be stopped after waitid(2) returned a syscall trap event
     SyscallRecord get_syscall_entry_info(struct ptrace_syscall_info* entry) const;
-    void get_syscall_exit_info(SyscallRecord& rec, struct ptrace_syscall_info* exit) const;
+    Expected<i64> get_syscall_exit_info(struct ptrace_syscall_info* exit) const;
 
-    // template <typename T>
-    // T from_raw_value(u64 value) const;
-
-    SyscallRecord::SyscallArg from_syscall_value(u64 value, SyscallEntry::Type type) const;
+    /// Whether arguments of syscall `nr` are to be decoded upon entry; see \ref TracerOptions::syscall_arg_decoding
+    bool should_decode_eagerly(u64 nr) const;
 
     pid_t pid_ = -1;
 
+    TracerOptions options_;
+
+    /// Present iff options_.traced_syscalls is set
+    std::optional<SeccompTraceFilter> seccomp_filter_;
+
+    /// Whether seccomp_filter_ is in effect in the tracee. If so, the tracee is resumed with
+    /// PTRACE_CONT rather than PTRACE_SYSCALL while running.
+    bool seccomp_active_ = false;
+
     std::unique_ptr<MemoryIOBase> memory_io_;
 
-    std::vector<SyscallRecord> syscall_records_;
+    /// memory_io_, if it is a \ref SharedMemoryIO
+    SharedMemoryIO* shared_memory_io_ = nullptr;
+
+    /// Shared with every record in syscall_log_. Must be updated whenever memory_io_ changes or the tracee resumes.
+    std::shared_ptr<TraceeStopState> stop_state_ = std::make_shared<TraceeStopState>();
+
+    SyscallLog syscall_log_{options_.syscall_log_capacity, options_.syscall_log_overflow, stop_state_};
 
     std::optional<int> exit_code_;
 
+    /// State of the run started by \ref start_run
+    struct ActiveRun
+    {
+        std::function<bool(SyscallRecord)> pred;
+        TracingPolicy policy;
+
+        /// Whether the tracee must stop at the entry and exit of every syscall, as opposed to only for those
+        /// selected by the seccomp filter (if any)
+        bool stop_at_syscalls;
+
+        /// Whether the tracee is stopped for a syscall selected by the seccomp filter, whose exit we need to see
+        bool awaiting_syscall_exit;
+
+        /// Whether the entry of the syscall being run was not traced, and thus neither should its exit be
+        bool skipped_syscall_entry = false;
+
+        /// CPU time used (as per \ref get_cpu_time_used) when the run began, and as of the last \ref tick_run
+        std::chrono::nanoseconds cpu_start;
+        std::chrono::nanoseconds cpu_used;
+
+        /// Wall-clock time of the last check of whether the tracee is blocked, and since when it has been
+        std::chrono::steady_clock::time_point last_blocked_check;
+        std::optional<std::chrono::steady_clock::time_point> blocked_since;
+    };
+
+    std::optional<ActiveRun> active_run_;
+
+    /// See \ref has_timed_out
+    bool has_timed_out_ = false;
+
+    /// CPU-time clock of the tracee, and its reading when tracing began
+    clockid_t cpu_clock_{};
+    std::chrono::nanoseconds cpu_time_at_begin_{};
+
+    /// Not owned; see \ref set_stdin_pump
+    StdinPump* stdin_pump_ = nullptr;
+
+    /// Not owned; see \ref set_stdout_buffer
+    OutputBuffer* stdout_buffer_ = nullptr;
+    const linux::Pipe* stdout_pipe_ = nullptr;
+
+    mutable RegisterCache<user_regs_struct> regs_cache_;
+    mutable RegisterCache<user_fpregs_struct> fp_regs_cache_;
+
+    struct Checkpoint
+    {
+        user_regs_struct regs;
+        user_fpregs_struct fp_regs;
+        MemorySnapshot memory;
+    };
+
+    std::optional<Checkpoint> checkpoint_;
+
+    /// Shared with every allocation handle given out by \ref allocate
+    std::shared_ptr<TraceeHeap> heap_ = std::make_shared<TraceeHeap>();
+
+    /// Memory shared with the tracee; empty unless options_.shared_heap_size is nonzero
+    SharedRegion shared_region_;
+
+    /// Address of shared_region_ in the tracee, or 0 if not mapped
+    std::uintptr_t shared_address_{};
+
     std::size_t mmaped_address_{};
 
-    std::size_t mmaped_used_amt_{};
+    /// Offset of the first unused byte of the mmapped page; always past the trampoline
+    std::size_t mmaped_used_amt_ = TRAMPOLINE_SIZE;
 };
 
 template <typename... Args>
@@ -184,14 +484,18 @@ Result<void> Tracer::setup_function_call(Args&&... args) {
 
     // reset the amount of memory we've "used" in the mmaped section,
     // as we're preparing to enter a new function call
-    mmaped_used_amt_ = 0;
+    mmaped_used_amt_ = TRAMPOLINE_SIZE;
 
     // prepare return location
     TRY(setup_function_return());
 
     // prepare arguments
     user_regs_struct int_regs = TRY(get_registers());
-    user_fpregs_struct fp_regs = TRY(get_fp_registers());
+    // Avoid reading (and later writing back) the floating-point registers if they are unneeded
+    user_fpregs_struct fp_regs{};
+    if constexpr (NUM_FP_ARGS > 0) {
+        fp_regs = TRY(get_fp_registers());
+    }
 
     // unused in the case that there are no function arguments
     [[maybe_unused]] auto setup_raw_arg = [&, num_fp = 0, num_int = 0]<typename T>(T arg) mutable {
@@ -245,7 +549,9 @@ Result<void> Tracer::setup_function_call(Args&&... args) {
         std::apply([&](const auto&... vals) { (setup_raw_arg(*vals), ...); }, reg_param_vals);
 
         TRY(set_registers(int_regs));
-        TRY(set_fp_registers(fp_regs));
+        if constexpr (NUM_FP_ARGS > 0) {
+            TRY(set_fp_registers(fp_regs));
+        }
     }
 
     return {};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <asmgrader/common/aliases.hpp>
+#include <asmgrader/common/extra_formatters.hpp>
+#include <asmgrader/common/formatters/macros.hpp>
+
+#include <fmt/chrono.h>
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace asmgrader {
+
+/// Mechanism used by \ref Tracer to access the memory of the tracee
+enum class MemoryIOKind {
+    Auto,      ///< Probe the system upon the first \ref Tracer::begin and use the fastest available mechanism
+    Ptrace,    ///< PTRACE_PEEKTEXT / PTRACE_POKETEXT; one word per syscall. Always available.
+    ProcessVm, ///< process_vm_readv(2) / process_vm_writev(2), falling back to ptrace for protected pages
+    ProcMem,   ///< pread(2) / pwrite(2) on /proc/<pid>/mem. Able to write to protected pages.
+};
+
+/// Strategy for waiting on tracee state changes before sleeping until the next SIGCHLD
+enum class WaitSpin {
+    None,     ///< Never spin; always sleep until the next SIGCHLD
+    Adaptive, ///< Spin for a short time if recent waits on the calling thread have completed quickly
+};
+
+/// When \ref Tracer reads syscall arguments that refer to tracee memory (strings, timespecs, etc.)
+enum class SyscallArgDecoding {
+    Lazy,  ///< Only upon request; see \ref SyscallRecord::args
+    Eager, ///< Upon entry to every syscall
+};
+
+/// What \ref Tracer does with new syscall records once \ref TracerOptions::syscall_log_capacity is reached
+enum class SyscallLogOverflow {
+    DropNewest, ///< Keep the oldest records; new records are discarded
+    Ring,       ///< Keep the newest records; the oldest record is discarded for each new one
+};
+
+/// Which syscalls \ref Tracer::run_until stops the tracee for, records and passes to its predicate
+///
+/// Fewer stops make for a faster run: a syscall that is stopped for costs two context switches on entry, and
+/// two more on exit. Regardless of the policy, the tracee always stops for signals (including breakpoints) and
+/// upon exiting.
+enum class TracingPolicy {
+    None,     ///< No syscalls; the tracee is resumed with PTRACE_CONT
+    ExitOnly, ///< Only exit(2) and exit_group(2). Without a seccomp filter, the tracee still stops at every syscall.
+    Filtered, ///< Syscalls selected by \ref TracerOptions::traced_syscalls, or every syscall if unset
+    Full,     ///< Every syscall, even those not selected by \ref TracerOptions::traced_syscalls
+};
+
+/// Limits on the CPU time used by the tracee, measured with its CPU-time clock (see clock_getcpuclockid(3))
+///
+/// Unlike a wall-clock timeout, time that the tracee spends runnable but descheduled (e.g., on a loaded
+/// system) does not count towards either limit.
+struct CpuTimeLimits
+{
+    static constexpr auto DEFAULT_PER_RUN = std::chrono::seconds{1};
+    static constexpr auto DEFAULT_MAX_BLOCKED = std::chrono::milliseconds{100};
+
+    /// CPU time allowed per \ref Tracer::run_until, e.g., per function call
+    std::chrono::nanoseconds per_run = DEFAULT_PER_RUN;
+
+    /// CPU time allowed since the tracee was started; unlimited if unset
+    std::optional<std::chrono::nanoseconds> total;
+
+    /// Wall-clock time the tracee may spend blocked in the kernel (e.g., reading from an empty stdin) during a
+    /// \ref Tracer::run_until, as it uses no CPU time while waiting on something that may never happen.
+    /// Time spent waiting on the grader to deliver stdin or drain stdout does not count.
+    std::chrono::nanoseconds max_blocked = DEFAULT_MAX_BLOCKED;
+};
+
+/// Configuration for a \ref Tracer, fixed for the lifetime of the tracee
+struct TracerOptions
+{
+    MemoryIOKind memory_io = MemoryIOKind::Auto;
+
+    WaitSpin wait_spin = WaitSpin::Adaptive;
+
+    /// If set, only these syscalls (along with exit and exit_group) cause the tracee to stop, by means of
+    /// a seccomp-BPF filter installed in the child. All other syscalls run at full speed, and are *not* recorded.
+    ///
+    /// If unset, every syscall is traced and recorded.
+    std::optional<std::vector<u64>> traced_syscalls;
+
+    SyscallArgDecoding syscall_arg_decoding = SyscallArgDecoding::Lazy;
+
+    /// Syscalls whose arguments are decoded upon entry regardless of \ref syscall_arg_decoding, for
+    /// when they are inspected after the tracee has been resumed
+    std::vector<u64> eagerly_decoded_syscalls;
+
+    /// Maximum number of syscall records to keep, bounding memory use for programs that loop on syscalls.
+    /// Unlimited if unset.
+    std::optional<std::size_t> syscall_log_capacity;
+
+    SyscallLogOverflow syscall_log_overflow = SyscallLogOverflow::DropNewest;
+
+    /// If nonzero, this many bytes of memory are shared between the grader and the tracee, from which
+    /// \ref Tracer::allocate hands out memory first. Accesses to it by the grader are plain memory
+    /// copies, rather than syscalls.
+    std::size_t shared_heap_size = 0;
+
+    /// May be changed later with \ref Tracer::set_cpu_time_limits
+    CpuTimeLimits cpu_time_limits;
+};
+
+} // namespace asmgrader
+
+FMT_SERIALIZE_ENUM(::asmgrader::MemoryIOKind, Auto, Ptrace, ProcessVm, ProcMem);
+FMT_SERIALIZE_ENUM(::asmgrader::WaitSpin, None, Adaptive);
+FMT_SERIALIZE_ENUM(::asmgrader::SyscallArgDecoding, Lazy, Eager);
+FMT_SERIALIZE_ENUM(::asmgrader::SyscallLogOverflow, DropNewest, Ring);
+FMT_SERIALIZE_ENUM(::asmgrader::TracingPolicy, None, ExitOnly, Filtered, Full);
+FMT_SERIALIZE_CLASS(::asmgrader::CpuTimeLimits, per_run, total, max_blocked);
+FMT_SERIALIZE_CLASS(::asmgrader::TracerOptions, memory_io, wait_spin, traced_syscalls, syscall_arg_decoding,
+                    eagerly_decoded_syscalls, syscall_log_capacity, syscall_log_overflow, shared_heap_size,
+                    cpu_time_limits);
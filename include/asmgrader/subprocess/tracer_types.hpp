@@ -9,6 +9,7 @@
 #include <asmgrader/common/extra_formatters.hpp>
 #include <asmgrader/common/linux.hpp>
 #include <asmgrader/logging.hpp>
+#include <asmgrader/subprocess/tracer_options.hpp>
 
 #include <fmt/base.h>
 #include <fmt/format.h>
@@ -18,7 +19,10 @@
 #include <chrono>
 #include <cstdlib>
 #include <optional>
+#include <span>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <bits/types/siginfo_t.h>
 #include <sched.h>
@@ -67,35 +71,24 @@ struct TracedWaitid
         return TracedWaitid::parse(res.value());
     }
 
-    template <ChronoDuration Duration1, ChronoDuration Duration2 = std::chrono::microseconds>
-    static Result<TracedWaitid> wait_with_timeout(pid_t pid, Duration1 timeout,
-                                                  Duration2 poll_period = std::chrono::microseconds{1}) {
-        using std::chrono::steady_clock;
-
-        ASSERT(timeout > poll_period);
-
-        const auto start_time = steady_clock::now();
-
-        // while elapsed time < timeout
-        while (steady_clock::now() - start_time < timeout) {
-            Expected<siginfo_t> waitid_res =
-                linux::waitid(P_PID, gsl::narrow_cast<id_t>(pid), WEXITED | WSTOPPED | WNOHANG);
-
-            ASSERT(waitid_res);
-
-            // si_pid will only be 0 if waitid returned early from WNOHANG
-            // see waitid(2)
-            if (waitid_res.value().si_pid != 0) {
-                return TracedWaitid::parse(waitid_res.value());
-            }
-
-            std::this_thread::sleep_for(poll_period);
-        }
-
-        LOG_DEBUG("waitid timed out at {}", timeout);
-        return ErrorKind::TimedOut;
+    /// Blocks until a state change of `pid` is available to waitid(2), or until `timeout` has passed
+    ///
+    /// Rather than sleep-polling, the caller optionally spins for a short while (see \ref WaitSpin), and then
+    /// sleeps until a SIGCHLD is received by the grader. Returns ErrorKind::TimedOut if no state change was
+    /// observed within `timeout`.
+    template <ChronoDuration Duration>
+    static Result<TracedWaitid> wait_with_timeout(pid_t pid, Duration timeout, WaitSpin spin = WaitSpin::Adaptive) {
+        return wait_with_timeout_impl(pid, std::chrono::duration_cast<std::chrono::nanoseconds>(timeout), spin);
     }
 
+    /// Blocks until a state change of any of `pids` is available to waitid(2), or until `timeout` has passed
+    ///
+    /// Every available state change is consumed and returned along with its pid. Unlike waitid(2) with P_ALL,
+    /// this leaves the state changes of any other children of the grader alone. Returns ErrorKind::TimedOut if
+    /// no state change was observed within `timeout`.
+    static Result<std::vector<std::pair<pid_t, TracedWaitid>>> wait_any_with_timeout(std::span<const pid_t> pids,
+                                                                                      std::chrono::nanoseconds timeout);
+
     constexpr static TracedWaitid parse(const siginfo_t& siginfo) {
         TracedWaitid result{};
         result.type = siginfo.si_code;
@@ -136,6 +129,9 @@ struct TracedWaitid
 
         return result;
     }
+
+private:
+    static Result<TracedWaitid> wait_with_timeout_impl(pid_t pid, std::chrono::nanoseconds timeout, WaitSpin spin);
 };
 
 } // namespace asmgrader
@@ -6,17 +6,16 @@
 #include "api/requirement.hpp"
 #include "api/test_base.hpp"
 #include "common/aliases.hpp"
-#include "common/bit_casts.hpp"
-#include "common/byte_array.hpp"
 #include "common/error_types.hpp"
 #include "common/macros.hpp"
-#include "common/unreachable.hpp"
 #include "exceptions.hpp"
 #include "grading_session.hpp"
 #include "logging.hpp"
 #include "program/program.hpp"
 #include "subprocess/run_result.hpp"
+#include "subprocess/syscall_log.hpp"
 #include "subprocess/syscall_record.hpp"
+#include "subprocess/tracer_options.hpp"
 
 #include <fmt/color.h>
 #include <fmt/format.h>
@@ -26,7 +25,6 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
-#include <ctime>
 #include <functional>
 #include <optional>
 #include <string>
@@ -34,7 +32,6 @@
 #include <utility>
 #include <vector>
 
-#include <sys/poll.h>
 #include <sys/syscall.h>
 #include <sys/user.h>
 #include <unistd.h>
@@ -80,11 +77,11 @@ std::string_view TestContext::get_name() const {
     return associated_test_->get_name();
 }
 
-std::string TestContext::get_stdout() {
+std::string_view TestContext::get_stdout() {
     return TRY_OR_THROW(prog_.get_subproc().read_stdout(), "failed to read stdout");
 }
 
-std::string TestContext::get_full_stdout() {
+std::string_view TestContext::get_full_stdout() {
     return prog_.get_subproc().get_full_stdout();
 }
 
@@ -95,13 +92,16 @@ void TestContext::send_stdin(std::string_view input) {
 RunResult TestContext::run() {
     int exit_code{};
 
-    auto res = prog_.run_until([&exit_code](const SyscallRecord& syscall) {
+    auto is_exit = [&exit_code](const SyscallRecord& syscall) {
         if (syscall.num == SYS_exit || syscall.num == SYS_exit_group) {
-            exit_code = std::get<int>(syscall.args.at(0));
+            exit_code = std::get<int>(syscall.args().at(0));
             return true;
         }
         return false;
-    });
+    };
+
+    // Every syscall is recorded for tests to inspect, even those the seccomp filter lets run freely
+    auto res = prog_.run_until(is_exit, TracingPolicy::Full);
 
     // We're at the entry to an invocation of exit(2) or exit_group(2) we know:
     //   the program is essentially over and cannot SEGFAULT
@@ -123,73 +123,20 @@ Result<SyscallRecord> TestContext::exec_syscall(u64 sys_nr, std::array<std::uint
     return prog_.get_subproc().get_tracer().execute_syscall(sys_nr, args);
 }
 
-const std::vector<SyscallRecord>& TestContext::get_syscall_records() const {
+SyscallRecordsView TestContext::get_syscall_records() const {
     return prog_.get_subproc().get_tracer().get_records();
 }
 
-std::size_t TestContext::flush_stdin() {
-#ifndef SYS_ppoll
-#warning "Your system does not support the `ppoll` syscall! TestContext::flush_stdin will not work!"
-    UNIMPLEMENTED("SYS_ppoll not defined!");
-#else
-    // HACK: This is inefficient for a single program, but will break if static when run for multiple program instances
-
-    // Buffer to send SYS_read output to
-    const AsmBuffer READ_BUFFER = create_buffer<32>();
-    // struct timespec buffer for ppoll
-    const AsmBuffer ZERO_TIMESPEC_BUFFER = create_buffer<sizeof(timespec)>();
-    // A fd_set with only STDIN for SYS_select
-    const AsmBuffer STDIN_ONLY_POLLFD_BUFFER = create_buffer<sizeof(pollfd)>();
-
-    ZERO_TIMESPEC_BUFFER.zero();
-
-    // Loop until we break due to SYS_select returning 0
-    for (std::size_t bytes_read = 0;;) {
-        pollfd pollfd_stdin_only{};
-        pollfd_stdin_only.fd = STDIN_FILENO;
-        pollfd_stdin_only.events = POLLIN; // poll only for new data available to be read
-
-        STDIN_ONLY_POLLFD_BUFFER.set_value(to_bytes<NativeByteArray>(pollfd_stdin_only));
-
-        // First check that stdin has any data to be read, so that we don't block
-        // see ppoll(2)
-        SyscallRecord ppoll_res = TRY_OR_THROW(exec_syscall(SYS_ppoll, {/*fds=*/STDIN_ONLY_POLLFD_BUFFER.get_address(),
-                                                                        /*nfds=*/nfds_t{1},
-                                                                        /*tmo_p=*/ZERO_TIMESPEC_BUFFER.get_address(),
-                                                                        /*sigmask=*/0}),
-                                               "failed to flush stdin");
-        if (!ppoll_res.ret.has_value() || ppoll_res.ret->has_error()) {
-            throw ContextInternalError{"failed to flush stdin"};
-        }
-
-        // 0 fds returned -> no bytes to be read
-        if (ppoll_res.ret == 0) {
-            LOG_DEBUG("flushed {} bytes from stdin", bytes_read);
-            return bytes_read;
-        }
-        //
-        // >0 (i.e. 1) fds returned -> there ARE bytes to be read!
-
-        SyscallRecord read_res = TRY_OR_THROW(exec_syscall(SYS_read, {
-                                                                         /*fd=*/STDIN_FILENO,
-                                                                         /*buf=*/READ_BUFFER.get_address(),
-                                                                         /*len=*/READ_BUFFER.size(),
-                                                                     }),
-                                              "failed to flush stdin");
-
-        if (!read_res.ret.has_value()) {
-            throw ContextInternalError{"failed to flush stdin"};
-        }
-
-        if (read_res.ret->has_error()) {
-            throw ContextInternalError{ErrorKind::SyscallFailure, "failed to flush stdin"};
-        }
+void TestContext::set_call_tracing_policy(TracingPolicy policy) {
+    prog_.set_call_tracing_policy(policy);
+}
 
-        bytes_read += gsl::narrow_cast<std::size_t>(read_res.ret->value());
-    }
+std::size_t TestContext::flush_stdin() {
+    return TRY_OR_THROW(prog_.get_subproc().get_stdin_pump().discard(), "failed to flush stdin");
+}
 
-    unreachable();
-#endif
+std::size_t TestContext::get_stdin_consumed() const {
+    return TRY_OR_THROW(prog_.get_subproc().get_stdin_pump().num_consumed(), "failed to query stdin");
 }
 
 RegistersState TestContext::get_registers() const {
@@ -11,9 +11,12 @@
 #include "output/stdout_sink.hpp"
 #include "output/verbosity.hpp"
 #include "registrars/global_registrar.hpp"
+#include "result_cache.hpp"
+#include "timing_db.hpp"
 #include "user/assignment_file_searcher.hpp"
 #include "user/program_options.hpp"
 
+#include <fmt/format.h>
 #include <gsl/util>
 #include <libassert/assert.hpp>
 #include <range/v3/algorithm/count_if.hpp>
@@ -23,11 +26,16 @@
 #include <range/v3/view/for_each.hpp>
 #include <range/v3/view/map.hpp>
 #include <range/v3/view/transform.hpp>
+#include <range/v3/view/zip.hpp>
 
+#include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace asmgrader {
@@ -71,12 +79,49 @@ int ProfessorApp::run_impl() {
     std::shared_ptr output_serializer =
         std::make_shared<PlainTextSerializer>(output_sink, OPTS.colorize_option, OPTS.verbosity);
 
-    MultiStudentRunner runner{*assignment, output_serializer, OPTS.tests_filter};
+    std::unique_ptr<ResultCache> cache = make_result_cache();
+    std::unique_ptr<TimingDb> timings = make_timing_db();
+
+    MultiStudentRunner runner{*assignment, output_serializer, OPTS.tests_filter, OPTS.get_cpu_time_limits(),
+                              OPTS.num_jobs, OPTS.output_order, OPTS.jobs_mode, OPTS.num_test_jobs, cache.get(),
+                              timings.get()};
+
+    // Made before the run, as its results change later predictions (both by being recorded and by being cached)
+    std::vector<std::chrono::milliseconds> predictions;
+    if (timings && OPTS.timing_report) {
+        predictions = runner.predict_durations(students);
+    }
 
     output_serializer->on_run_metadata(RunMetadata{});
 
     MultiStudentResult res = runner.run_all_students(students);
 
+    if (cache) {
+        CacheStats stats;
+
+        for (const StudentResult& student_res : res.results) {
+            for (const TestResult& test_res : student_res.result.test_results) {
+                ++(test_res.from_cache ? stats.hits : stats.misses);
+            }
+        }
+
+        output_serializer->on_cache_stats(stats);
+    }
+
+    if (timings) {
+        if (OPTS.timing_report) {
+            output_serializer->on_timing_report(make_timing_report(res, predictions));
+        }
+
+        for (const StudentResult& student_res : res.results) {
+            timings->record(student_res);
+        }
+
+        if (auto save_res = timings->save(); !save_res) {
+            LOG_WARN("Failed to save the timing database: {}", save_res.error());
+        }
+    }
+
     auto num_students_failed =
         ranges::count_if(res.results, [](const StudentResult& sres) { return !sres.result.all_passed(); });
 
@@ -87,6 +132,66 @@ int ProfessorApp::run_impl() {
     return EXIT_SUCCESS;
 }
 
+std::unique_ptr<ResultCache> ProfessorApp::make_result_cache() const {
+    const std::optional<std::filesystem::path> directory = ResultCache::default_directory();
+
+    if (!directory) {
+        LOG_WARN("Could not determine where to cache results; grading without a cache");
+        return nullptr;
+    }
+
+    auto cache = std::make_unique<ResultCache>(*directory);
+
+    if (OPTS.clear_cache) {
+        std::ignore = cache->clear();
+    }
+
+    if (!OPTS.use_cache) {
+        return nullptr;
+    }
+
+    return cache;
+}
+
+std::unique_ptr<TimingDb> ProfessorApp::make_timing_db() {
+    const std::optional<std::filesystem::path> path = TimingDb::default_path();
+
+    if (!path) {
+        LOG_WARN("Could not determine where to store grading times; scheduling students in the order found");
+        return nullptr;
+    }
+
+    auto timings = std::make_unique<TimingDb>(*path);
+
+    // A malformed database is just started over
+    std::ignore = timings->load();
+
+    return timings;
+}
+
+TimingReport ProfessorApp::make_timing_report(const MultiStudentResult& results,
+                                              const std::vector<std::chrono::milliseconds>& predictions) {
+    TimingReport report;
+
+    for (const auto& [student_res, predicted] : ranges::views::zip(results.results, predictions)) {
+        const StudentInfo& info = student_res.info;
+
+        // Students without a submission weren't graded at all
+        if (!info.assignment_path) {
+            continue;
+        }
+
+        // An inferred name is held in full by first_name
+        std::string name = info.names_known ? fmt::format("{} {}", info.first_name, info.last_name) : info.first_name;
+
+        report.entries.push_back({.student = std::move(name),
+                                  .predicted = predicted,
+                                  .actual = student_res.result.duration});
+    }
+
+    return report;
+}
+
 std::optional<std::vector<StudentInfo>> ProfessorApp::get_student_names() const {
     DatabaseReader database_reader{OPTS.database_path};
 
@@ -2,7 +2,11 @@
 
 #include "app/app.hpp" // IWYU pragma: export
 #include "grading_session.hpp"
+#include "result_cache.hpp"
+#include "timing_db.hpp"
 
+#include <chrono>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -17,6 +21,16 @@ private:
     int run_impl() override;
 
     std::optional<std::vector<StudentInfo>> get_student_names() const;
+
+    /// The cache of test results as per the options, or null if it's not to be used
+    std::unique_ptr<ResultCache> make_result_cache() const;
+
+    /// The history of grading times, loaded from disk, or null if there's nowhere to store it
+    static std::unique_ptr<TimingDb> make_timing_db();
+
+    /// Pairs the actual time taken to grade each student in `results` with the time `predictions` made before the run
+    static TimingReport make_timing_report(const MultiStudentResult& results,
+                                           const std::vector<std::chrono::milliseconds>& predictions);
 };
 
 } // namespace asmgrader
@@ -113,7 +113,8 @@ int StudentApp::run_impl() {
     StdoutSink output_sink;
     std::shared_ptr output_serializer =
         std::make_shared<PlainTextSerializer>(output_sink, OPTS.colorize_option, OPTS.verbosity);
-    AssignmentTestRunner runner{assignment, output_serializer, OPTS.tests_filter};
+    AssignmentTestRunner runner{assignment, output_serializer, OPTS.tests_filter, OPTS.get_cpu_time_limits(),
+                                OPTS.num_test_jobs};
 
     output_serializer->on_run_metadata(RunMetadata{});
     AssignmentResult res = runner.run_all(OPTS.file_name);
@@ -0,0 +1,57 @@
+#include "common/atomic_file.hpp"
+
+#include "common/aliases.hpp"
+#include "common/error_types.hpp"
+#include "logging.hpp"
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <string_view>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace asmgrader {
+
+Result<void> write_file_atomically(const std::filesystem::path& path, std::string_view bytes) {
+    // Makes the names of temporary files unique within this process
+    static std::atomic<u64> num_written{0};
+
+    std::error_code err;
+    std::filesystem::create_directories(path.parent_path(), err);
+
+    if (err) {
+        LOG_DEBUG("Failed to create directory for {:?}: {}", path.string(), err.message());
+        return ErrorKind::SyscallFailure;
+    }
+
+    std::filesystem::path tmp_path = path;
+    tmp_path += fmt::format(".{}.{}.tmp", ::getpid(), num_written++);
+
+    std::ofstream file{tmp_path, std::ios::binary | std::ios::trunc};
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    // Writes may be buffered until the file is closed, so only then are all errors known
+    file.close();
+
+    if (!file) {
+        LOG_DEBUG("Failed to write to {:?}", tmp_path.string());
+        std::filesystem::remove(tmp_path, err);
+        return ErrorKind::SyscallFailure;
+    }
+
+    std::filesystem::rename(tmp_path, path, err);
+
+    if (err) {
+        LOG_DEBUG("Failed to move {:?} into place at {:?}: {}", tmp_path.string(), path.string(), err.message());
+        std::filesystem::remove(tmp_path, err);
+        return ErrorKind::SyscallFailure;
+    }
+
+    return {};
+}
+
+} // namespace asmgrader
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "common/error_types.hpp"
+
+#include <filesystem>
+#include <string_view>
+
+namespace asmgrader {
+
+/// Writes `bytes` to a temporary file beside `path`, then renames it over `path`, so that nothing reading `path`
+/// (even in another process) ever sees a partially written file. Missing parent directories are created.
+Result<void> write_file_atomically(const std::filesystem::path& path, std::string_view bytes);
+
+} // namespace asmgrader
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace asmgrader {
+
+/// Runs `worker` on each of `num_threads` new threads, and waits for them all to finish
+///
+/// Each worker is passed a function claiming the next of the items [0, `num_items`), which returns nullopt once every
+/// item has been claimed. If a worker throws, the other workers are stopped early (i.e., can claim no more items) and
+/// the first exception is rethrown.
+template <typename Worker>
+void run_worker_threads(std::size_t num_threads, std::size_t num_items, Worker worker) {
+    std::atomic<std::size_t> next_item{0};
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    auto claim = [&]() -> std::optional<std::size_t> {
+        if (const std::size_t idx = next_item++; idx < num_items) {
+            return idx;
+        }
+
+        return std::nullopt;
+    };
+
+    auto run_worker = [&] {
+        try {
+            worker(claim);
+        } catch (...) {
+            std::lock_guard lock{error_mutex};
+
+            if (!error) {
+                error = std::current_exception();
+            }
+
+            // Stop the other workers early
+            next_item = num_items;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+
+    for (std::size_t i = 0; i < num_threads; ++i) {
+        threads.emplace_back(run_worker);
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace asmgrader
@@ -1,48 +1,177 @@
 #include "multi_student_runner.hpp"
 
 #include "api/assignment.hpp"
+#include "common/worker_threads.hpp"
 #include "grading_session.hpp"
+#include "logging.hpp"
+#include "output/buffered_serializer.hpp"
+#include "output/event_codec.hpp"
+#include "output/output_sequencer.hpp"
 #include "output/serializer.hpp"
+#include "result_cache.hpp"
+#include "student_worker_pool.hpp"
+#include "subprocess/tracer_options.hpp"
 #include "test_runner.hpp"
+#include "timing_db.hpp"
+#include "user/program_options.hpp"
 
 #include <fmt/compile.h>
+#include <fmt/format.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <numeric>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 namespace asmgrader {
 
 MultiStudentRunner::MultiStudentRunner(Assignment& assignment, const std::shared_ptr<Serializer>& serializer,
-                                       const std::optional<std::string>& tests_filter)
+                                       const std::optional<std::string>& tests_filter,
+                                       const CpuTimeLimits& cpu_time_limits, std::size_t num_jobs,
+                                       ProgramOptions::OutputOrderOpt output_order,
+                                       ProgramOptions::JobsModeOpt jobs_mode, std::size_t num_test_jobs,
+                                       ResultCache* cache, const TimingDb* timings)
     : assignment_{&assignment}
     , serializer_{serializer}
-    , filter_{tests_filter} {}
+    , filter_{tests_filter}
+    , cpu_time_limits_{cpu_time_limits}
+    , num_jobs_{num_jobs}
+    , output_order_{output_order}
+    , jobs_mode_{jobs_mode}
+    , num_test_jobs_{num_test_jobs}
+    , cache_{cache}
+    , timings_{timings} {}
 
 MultiStudentResult MultiStudentRunner::run_all_students(const std::vector<StudentInfo>& students) const {
+    if (num_jobs_ > 1 && students.size() > 1) {
+        return jobs_mode_ == ProgramOptions::JobsModeOpt::Process ? run_in_processes(students)
+                                                                  : run_concurrently(students);
+    }
+
     MultiStudentResult result;
 
-    AssignmentTestRunner assignment_runner{*assignment_, serializer_, filter_};
+    for (const StudentInfo& info : students) {
+        result.results.push_back(run_student(info, serializer_));
+    }
+
+    return result;
+}
+
+StudentResult MultiStudentRunner::run_student(const StudentInfo& info,
+                                              const std::shared_ptr<Serializer>& serializer) const {
+    AssignmentTestRunner assignment_runner{*assignment_, serializer, filter_, cpu_time_limits_, num_test_jobs_,
+                                           cache_, timings_};
+
+    serializer->on_student_begin(info);
+
+    AssignmentResult assignment_res;
+
+    if (info.assignment_path.has_value()) {
+        assignment_res = assignment_runner.run_all(info.assignment_path);
+    }
+
+    serializer->on_student_end(info);
+
+    return StudentResult{.info = info, .result = assignment_res};
+}
+
+std::vector<std::chrono::milliseconds>
+MultiStudentRunner::predict_durations(const std::vector<StudentInfo>& students) const {
+    // Only used for predictions, so the serializer is never used
+    const AssignmentTestRunner assignment_runner{*assignment_, serializer_, filter_, cpu_time_limits_, num_test_jobs_,
+                                                 cache_, timings_};
+
+    std::vector<std::chrono::milliseconds> predictions;
+    predictions.reserve(students.size());
 
     for (const StudentInfo& info : students) {
-        serializer_->on_student_begin(info);
+        predictions.push_back(assignment_runner.predict_duration(info));
+    }
 
-        AssignmentResult assignment_res;
+    return predictions;
+}
 
-        if (info.assignment_path.has_value()) {
-            assignment_res = assignment_runner.run_all(info.assignment_path);
+std::vector<std::size_t> MultiStudentRunner::make_schedule(const std::vector<StudentInfo>& students) const {
+    std::vector<std::size_t> order(students.size());
+    std::iota(order.begin(), order.end(), std::size_t{0});
+
+    if (timings_ == nullptr) {
+        return order;
+    }
+
+    const std::vector<std::chrono::milliseconds> predictions = predict_durations(students);
+
+    // Otherwise, a long-running student started last would leave every other worker idle until it's done
+    std::ranges::stable_sort(order, std::ranges::greater{},
+                             [&predictions](std::size_t idx) { return predictions[idx]; });
+
+    return order;
+}
+
+MultiStudentResult MultiStudentRunner::run_concurrently(const std::vector<StudentInfo>& students) const {
+    const std::size_t num_workers = std::min(num_jobs_, students.size());
+    LOG_DEBUG("Grading {} students with {} workers", students.size(), num_workers);
+
+    const std::vector<std::size_t> order = make_schedule(students);
+    std::vector<StudentResult> results(students.size());
+    OutputSequencer sequencer{*serializer_, students.size(), output_order_};
+
+    // Each worker is the tracer thread of every tracee that it spawns
+    run_worker_threads(num_workers, order.size(), [&](const auto& claim) {
+        for (auto i = claim(); i; i = claim()) {
+            const std::size_t idx = order[*i];
+            auto output = std::make_shared<BufferedSerializer>();
+            results[idx] = run_student(students[idx], output);
+
+            sequencer.emit(idx, std::move(output));
         }
+    });
+
+    return MultiStudentResult{.results = std::move(results)};
+}
+
+MultiStudentResult MultiStudentRunner::run_in_processes(const std::vector<StudentInfo>& students) const {
+    std::vector<StudentResult> results(students.size());
+    OutputSequencer sequencer{*serializer_, students.size(), output_order_};
+
+    StudentWorkerPool pool{num_jobs_,
+                           [this, &students](std::size_t idx, const std::shared_ptr<Serializer>& output) {
+                               std::ignore = run_student(students.at(idx), output);
+                           },
+                           interner_};
 
-        StudentResult res{.info = info, .result = assignment_res};
+    auto on_done = [&](std::size_t idx, Result<std::shared_ptr<BufferedSerializer>> output) {
+        const StudentInfo& info = students.at(idx);
 
-        serializer_->on_student_end(info);
+        // Grading this student repeatedly crashed or hung its worker, so report just that
+        if (!output) {
+            auto error_output = std::make_shared<BufferedSerializer>();
+            error_output->on_student_begin(info);
+            error_output->on_error(fmt::format("Failed to grade student after {} attempts: {}",
+                                               StudentWorkerPool::MAX_ATTEMPTS, output.error()));
+            error_output->on_student_end(info);
 
-        result.results.push_back(std::move(res));
+            output = std::move(error_output);
+        }
+
+        results[idx] = StudentResult{.info = info,
+                                     .result = (*output)->get_assignment_result().value_or(AssignmentResult{})};
+        sequencer.emit(idx, std::move(*output));
+    };
+
+    if (auto res = pool.run(make_schedule(students), on_done); !res) {
+        throw std::runtime_error(fmt::format("Failed to run grading workers: {}", res.error()));
     }
 
-    return result;
+    return MultiStudentResult{.results = std::move(results)};
 }
 
 } // namespace asmgrader
@@ -2,8 +2,15 @@
 
 #include "api/assignment.hpp"
 #include "grading_session.hpp"
+#include "output/event_codec.hpp"
 #include "output/serializer.hpp"
+#include "result_cache.hpp"
+#include "subprocess/tracer_options.hpp"
+#include "timing_db.hpp"
+#include "user/program_options.hpp"
 
+#include <chrono>
+#include <cstddef>
 #include <memory>
 #include <optional>
 #include <string>
@@ -14,15 +21,49 @@ namespace asmgrader {
 class MultiStudentRunner
 {
 public:
+    /// Up to `num_jobs` students are graded concurrently, each on its own thread or worker process as per
+    /// `jobs_mode`. Their output is passed to `serializer` one student at a time, in the order given by `output_order`.
+    /// The tests of each student are run as per `num_test_jobs`, `cache` and `timings` (see \ref AssignmentTestRunner).
+    ///
+    /// When graded concurrently, students expected to take the longest as per `timings`, if set, are started first.
     MultiStudentRunner(Assignment& assignment, const std::shared_ptr<Serializer>& serializer,
-                       const std::optional<std::string>& tests_filter);
+                       const std::optional<std::string>& tests_filter, const CpuTimeLimits& cpu_time_limits = {},
+                       std::size_t num_jobs = 1,
+                       ProgramOptions::OutputOrderOpt output_order = ProgramOptions::OutputOrderOpt::Student,
+                       ProgramOptions::JobsModeOpt jobs_mode = ProgramOptions::JobsModeOpt::Thread,
+                       std::size_t num_test_jobs = 1, ResultCache* cache = nullptr, const TimingDb* timings = nullptr);
 
+    /// Results are in the same order as `students`, regardless of the number of jobs
     MultiStudentResult run_all_students(const std::vector<StudentInfo>& students) const;
 
+    /// Expected time to run the tests of each of `students`, as by \ref AssignmentTestRunner::predict_duration
+    std::vector<std::chrono::milliseconds> predict_durations(const std::vector<StudentInfo>& students) const;
+
 private:
+    /// Grades a single student, passing all output to `serializer`
+    StudentResult run_student(const StudentInfo& info, const std::shared_ptr<Serializer>& serializer) const;
+
+    /// Indices of `students` in the order they should be started: longest expected first
+    std::vector<std::size_t> make_schedule(const std::vector<StudentInfo>& students) const;
+
+    MultiStudentResult run_concurrently(const std::vector<StudentInfo>& students) const;
+
+    /// Grades students in a \ref StudentWorkerPool. Must be called while the grader has no other threads.
+    MultiStudentResult run_in_processes(const std::vector<StudentInfo>& students) const;
+
     Assignment* assignment_;
     std::shared_ptr<Serializer> serializer_;
     std::optional<std::string> filter_;
+    CpuTimeLimits cpu_time_limits_;
+    std::size_t num_jobs_;
+    ProgramOptions::OutputOrderOpt output_order_;
+    ProgramOptions::JobsModeOpt jobs_mode_;
+    std::size_t num_test_jobs_;
+    ResultCache* cache_;
+    const TimingDb* timings_;
+
+    /// Owns the strings viewed by the results of students graded in worker processes
+    mutable StringInterner interner_;
 };
 
 } // namespace asmgrader
@@ -0,0 +1,74 @@
+#include "output/buffered_serializer.hpp"
+
+#include "api/requirement.hpp"
+#include "grading_session.hpp"
+#include "output/serializer.hpp"
+#include "output/sink.hpp"
+#include "output/verbosity.hpp"
+
+#include <string>
+#include <string_view>
+
+namespace asmgrader {
+
+BufferedSerializer::BufferedSerializer()
+    : Serializer{null_sink(), VerbosityLevel::Max} {}
+
+void BufferedSerializer::on_student_begin(const StudentInfo& info) {
+    events_.emplace_back([info](Serializer& target) { target.on_student_begin(info); });
+}
+
+void BufferedSerializer::on_student_end(const StudentInfo& info) {
+    events_.emplace_back([info](Serializer& target) { target.on_student_end(info); });
+}
+
+void BufferedSerializer::on_run_metadata(const RunMetadata& data) {
+    events_.emplace_back([data](Serializer& target) { target.on_run_metadata(data); });
+}
+
+void BufferedSerializer::on_requirement_result(const RequirementResult& data) {
+    events_.emplace_back([data](Serializer& target) { target.on_requirement_result(data); });
+}
+
+void BufferedSerializer::on_test_begin(std::string_view test_name) {
+    events_.emplace_back([name = std::string{test_name}](Serializer& target) { target.on_test_begin(name); });
+}
+
+void BufferedSerializer::on_test_result(const TestResult& data) {
+    events_.emplace_back([data](Serializer& target) { target.on_test_result(data); });
+}
+
+void BufferedSerializer::on_assignment_result(const AssignmentResult& data) {
+    events_.emplace_back([data](Serializer& target) { target.on_assignment_result(data); });
+    assignment_result_ = data;
+}
+
+void BufferedSerializer::on_cache_stats(const CacheStats& data) {
+    events_.emplace_back([data](Serializer& target) { target.on_cache_stats(data); });
+}
+
+void BufferedSerializer::on_timing_report(const TimingReport& data) {
+    events_.emplace_back([data](Serializer& target) { target.on_timing_report(data); });
+}
+
+void BufferedSerializer::on_warning(std::string_view what) {
+    events_.emplace_back([what = std::string{what}](Serializer& target) { target.on_warning(what); });
+}
+
+void BufferedSerializer::on_error(std::string_view what) {
+    events_.emplace_back([what = std::string{what}](Serializer& target) { target.on_error(what); });
+}
+
+void BufferedSerializer::finalize() {
+    events_.emplace_back([](Serializer& target) { target.finalize(); });
+}
+
+void BufferedSerializer::replay(Serializer& target) {
+    for (const auto& event : events_) {
+        event(target);
+    }
+
+    events_.clear();
+}
+
+} // namespace asmgrader
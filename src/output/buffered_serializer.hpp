@@ -0,0 +1,49 @@
+#pragma once
+
+#include "api/requirement.hpp"
+#include "grading_session.hpp"
+#include "output/serializer.hpp"
+
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace asmgrader {
+
+/// Records every event instead of outputting it, to later be replayed to another serializer
+///
+/// Used to grade students concurrently, while still outputting the results of each student as a whole.
+class BufferedSerializer : public Serializer
+{
+public:
+    BufferedSerializer();
+
+    void on_student_begin(const StudentInfo& info) override;
+    void on_student_end(const StudentInfo& info) override;
+
+    void on_run_metadata(const RunMetadata& data) override;
+    void on_requirement_result(const RequirementResult& data) override;
+    void on_test_begin(std::string_view test_name) override;
+    void on_test_result(const TestResult& data) override;
+    void on_assignment_result(const AssignmentResult& data) override;
+    void on_cache_stats(const CacheStats& data) override;
+    void on_timing_report(const TimingReport& data) override;
+
+    void on_warning(std::string_view what) override;
+    void on_error(std::string_view what) override;
+
+    void finalize() override;
+
+    /// Passes every recorded event to `target`, in order, then forgets them
+    void replay(Serializer& target);
+
+    /// The last assignment result recorded, if any. Unaffected by \ref replay.
+    const std::optional<AssignmentResult>& get_assignment_result() const { return assignment_result_; }
+
+private:
+    std::vector<std::function<void(Serializer&)>> events_;
+    std::optional<AssignmentResult> assignment_result_;
+};
+
+} // namespace asmgrader
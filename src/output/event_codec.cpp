@@ -0,0 +1,528 @@
+#include "output/event_codec.hpp"
+
+#include "api/expression_inspection.hpp"
+#include "api/requirement.hpp"
+#include "common/aliases.hpp"
+#include "common/error_types.hpp"
+#include "exceptions.hpp"
+#include "grading_session.hpp"
+#include "output/serializer.hpp"
+#include "output/sink.hpp"
+#include "output/verbosity.hpp"
+
+#include <boost/type_index.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace asmgrader {
+
+namespace {
+
+enum class EventKind : u8 {
+    StudentBegin,
+    StudentEnd,
+    RunMetadata,
+    TestBegin,
+    RequirementResult,
+    TestResult,
+    AssignmentResult,
+    CacheStats,
+    TimingReport,
+    Warning,
+    Error,
+    Finalize,
+};
+
+template <typename T>
+concept Trivial = std::is_trivially_copyable_v<T>;
+
+class Writer
+{
+public:
+    explicit Writer(std::string& out)
+        : out_{&out} {}
+
+    template <Trivial T>
+    void trivial(const T& value) {
+        out_->append(reinterpret_cast<const char*>(&value), sizeof(T)); // NOLINT(*reinterpret-cast)
+    }
+
+    void string(std::string_view str) {
+        trivial(u64{str.size()});
+        out_->append(str);
+    }
+
+    void token(const inspection::Token& token) {
+        trivial(token.kind);
+        string(token.str);
+    }
+
+    template <typename T, typename WriteFn>
+    void optional(const std::optional<T>& value, WriteFn write_fn) {
+        trivial(value.has_value());
+        if (value) {
+            write_fn(*value);
+        }
+    }
+
+    template <typename T, typename WriteFn>
+    void vector(const std::vector<T>& values, WriteFn write_fn) {
+        trivial(u64{values.size()});
+        for (const T& value : values) {
+            write_fn(value);
+        }
+    }
+
+    void student_info(const StudentInfo& info) {
+        string(info.first_name);
+        string(info.last_name);
+        trivial(info.names_known);
+        optional(info.assignment_path, [this](const std::filesystem::path& path) { string(path.native()); });
+        string(info.subst_regex_string);
+    }
+
+    void repr(const exprs::ExpressionRepr::Repr& repr) {
+        string(repr.repr.original);
+        string(repr.str.original);
+        string(repr.raw_str);
+        vector(repr.raw_str_tokens, [this](const inspection::Token& tok) { token(tok); });
+        trivial(repr.kind);
+        trivial(repr.is_literal);
+    }
+
+    void expression(const exprs::ExpressionRepr::Expression& expr) {
+        trivial(expr.index());
+
+        if (const auto* value = std::get_if<exprs::ExpressionRepr::Value>(&expr)) {
+            repr(value->repr);
+        } else {
+            const auto& op = std::get<exprs::ExpressionRepr::Operator>(expr);
+            repr(op.repr);
+            vector(op.operands, [this](const exprs::ExpressionRepr::Expression& operand) { expression(operand); });
+        }
+    }
+
+    void requirement_result(const RequirementResult& result) {
+        trivial(result.passed);
+        string(result.description);
+        optional(result.expression_repr,
+                 [this](const exprs::ExpressionRepr& expr_repr) { expression(expr_repr.expression); });
+        string(result.debug_info.msg);
+    }
+
+    void test_result(const TestResult& result) {
+        string(result.name);
+        vector(result.requirement_results, [this](const RequirementResult& req) { requirement_result(req); });
+        trivial(result.num_passed);
+        trivial(result.num_total);
+        trivial(result.weight);
+        trivial(result.timed_out);
+        trivial(result.from_cache);
+        trivial(result.duration);
+        optional(result.error, [this](const ContextInternalError& error) {
+            trivial(error.get_error());
+            string(error.what());
+        });
+    }
+
+    void assignment_result(const AssignmentResult& result) {
+        string(result.name);
+        vector(result.test_results, [this](const TestResult& test) { test_result(test); });
+        trivial(result.num_requirements_total);
+        trivial(result.duration);
+    }
+
+    void timing_report(const TimingReport& report) {
+        vector(report.entries, [this](const TimingReport::Entry& entry) {
+            string(entry.student);
+            trivial(entry.predicted);
+            trivial(entry.actual);
+        });
+    }
+
+private:
+    std::string* out_;
+};
+
+class Reader
+{
+public:
+    Reader(std::string_view in, StringInterner& interner)
+        : in_{in}
+        , interner_{&interner} {}
+
+    bool empty() const { return in_.empty(); }
+
+    /// Whether an attempt was made to read past the end. Anything read since then is meaningless.
+    bool failed() const { return failed_; }
+
+    template <Trivial T>
+    T trivial() {
+        T value{};
+
+        if (in_.size() < sizeof(T)) {
+            fail();
+            return value;
+        }
+
+        std::memcpy(&value, in_.data(), sizeof(T));
+        in_.remove_prefix(sizeof(T));
+
+        return value;
+    }
+
+    std::string string() {
+        const auto size = trivial<u64>();
+
+        if (size > in_.size()) {
+            fail();
+            return {};
+        }
+
+        std::string result{in_.substr(0, size)};
+        in_.remove_prefix(size);
+
+        return result;
+    }
+
+    std::string_view view() { return interner_->intern(string()); }
+
+    inspection::Token token() {
+        const auto kind = trivial<inspection::Token::Kind>();
+        return inspection::Token{.kind = kind, .str = view()};
+    }
+
+    template <typename ReadFn>
+    auto optional(ReadFn read_fn) -> std::optional<decltype(read_fn())> {
+        if (!trivial<bool>() || failed_) {
+            return std::nullopt;
+        }
+
+        return read_fn();
+    }
+
+    template <typename ReadFn>
+    auto vector(ReadFn read_fn) -> std::vector<decltype(read_fn())> {
+        const auto size = trivial<u64>();
+        std::vector<decltype(read_fn())> result;
+
+        // Stop at the first failure, so that a corrupt size doesn't keep us looping
+        for (u64 i = 0; i < size && !failed_; ++i) {
+            result.push_back(read_fn());
+        }
+
+        return result;
+    }
+
+    StudentInfo student_info() {
+        StudentInfo info{};
+        info.first_name = string();
+        info.last_name = string();
+        info.names_known = trivial<bool>();
+        info.assignment_path = optional([this] { return std::filesystem::path{string()}; });
+        info.subst_regex_string = string();
+
+        return info;
+    }
+
+    exprs::ExpressionRepr::Repr repr() {
+        using Repr = exprs::ExpressionRepr::Repr;
+
+        auto repr_str = string();
+        auto str = string();
+        const auto raw_str = view();
+        auto raw_str_tokens = vector([this] { return token(); });
+        const auto kind = trivial<Repr::Type>();
+        const bool is_literal = trivial<bool>();
+
+        return Repr{.repr = {.original = std::move(repr_str)},
+                    .str = {.original = std::move(str)},
+                    .raw_str = raw_str,
+                    .raw_str_tokens = std::move(raw_str_tokens),
+                    // Type information can't be decoded by value; it's never output anyways
+                    .type_index = boost::typeindex::type_id<void>(),
+                    .kind = kind,
+                    .is_literal = is_literal};
+    }
+
+    exprs::ExpressionRepr::Expression expression() {
+        using exprs::ExpressionRepr;
+
+        const auto index = trivial<std::size_t>();
+
+        if (index == 0) {
+            return ExpressionRepr::Value{.repr = repr()};
+        }
+
+        if (index != 1) {
+            fail();
+            return ExpressionRepr::Value{};
+        }
+
+        ExpressionRepr::Operator op{.repr = repr(), .operands = {}};
+        op.operands = vector([this] { return expression(); });
+
+        return op;
+    }
+
+    RequirementResult requirement_result() {
+        const bool passed = trivial<bool>();
+        auto description = string();
+        auto expression_repr = optional([this] { return exprs::ExpressionRepr{.expression = expression()}; });
+        const auto msg = view();
+
+        return RequirementResult{.passed = passed,
+                                 .description = std::move(description),
+                                 .expression_repr = std::move(expression_repr),
+                                 .debug_info = RequirementResult::DebugInfo{msg, std::source_location{}}};
+    }
+
+    TestResult test_result() {
+        TestResult result;
+        result.name = string();
+        result.requirement_results = vector([this] { return requirement_result(); });
+        result.num_passed = trivial<int>();
+        result.num_total = trivial<int>();
+        result.weight = trivial<int>();
+        result.timed_out = trivial<bool>();
+        result.from_cache = trivial<bool>();
+        result.duration = trivial<std::chrono::milliseconds>();
+        result.error = optional([this] {
+            const auto error = trivial<ErrorKind>();
+            return ContextInternalError{error, string()};
+        });
+
+        return result;
+    }
+
+    AssignmentResult assignment_result() {
+        AssignmentResult result;
+        result.name = string();
+        result.test_results = vector([this] { return test_result(); });
+        result.num_requirements_total = trivial<int>();
+        result.duration = trivial<std::chrono::milliseconds>();
+
+        return result;
+    }
+
+    TimingReport timing_report() {
+        TimingReport report;
+        report.entries = vector([this] {
+            auto student = string();
+            const auto predicted = trivial<std::chrono::milliseconds>();
+            const auto actual = trivial<std::chrono::milliseconds>();
+
+            return TimingReport::Entry{.student = std::move(student), .predicted = predicted, .actual = actual};
+        });
+
+        return report;
+    }
+
+private:
+    void fail() {
+        failed_ = true;
+        in_ = {};
+    }
+
+    std::string_view in_;
+    StringInterner* interner_;
+    bool failed_ = false;
+};
+
+} // namespace
+
+std::string_view StringInterner::intern(std::string str) {
+    std::lock_guard lock{mutex_};
+
+    return *strings_.insert(std::move(str)).first;
+}
+
+EventEncoder::EventEncoder()
+    : Serializer{null_sink(), VerbosityLevel::Max} {}
+
+void EventEncoder::on_student_begin(const StudentInfo& info) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::StudentBegin);
+    writer.student_info(info);
+}
+
+void EventEncoder::on_student_end(const StudentInfo& info) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::StudentEnd);
+    writer.student_info(info);
+}
+
+void EventEncoder::on_run_metadata(const RunMetadata& data) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::RunMetadata);
+    writer.trivial(data);
+}
+
+void EventEncoder::on_requirement_result(const RequirementResult& data) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::RequirementResult);
+    writer.requirement_result(data);
+}
+
+void EventEncoder::on_test_begin(std::string_view test_name) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::TestBegin);
+    writer.string(test_name);
+}
+
+void EventEncoder::on_test_result(const TestResult& data) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::TestResult);
+    writer.test_result(data);
+}
+
+void EventEncoder::on_assignment_result(const AssignmentResult& data) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::AssignmentResult);
+    writer.assignment_result(data);
+}
+
+void EventEncoder::on_cache_stats(const CacheStats& data) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::CacheStats);
+    writer.trivial(data);
+}
+
+void EventEncoder::on_timing_report(const TimingReport& data) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::TimingReport);
+    writer.timing_report(data);
+}
+
+void EventEncoder::on_warning(std::string_view what) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::Warning);
+    writer.string(what);
+}
+
+void EventEncoder::on_error(std::string_view what) {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::Error);
+    writer.string(what);
+}
+
+void EventEncoder::finalize() {
+    Writer writer{bytes_};
+    writer.trivial(EventKind::Finalize);
+}
+
+std::string EventEncoder::take_bytes() {
+    return std::exchange(bytes_, {});
+}
+
+Result<void> decode_events(std::string_view bytes, Serializer& target, StringInterner& interner) {
+    Reader reader{bytes, interner};
+
+    // Each event is decoded in full before being passed on, so that a truncated event is never passed
+    while (!reader.empty()) {
+        switch (reader.trivial<EventKind>()) {
+        case EventKind::StudentBegin: {
+            auto info = reader.student_info();
+            if (!reader.failed()) {
+                target.on_student_begin(info);
+            }
+            break;
+        }
+        case EventKind::StudentEnd: {
+            auto info = reader.student_info();
+            if (!reader.failed()) {
+                target.on_student_end(info);
+            }
+            break;
+        }
+        case EventKind::RunMetadata: {
+            auto data = reader.trivial<RunMetadata>();
+            if (!reader.failed()) {
+                target.on_run_metadata(data);
+            }
+            break;
+        }
+        case EventKind::TestBegin: {
+            auto name = reader.string();
+            if (!reader.failed()) {
+                target.on_test_begin(name);
+            }
+            break;
+        }
+        case EventKind::RequirementResult: {
+            auto result = reader.requirement_result();
+            if (!reader.failed()) {
+                target.on_requirement_result(result);
+            }
+            break;
+        }
+        case EventKind::TestResult: {
+            auto result = reader.test_result();
+            if (!reader.failed()) {
+                target.on_test_result(result);
+            }
+            break;
+        }
+        case EventKind::AssignmentResult: {
+            auto result = reader.assignment_result();
+            if (!reader.failed()) {
+                target.on_assignment_result(result);
+            }
+            break;
+        }
+        case EventKind::CacheStats: {
+            auto data = reader.trivial<CacheStats>();
+            if (!reader.failed()) {
+                target.on_cache_stats(data);
+            }
+            break;
+        }
+        case EventKind::TimingReport: {
+            auto report = reader.timing_report();
+            if (!reader.failed()) {
+                target.on_timing_report(report);
+            }
+            break;
+        }
+        case EventKind::Warning: {
+            auto what = reader.string();
+            if (!reader.failed()) {
+                target.on_warning(what);
+            }
+            break;
+        }
+        case EventKind::Error: {
+            auto what = reader.string();
+            if (!reader.failed()) {
+                target.on_error(what);
+            }
+            break;
+        }
+        case EventKind::Finalize:
+            target.finalize();
+            break;
+        default:
+            return ErrorKind::BadArgument;
+        }
+
+        if (reader.failed()) {
+            return ErrorKind::BadArgument;
+        }
+    }
+
+    return {};
+}
+
+} // namespace asmgrader
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common/error_types.hpp"
+#include "grading_session.hpp"
+#include "output/serializer.hpp"
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace asmgrader {
+
+/// Owns the strings viewed by decoded events (such as stringized requirements), each of which is stored just once
+///
+/// Thread safe.
+class StringInterner
+{
+public:
+    /// A view of the stored copy of `str`, valid for as long as the interner
+    std::string_view intern(std::string str);
+
+private:
+    std::mutex mutex_;
+    std::unordered_set<std::string> strings_;
+};
+
+/// Encodes every event in a compact binary form instead of outputting it, to be decoded by \ref decode_events
+/// in another process
+///
+/// Both processes are assumed to run the same grader on the same machine, so integers are in native byte order.
+/// Everything is encoded by value, never by address, so that decoding malformed bytes can't crash the decoding
+/// process. Source locations and type information of requirements are not preserved, as they're never output.
+class EventEncoder : public Serializer
+{
+public:
+    EventEncoder();
+
+    void on_student_begin(const StudentInfo& info) override;
+    void on_student_end(const StudentInfo& info) override;
+
+    void on_run_metadata(const RunMetadata& data) override;
+    void on_requirement_result(const RequirementResult& data) override;
+    void on_test_begin(std::string_view test_name) override;
+    void on_test_result(const TestResult& data) override;
+    void on_assignment_result(const AssignmentResult& data) override;
+    void on_cache_stats(const CacheStats& data) override;
+    void on_timing_report(const TimingReport& data) override;
+
+    void on_warning(std::string_view what) override;
+    void on_error(std::string_view what) override;
+
+    void finalize() override;
+
+    /// The encoding of every event so far, which are then forgotten
+    std::string take_bytes();
+
+private:
+    std::string bytes_;
+};
+
+/// Decodes events encoded by \ref EventEncoder, passing each to `target` in order. Strings viewed by events are
+/// interned in `interner`. Fails with BadArgument if `bytes` is malformed, in which case only some events may have
+/// been passed.
+Result<void> decode_events(std::string_view bytes, Serializer& target, StringInterner& interner);
+
+} // namespace asmgrader
@@ -0,0 +1,35 @@
+#include "output/output_sequencer.hpp"
+
+#include "output/buffered_serializer.hpp"
+#include "output/serializer.hpp"
+#include "user/program_options.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace asmgrader {
+
+OutputSequencer::OutputSequencer(Serializer& target, std::size_t num_blocks, ProgramOptions::OutputOrderOpt order)
+    : target_{&target}
+    , order_{order}
+    , pending_(num_blocks) {}
+
+void OutputSequencer::emit(std::size_t idx, std::shared_ptr<BufferedSerializer> output) {
+    std::lock_guard lock{mutex_};
+
+    if (order_ == ProgramOptions::OutputOrderOpt::Completion) {
+        output->replay(*target_);
+        return;
+    }
+
+    pending_.at(idx) = std::move(output);
+
+    for (; next_ < pending_.size() && pending_[next_]; ++next_) {
+        pending_[next_]->replay(*target_);
+        pending_[next_].reset();
+    }
+}
+
+} // namespace asmgrader
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "output/buffered_serializer.hpp"
+#include "output/serializer.hpp"
+#include "user/program_options.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace asmgrader {
+
+/// Passes blocks of output (e.g., of each graded student) on to a serializer as a whole, in the given order
+///
+/// Thread safe, as is the target serializer as long as it's only used through the sequencer.
+class OutputSequencer
+{
+public:
+    /// Student = blocks are passed on in order of index, regardless of when they're emitted
+    /// Completion = blocks are passed on as soon as they're emitted
+    OutputSequencer(Serializer& target, std::size_t num_blocks,
+                    ProgramOptions::OutputOrderOpt order = ProgramOptions::OutputOrderOpt::Student);
+
+    /// Emit block `idx` of [0, `num_blocks`)
+    void emit(std::size_t idx, std::shared_ptr<BufferedSerializer> output);
+
+private:
+    Serializer* target_;
+    ProgramOptions::OutputOrderOpt order_;
+
+    std::mutex mutex_;
+
+    /// Blocks which are yet to be replayed, for when it's done in order of index
+    std::vector<std::shared_ptr<BufferedSerializer>> pending_;
+    std::size_t next_ = 0;
+};
+
+} // namespace asmgrader
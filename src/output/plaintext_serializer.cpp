@@ -27,6 +27,7 @@
 #include <range/v3/view/join.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <algorithm>
 #include <cctype>
 #include <chrono>
 #include <cstddef>
@@ -295,6 +296,47 @@ void PlainTextSerializer::on_student_end([[maybe_unused]] const StudentInfo& inf
     sink_.write(out);
 }
 
+void PlainTextSerializer::on_cache_stats(const CacheStats& data) {
+    if (!should_output_run_metadata(verbosity_)) {
+        return;
+    }
+
+    const auto hits_text = fmt::format("{} {}", data.hits, pluralize("hit", static_cast<int>(data.hits)));
+    const auto misses_text = fmt::format("{} {}", data.misses, pluralize("miss", static_cast<int>(data.misses), "es"));
+
+    std::string out = LINE_DIVIDER_2EM(terminal_width_) + "\n";
+    out += fmt::format("Result cache: {}, {}\n", hits_text, misses_text);
+
+    sink_.write(out);
+}
+
+void PlainTextSerializer::on_timing_report(const TimingReport& data) {
+    if (!should_output_run_metadata(verbosity_) || data.entries.empty()) {
+        return;
+    }
+
+    std::size_t name_width = std::string_view{"Student"}.size();
+    for (const TimingReport::Entry& entry : data.entries) {
+        name_width = std::max(name_width, entry.student.size());
+    }
+
+    std::string out = LINE_DIVIDER_2EM(terminal_width_) + "\n";
+    out += fmt::format("{:<{}}  {:>12}  {:>12}  {:>12}\n", "Student", name_width, "Predicted", "Actual", "Error");
+
+    std::chrono::milliseconds total_error{};
+    for (const TimingReport::Entry& entry : data.entries) {
+        const auto error = entry.actual - entry.predicted;
+        total_error += std::chrono::abs(error);
+
+        out += fmt::format("{:<{}}  {:>12}  {:>12}  {:>12}\n", entry.student, name_width, entry.predicted,
+                           entry.actual, fmt::format("{:+}ms", error.count()));
+    }
+
+    out += fmt::format("Mean absolute error: {}\n", total_error / static_cast<std::chrono::milliseconds::rep>(data.entries.size()));
+
+    sink_.write(out);
+}
+
 void PlainTextSerializer::on_warning(std::string_view what) {
     std::string out = style_str(what, WARNING_STYLE, "{}\n");
     sink_.write(out);
@@ -32,6 +32,8 @@ public:
     void on_test_begin(std::string_view test_name) override;
     void on_test_result(const TestResult& data) override;
     void on_assignment_result(const AssignmentResult& data) override;
+    void on_cache_stats(const CacheStats& data) override;
+    void on_timing_report(const TimingReport& data) override;
 
     void on_warning(std::string_view what) override;
     void on_error(std::string_view what) override;
@@ -29,6 +29,9 @@ public:
     virtual void on_test_result(const TestResult& data) = 0;
     virtual void on_assignment_result(const AssignmentResult& data) = 0;
 
+    virtual void on_cache_stats(const CacheStats& data) = 0;
+    virtual void on_timing_report(const TimingReport& data) = 0;
+
     virtual void on_warning(std::string_view what) = 0;
     virtual void on_error(std::string_view what) = 0;
 
@@ -13,4 +13,19 @@ public:
     virtual ~Sink() = default;
 };
 
+/// Discards everything written to it
+class NullSink : public Sink
+{
+public:
+    void write(std::string_view /*str*/) override {}
+
+    void flush() override {}
+};
+
+/// A shared \ref NullSink, for serializers that only pass events on instead of writing them out
+inline Sink& null_sink() {
+    static NullSink sink;
+    return sink;
+}
+
 } // namespace asmgrader
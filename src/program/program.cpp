@@ -4,10 +4,13 @@
 #include "common/expected.hpp"
 #include "common/os.hpp"
 #include "logging.hpp"
+#include "subprocess/fork_server.hpp"
+#include "subprocess/memory/tracee_heap.hpp"
 #include "subprocess/run_result.hpp"
 #include "subprocess/syscall_record.hpp"
 #include "subprocess/traced_subprocess.hpp"
 #include "subprocess/tracer.hpp"
+#include "subprocess/tracer_options.hpp"
 #include "symbols/elf_reader.hpp"
 #include "symbols/symbol_table.hpp"
 
@@ -16,9 +19,9 @@
 #include <fmt/compile.h>
 #include <fmt/format.h>
 #include <fmt/ranges.h>
-#include <libassert/assert.hpp>
 
 #include <array>
+#include <csignal>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
@@ -33,9 +36,11 @@
 #include <utility>
 #include <vector>
 
+#include <sys/syscall.h>
+
 namespace asmgrader {
 
-Program::Program(std::filesystem::path path, std::vector<std::string> args)
+Program::Program(std::filesystem::path path, std::vector<std::string> args, TracerOptions tracer_options)
     : path_{std::move(path)}
     , args_{std::move(args)} {
 
@@ -51,7 +56,19 @@ Program::Program(std::filesystem::path path, std::vector<std::string> args)
     auto elf_reader = ElfReader(path_.string());
     symtab_ = std::make_unique<SymbolTable>(elf_reader.get_symbol_table());
 
-    subproc_ = std::make_unique<TracedSubprocess>(path_.string(), args);
+    subproc_ = std::make_unique<TracedSubprocess>(path_.string(), args, std::move(tracer_options));
+    std::ignore = subproc_->start();
+}
+
+Program::Program(ForkServer& fork_server)
+    : path_{fork_server.get_exec()}
+    , args_{fork_server.get_args()} {
+    // The executable was already validated upon starting the fork server
+
+    auto elf_reader = ElfReader(path_.string());
+    symtab_ = std::make_unique<SymbolTable>(elf_reader.get_symbol_table());
+
+    subproc_ = std::make_unique<TracedSubprocess>(fork_server);
     std::ignore = subproc_->start();
 }
 
@@ -91,25 +108,67 @@ const SymbolTable& Program::get_symtab() const {
     return *symtab_;
 }
 
-Result<RunResult> Program::run() {
-    return subproc_->run();
+Result<RunResult> Program::run(TracingPolicy policy) {
+    return subproc_->run(policy);
 }
 
-Result<RunResult> Program::run_until(const std::function<bool(SyscallRecord)>& pred) {
-    return subproc_->run_until(pred);
+Result<RunResult> Program::run_until(const std::function<bool(SyscallRecord)>& pred, TracingPolicy policy) {
+    return subproc_->run_until(pred, policy);
 }
 
-std::uintptr_t Program::alloc_mem(std::size_t amt) {
-    // Extra offset to not accidentally run into memory issues on border
-    constexpr auto OFFSET_ADDITION = 32;
+Result<void> Program::run_to_return_breakpoint() {
+    Tracer& tracer = subproc_->get_tracer();
 
-    auto offset = (alloced_mem_ += amt) + OFFSET_ADDITION;
+    // Stop the function from exiting the program, so that the process may be restored in place.
+    // Unless exits are traced, the program just exits and is restarted anew.
+    auto run_res = tracer.run_until(
+        [](const SyscallRecord& rec) { return rec.num == SYS_exit || rec.num == SYS_exit_group; },
+        call_tracing_policy_);
 
-    ASSERT(alloced_mem_ < Tracer::MMAP_LENGTH * 3 / 4, "Attempting to allocate too much memory in asm program!");
+    if (run_res == ErrorKind::SyscallPredSat) {
+        TRY(subproc_->restart());
+        return ErrorKind::UnexpectedReturn;
+    }
+
+    if (!run_res) {
+        return run_res.error();
+    }
+
+    using enum RunResult::Kind;
+
+    // If the subprocess is no longer alive, restart it
+    if (run_res->get_kind() == Exited || run_res->get_kind() == Killed) {
+        TRY(subproc_->restart());
+    }
+
+    // We expect that the function returns to our written instruction, which is essentially a breakpoint
+    // that raises SIGTRAP
+    if (run_res->get_kind() != SignalCaught || run_res->get_code() != SIGTRAP) {
+        LOG_DEBUG("Unexpected return from function: kind={}, code={}", fmt::underlying(run_res->get_kind()),
+                  run_res->get_code());
+
+        std::uintptr_t instr_addr =
+#ifdef __aarch64__
+            tracer.get_registers()->pc;
+#else
+            tracer.get_registers()->rip;
+#endif
+        if (auto res = tracer.get_memory_io().read_bytes(instr_addr, 16); res) {
+            LOG_TRACE("Memory (16 bytes) at point of instruction ptr (0x{:x}): {::x}", instr_addr, *res);
+        }
+
+        return ErrorKind::UnexpectedReturn;
+    }
+
+    return {};
+}
+
+Result<TraceeAllocation> Program::alloc_mem(std::size_t amt) {
+    return subproc_->get_tracer().allocate(amt);
+}
 
-    // Simple stack-esque allocation:
-    // Begin at final mmapped address then grow downwards
-    return subproc_->get_tracer().get_mmapped_addr() + Tracer::MMAP_LENGTH - offset;
+void Program::reset_heap() {
+    subproc_->get_tracer().get_heap().reset();
 }
 
 const std::filesystem::path& Program::get_path() const {
@@ -0,0 +1,307 @@
+#include "result_cache.hpp"
+
+#include "common/aliases.hpp"
+#include "common/atomic_file.hpp"
+#include "common/error_types.hpp"
+#include "grading_session.hpp"
+#include "logging.hpp"
+#include "output/buffered_serializer.hpp"
+#include "output/event_codec.hpp"
+#include "output/serializer.hpp"
+#include "output/sink.hpp"
+#include "output/verbosity.hpp"
+#include "symbols/elf_reader.hpp"
+#include "version.hpp"
+
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace asmgrader {
+
+namespace {
+
+/// 64-bit FNV-1a; not cryptographic, but plenty to tell apart submissions
+u64 hash_bytes(std::string_view bytes) {
+    constexpr u64 FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+    constexpr u64 FNV_PRIME = 0x100000001b3;
+
+    u64 hash = FNV_OFFSET_BASIS;
+
+    for (const char byte : bytes) {
+        hash ^= static_cast<unsigned char>(byte);
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+std::optional<std::string> read_file(const std::filesystem::path& path) {
+    std::ifstream file{path, std::ios::binary};
+
+    if (!file) {
+        return std::nullopt;
+    }
+
+    std::string contents{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+    if (file.bad()) {
+        return std::nullopt;
+    }
+
+    return contents;
+}
+
+/// Identifies the exact build of the grader, and so every test within it
+const std::string& grader_id() {
+    static const std::string id = [] {
+        constexpr std::string_view SELF_EXE = "/proc/self/exe";
+
+        try {
+            if (auto build_id = ElfReader{std::string{SELF_EXE}}.get_build_id()) {
+                return fmt::format("{}-{}", ASMGRADER_VERSION_STRING, *build_id);
+            }
+        } catch (const std::invalid_argument& err) {
+            LOG_DEBUG("Failed to read the grader's build ID: {}", err.what());
+        }
+
+        // Without a build ID, hash the whole executable instead
+        const std::optional<std::string> contents = read_file(SELF_EXE);
+
+        return fmt::format("{}-{:016x}", ASMGRADER_VERSION_STRING, contents ? hash_bytes(*contents) : u64{0});
+    }();
+
+    return id;
+}
+
+/// Forwards every event to a target serializer, except for test results, which are only recorded
+class ReplaySerializer : public Serializer
+{
+public:
+    explicit ReplaySerializer(Serializer& target)
+        : Serializer{null_sink(), VerbosityLevel::Max}
+        , target_{&target} {}
+
+    void on_student_begin(const StudentInfo& info) override { target_->on_student_begin(info); }
+
+    void on_student_end(const StudentInfo& info) override { target_->on_student_end(info); }
+
+    void on_run_metadata(const RunMetadata& data) override { target_->on_run_metadata(data); }
+
+    void on_requirement_result(const RequirementResult& data) override { target_->on_requirement_result(data); }
+
+    void on_test_begin(std::string_view test_name) override { target_->on_test_begin(test_name); }
+
+    void on_test_result(const TestResult& data) override { test_result_ = data; }
+
+    void on_assignment_result(const AssignmentResult& data) override { target_->on_assignment_result(data); }
+
+    void on_cache_stats(const CacheStats& data) override { target_->on_cache_stats(data); }
+
+    void on_timing_report(const TimingReport& data) override { target_->on_timing_report(data); }
+
+    void on_warning(std::string_view what) override { target_->on_warning(what); }
+
+    void on_error(std::string_view what) override { target_->on_error(what); }
+
+    void finalize() override { target_->finalize(); }
+
+    const std::optional<TestResult>& get_test_result() const { return test_result_; }
+
+private:
+    Serializer* target_;
+    std::optional<TestResult> test_result_;
+};
+
+/// Forwards every event to both of two serializers
+class TeeSerializer : public Serializer
+{
+public:
+    TeeSerializer(Serializer& first, Serializer& second)
+        : Serializer{null_sink(), VerbosityLevel::Max}
+        , first_{&first}
+        , second_{&second} {}
+
+    void on_student_begin(const StudentInfo& info) override { both(&Serializer::on_student_begin, info); }
+
+    void on_student_end(const StudentInfo& info) override { both(&Serializer::on_student_end, info); }
+
+    void on_run_metadata(const RunMetadata& data) override { both(&Serializer::on_run_metadata, data); }
+
+    void on_requirement_result(const RequirementResult& data) override {
+        both(&Serializer::on_requirement_result, data);
+    }
+
+    void on_test_begin(std::string_view test_name) override { both(&Serializer::on_test_begin, test_name); }
+
+    void on_test_result(const TestResult& data) override { both(&Serializer::on_test_result, data); }
+
+    void on_assignment_result(const AssignmentResult& data) override { both(&Serializer::on_assignment_result, data); }
+
+    void on_cache_stats(const CacheStats& data) override { both(&Serializer::on_cache_stats, data); }
+
+    void on_timing_report(const TimingReport& data) override { both(&Serializer::on_timing_report, data); }
+
+    void on_warning(std::string_view what) override { both(&Serializer::on_warning, what); }
+
+    void on_error(std::string_view what) override { both(&Serializer::on_error, what); }
+
+    void finalize() override {
+        first_->finalize();
+        second_->finalize();
+    }
+
+private:
+    template <typename Arg>
+    void both(void (Serializer::*event)(Arg), std::type_identity_t<Arg> arg) {
+        std::invoke(event, *first_, arg);
+        std::invoke(event, *second_, arg);
+    }
+
+    Serializer* first_;
+    Serializer* second_;
+};
+
+} // namespace
+
+ResultCache::ResultCache(std::filesystem::path directory)
+    : directory_{std::move(directory)} {}
+
+std::optional<std::filesystem::path> ResultCache::default_directory() {
+    if (const char* xdg_cache_home = std::getenv("XDG_CACHE_HOME"); xdg_cache_home != nullptr && *xdg_cache_home) {
+        return std::filesystem::path{xdg_cache_home} / "asmgrader";
+    }
+
+    if (const char* home = std::getenv("HOME"); home != nullptr && *home) {
+        return std::filesystem::path{home} / ".cache" / "asmgrader";
+    }
+
+    return std::nullopt;
+}
+
+Result<void> ResultCache::clear() {
+    std::error_code err;
+    std::filesystem::remove_all(directory_, err);
+
+    if (err) {
+        LOG_WARN("Failed to clear the result cache at {:?}: {}", directory_.string(), err.message());
+        return ErrorKind::SyscallFailure;
+    }
+
+    return {};
+}
+
+std::optional<std::string> ResultCache::make_exec_key(const std::filesystem::path& exec_path) const {
+    const std::optional<std::string> contents = read_file(exec_path);
+
+    if (!contents) {
+        LOG_DEBUG("Failed to read {:?} to look up cached results", exec_path.string());
+        return std::nullopt;
+    }
+
+    return fmt::format("{:016x}-{}", hash_bytes(*contents), contents->size());
+}
+
+TestResult ResultCache::replay_or_run(std::string_view exec_key, std::string_view settings_key,
+                                      std::string_view test_name, Serializer& output,
+                                      const std::function<TestResult(Serializer&)>& run_test) {
+    const std::string key = make_key(exec_key, settings_key, test_name);
+
+    if (const std::optional<std::string> events = load(key)) {
+        // Decode in full before replaying anything, so a corrupt entry can't produce half of a test's output
+        BufferedSerializer decoded;
+
+        if (decode_events(*events, decoded, interner_)) {
+            ReplaySerializer replay{output};
+            decoded.replay(replay);
+
+            if (auto result = replay.get_test_result()) {
+                result->from_cache = true;
+                return *std::move(result);
+            }
+        }
+
+        LOG_WARN("Ignoring a corrupt cached result for test {:?}", test_name);
+    }
+
+    EventEncoder recorder;
+    TeeSerializer tee{output, recorder};
+
+    TestResult result = run_test(tee);
+
+    if (!result.error && !result.timed_out) {
+        recorder.on_test_result(result);
+        store(key, recorder.take_bytes());
+    }
+
+    return result;
+}
+
+bool ResultCache::contains(std::string_view exec_key, std::string_view settings_key,
+                           std::string_view test_name) const {
+    return load(make_key(exec_key, settings_key, test_name)).has_value();
+}
+
+std::string ResultCache::make_key(std::string_view exec_key, std::string_view settings_key,
+                                  std::string_view test_name) {
+    return fmt::format("{}/{}/{}/{}", grader_id(), exec_key, settings_key, test_name);
+}
+
+std::optional<std::string> ResultCache::load(const std::string& key) const {
+    std::optional<std::string> contents = read_file(entry_path(key));
+
+    if (!contents) {
+        return std::nullopt;
+    }
+
+    // An entry is the length of its key, the key itself, then the encoded events
+    u64 key_size{};
+
+    if (contents->size() < sizeof(key_size)) {
+        return std::nullopt;
+    }
+
+    std::memcpy(&key_size, contents->data(), sizeof(key_size));
+    const std::string_view rest = std::string_view{*contents}.substr(sizeof(key_size));
+
+    // Different keys may (very rarely) hash to the same entry
+    if (key_size != key.size() || !rest.starts_with(key)) {
+        return std::nullopt;
+    }
+
+    return std::string{rest.substr(key.size())};
+}
+
+void ResultCache::store(const std::string& key, std::string_view events) {
+    // As read by load
+    const u64 key_size = key.size();
+
+    std::string contents(sizeof(key_size), '\0');
+    std::memcpy(contents.data(), &key_size, sizeof(key_size));
+    contents += key;
+    contents += events;
+
+    // So that a concurrent load never sees a partially written entry
+    if (auto res = write_file_atomically(entry_path(key), contents); !res) {
+        LOG_DEBUG("Failed to store cached result for {:?}: {}", key, res.error());
+    }
+}
+
+std::filesystem::path ResultCache::entry_path(const std::string& key) const {
+    return directory_ / fmt::format("{:016x}", hash_bytes(key));
+}
+
+} // namespace asmgrader
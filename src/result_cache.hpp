@@ -0,0 +1,66 @@
+#pragma once
+
+#include "common/class_traits.hpp"
+#include "common/error_types.hpp"
+#include "grading_session.hpp"
+#include "output/event_codec.hpp"
+#include "output/serializer.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace asmgrader {
+
+/// Results of tests stored on disk, so that re-grading an unchanged executable doesn't run its tests again
+///
+/// Each result is keyed by a hash of the executable's contents, the build ID of the grader itself (so that changing
+/// any test invalidates every result), the settings the test was run with (e.g., CPU time limits), and the name of
+/// the test. Results of tests that failed with an internal error or in which any call timed out are not stored, as
+/// they may well differ on another run.
+///
+/// Thread safe, and safe to share between processes.
+class ResultCache : NonMovable
+{
+public:
+    explicit ResultCache(std::filesystem::path directory);
+
+    /// `$XDG_CACHE_HOME/asmgrader`, or `~/.cache/asmgrader` if that's unset. Nullopt if neither can be determined.
+    static std::optional<std::filesystem::path> default_directory();
+
+    /// Remove every stored result
+    Result<void> clear();
+
+    /// Part of the key of every result for the executable at `exec_path`, or nullopt if it couldn't be read
+    std::optional<std::string> make_exec_key(const std::filesystem::path& exec_path) const;
+
+    /// Replays the output of test `test_name` to `output` and returns its result, if stored for the executable
+    /// with key `exec_key` and the settings described by `settings_key`. Otherwise, calls `run_test` with a
+    /// serializer that forwards to `output`, storing the output and returned result.
+    ///
+    /// As by \ref AssignmentTestRunner, the result is never passed to `output`.
+    TestResult replay_or_run(std::string_view exec_key, std::string_view settings_key, std::string_view test_name,
+                             Serializer& output, const std::function<TestResult(Serializer&)>& run_test);
+
+    /// Whether a result of test `test_name` is stored, as would be replayed by \ref replay_or_run
+    bool contains(std::string_view exec_key, std::string_view settings_key, std::string_view test_name) const;
+
+private:
+    static std::string make_key(std::string_view exec_key, std::string_view settings_key, std::string_view test_name);
+
+    /// The stored output of the result with `key`, if any
+    std::optional<std::string> load(const std::string& key) const;
+
+    void store(const std::string& key, std::string_view events);
+
+    std::filesystem::path entry_path(const std::string& key) const;
+
+    std::filesystem::path directory_;
+
+    /// Owns the strings of every replayed result, which must outlive the output
+    StringInterner interner_;
+};
+
+} // namespace asmgrader
@@ -0,0 +1,375 @@
+#include "student_worker_pool.hpp"
+
+#include "common/aliases.hpp"
+#include "common/error_types.hpp"
+#include "common/linux.hpp"
+#include "logging.hpp"
+#include "output/buffered_serializer.hpp"
+#include "output/event_codec.hpp"
+#include "subprocess/process_reaper.hpp"
+
+#include <range/v3/algorithm/any_of.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace asmgrader {
+
+namespace {
+
+/// Precedes the encoded output of each student sent by a worker
+struct FrameHeader
+{
+    u64 student;
+    u64 size;
+};
+
+Result<void> write_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = TRYE(linux::write(fd, data), SyscallFailure);
+        data.remove_prefix(static_cast<std::size_t>(written));
+    }
+
+    return {};
+}
+
+} // namespace
+
+StudentWorkerPool::StudentWorkerPool(std::size_t num_workers, GradeFn grade_fn, StringInterner& interner,
+                                     std::chrono::milliseconds student_timeout)
+    : num_workers_{num_workers}
+    , grade_fn_{std::move(grade_fn)}
+    , interner_{&interner}
+    , student_timeout_{student_timeout} {}
+
+StudentWorkerPool::~StudentWorkerPool() {
+    for (Worker& worker : workers_) {
+        kill(worker);
+    }
+}
+
+Result<void> StudentWorkerPool::run(const std::vector<std::size_t>& order, const DoneFn& on_done) {
+    using std::chrono::steady_clock;
+
+    const std::size_t num_students = order.size();
+
+    workers_.resize(std::min(num_workers_, num_students));
+
+    for (Worker& worker : workers_) {
+        TRY(spawn(worker));
+    }
+
+    LOG_DEBUG("Grading {} students with {} worker processes", num_students, workers_.size());
+
+    std::size_t next_student = 0;
+    std::deque<std::size_t> retries;
+    std::vector<int> attempts(num_students, 0);
+    std::size_t num_done = 0;
+
+    // Replace a misbehaving worker, retrying its student if it has attempts left
+    auto fail_worker = [&](Worker& worker) {
+        const std::optional<std::size_t> student = worker.student;
+
+        kill(worker);
+
+        if (auto res = spawn(worker); !res) {
+            LOG_WARN("Failed to respawn a grading worker: {}", res.error());
+        }
+
+        if (!student) {
+            return;
+        }
+
+        if (attempts.at(*student) < MAX_ATTEMPTS) {
+            retries.push_back(*student);
+        } else {
+            ++num_done;
+            on_done(*student, ErrorKind::UnexpectedReturn);
+        }
+    };
+
+    auto next_task = [&]() -> std::optional<std::size_t> {
+        if (!retries.empty()) {
+            const std::size_t idx = retries.front();
+            retries.pop_front();
+            return idx;
+        }
+
+        if (next_student < num_students) {
+            return order[next_student++];
+        }
+
+        return std::nullopt;
+    };
+
+    std::vector<pollfd> pollfds;
+    std::vector<Worker*> polled_workers;
+
+    while (num_done < num_students) {
+        for (Worker& worker : workers_) {
+            if (worker.pid == -1 || worker.student) {
+                continue;
+            }
+
+            const std::optional<std::size_t> idx = next_task();
+            if (!idx) {
+                break;
+            }
+
+            ++attempts.at(*idx);
+
+            if (auto res = dispatch(worker, *idx); !res) {
+                fail_worker(worker);
+            }
+        }
+
+        pollfds.clear();
+        polled_workers.clear();
+        auto next_deadline = steady_clock::time_point::max();
+
+        for (Worker& worker : workers_) {
+            if (worker.pid == -1 || !worker.student) {
+                continue;
+            }
+
+            pollfds.push_back({.fd = worker.result_fd, .events = POLLIN, .revents = 0});
+            polled_workers.push_back(&worker);
+            next_deadline = std::min(next_deadline, worker.student_start + student_timeout_);
+        }
+
+        if (polled_workers.empty()) {
+            // Some idle worker was just replaced, and must yet be given its student again
+            if (ranges::any_of(workers_, [](const Worker& worker) { return worker.pid != -1; })) {
+                continue;
+            }
+
+            // Every worker died and couldn't be replaced; give up on whatever is left
+            LOG_ERROR("No grading workers are left");
+
+            for (auto idx = next_task(); idx; idx = next_task()) {
+                ++num_done;
+                on_done(*idx, ErrorKind::SyscallFailure);
+            }
+
+            break;
+        }
+
+        const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(next_deadline - steady_clock::now());
+
+        if (auto res = linux::poll(pollfds, static_cast<int>(std::max(timeout.count(), i64{0})));
+            !res && res.error() != std::errc::interrupted) {
+            return ErrorKind::SyscallFailure;
+        }
+
+        for (std::size_t i = 0; i < pollfds.size(); ++i) {
+            Worker& worker = *polled_workers[i];
+
+            if (pollfds[i].revents == 0) {
+                if (steady_clock::now() - worker.student_start > student_timeout_) {
+                    LOG_WARN("Grading worker {} timed out on student #{}", worker.pid, *worker.student);
+                    fail_worker(worker);
+                }
+                continue;
+            }
+
+            auto res = receive(worker);
+
+            if (!res) {
+                LOG_WARN("Grading worker {} failed on student #{}: {}", worker.pid, *worker.student, res.error());
+                fail_worker(worker);
+            } else if (*res) {
+                auto& [idx, output] = **res;
+
+                worker.student.reset();
+                ++num_done;
+                on_done(idx, std::move(output));
+            }
+        }
+    }
+
+    return {};
+}
+
+Result<void> StudentWorkerPool::spawn(Worker& worker) {
+    const linux::Pipe task_pipe = TRYE(linux::pipe2(O_CLOEXEC), SyscallFailure);
+
+    auto result_pipe = linux::pipe2(O_CLOEXEC);
+    if (!result_pipe) {
+        std::ignore = linux::close(task_pipe.read_fd);
+        std::ignore = linux::close(task_pipe.write_fd);
+        return ErrorKind::SyscallFailure;
+    }
+
+    auto fork_res = linux::fork();
+    if (!fork_res) {
+        for (int fd : {task_pipe.read_fd, task_pipe.write_fd, result_pipe->read_fd, result_pipe->write_fd}) {
+            std::ignore = linux::close(fd);
+        }
+        return ErrorKind::SyscallFailure;
+    }
+
+    // Child process
+    if (fork_res->which == linux::Fork::Child) {
+        // Only the parent is to talk to other workers
+        for (const Worker& other : workers_) {
+            if (&other != &worker && other.pid != -1) {
+                std::ignore = linux::close(other.task_fd);
+                std::ignore = linux::close(other.task_read_fd);
+                std::ignore = linux::close(other.result_fd);
+            }
+        }
+        std::ignore = linux::close(task_pipe.write_fd);
+        std::ignore = linux::close(result_pipe->read_fd);
+
+        // Never outlive the parent, even if it's killed
+        std::ignore = linux::prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+        int exit_code = 0;
+
+        try {
+            worker_main(task_pipe.read_fd, result_pipe->write_fd);
+        } catch (const std::exception& err) {
+            LOG_ERROR("Grading worker failed with an exception: {}", err.what());
+            exit_code = 1;
+        }
+
+        // Destructors and atexit handlers belong to the parent
+        std::fflush(nullptr);
+        _exit(exit_code);
+    }
+
+    // Parent process
+    std::ignore = linux::close(result_pipe->write_fd);
+
+    if (auto res = linux::fcntl(result_pipe->read_fd, F_SETFL, O_NONBLOCK); !res) {
+        LOG_WARN("Failed to make a grading worker's pipe non-blocking: {}", res.error());
+    }
+
+    worker = Worker{.pid = fork_res->pid,
+                    .task_fd = task_pipe.write_fd,
+                    .task_read_fd = task_pipe.read_fd,
+                    .result_fd = result_pipe->read_fd,
+                    .received = {},
+                    .student = std::nullopt,
+                    .student_start = {}};
+
+    return {};
+}
+
+void StudentWorkerPool::kill(Worker& worker) {
+    if (worker.pid == -1) {
+        return;
+    }
+
+    std::ignore = linux::kill(worker.pid, SIGKILL);
+    std::ignore = ProcessReaper::reap_now(worker.pid, -1);
+
+    for (int fd : {worker.task_fd, worker.task_read_fd, worker.result_fd}) {
+        std::ignore = linux::close(fd);
+    }
+
+    worker = Worker{};
+}
+
+void StudentWorkerPool::worker_main(int task_fd, int result_fd) const {
+    while (true) {
+        u64 idx{};
+
+        // EOF (or any failure) means that the parent is done with this worker
+        if (auto res = linux::read(task_fd, &idx, sizeof(idx)); !res || *res != sizeof(idx)) {
+            return;
+        }
+
+        auto encoder = std::make_shared<EventEncoder>();
+        grade_fn_(idx, encoder);
+
+        const std::string payload = encoder->take_bytes();
+        const FrameHeader header{.student = idx, .size = payload.size()};
+
+        // NOLINTNEXTLINE(*reinterpret-cast)
+        if (!write_all(result_fd, {reinterpret_cast<const char*>(&header), sizeof(header)}) ||
+            !write_all(result_fd, payload)) {
+            return;
+        }
+    }
+}
+
+Result<void> StudentWorkerPool::dispatch(Worker& worker, std::size_t idx) {
+    const u64 task = idx;
+
+    // NOLINTNEXTLINE(*reinterpret-cast)
+    TRY(write_all(worker.task_fd, {reinterpret_cast<const char*>(&task), sizeof(task)}));
+
+    worker.received.clear();
+    worker.student = idx;
+    worker.student_start = std::chrono::steady_clock::now();
+
+    return {};
+}
+
+Result<std::optional<std::pair<std::size_t, std::shared_ptr<BufferedSerializer>>>>
+StudentWorkerPool::receive(Worker& worker) {
+    constexpr std::size_t READ_SIZE = 64 * 1024;
+    std::array<char, READ_SIZE> buffer; // NOLINT(*member-init)
+
+    const ssize_t num_read = TRYE(linux::read(worker.result_fd, buffer.data(), buffer.size()), SyscallFailure);
+
+    if (num_read == 0) {
+        LOG_DEBUG("Grading worker {} exited unexpectedly", worker.pid);
+        return ErrorKind::UnexpectedReturn;
+    }
+
+    worker.received.append(buffer.data(), static_cast<std::size_t>(num_read));
+
+    if (worker.received.size() < sizeof(FrameHeader)) {
+        return std::nullopt;
+    }
+
+    FrameHeader header{};
+    std::memcpy(&header, worker.received.data(), sizeof(header));
+
+    if (header.student != *worker.student) {
+        return ErrorKind::BadArgument;
+    }
+
+    const std::string_view payload = std::string_view{worker.received}.substr(sizeof(header));
+
+    if (payload.size() < header.size) {
+        return std::nullopt;
+    }
+
+    // A worker sends nothing more until it's given another student
+    if (payload.size() > header.size) {
+        return ErrorKind::BadArgument;
+    }
+
+    auto output = std::make_shared<BufferedSerializer>();
+    TRY(decode_events(payload, *output, *interner_));
+
+    worker.received.clear();
+
+    return std::pair{static_cast<std::size_t>(header.student), std::move(output)};
+}
+
+} // namespace asmgrader
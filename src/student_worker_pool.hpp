@@ -0,0 +1,97 @@
+#pragma once
+
+#include "common/class_traits.hpp"
+#include "common/error_types.hpp"
+#include "output/buffered_serializer.hpp"
+#include "output/event_codec.hpp"
+#include "output/serializer.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace asmgrader {
+
+/// A pool of worker processes, each grading one student at a time
+///
+/// Workers are forked from the grader without an exec, so each starts with the grader's entire state (e.g., every
+/// registered assignment), but has its own logger, registrars and tracer identity. A student is handed to a worker by
+/// index over a pipe, and the worker streams back the student's output events encoded by \ref EventEncoder.
+///
+/// A worker that crashes, hangs or sends garbage is killed and replaced, and its student is retried, so that one
+/// student can't take down the whole batch.
+class StudentWorkerPool : NonMovable
+{
+public:
+    /// Grades student `idx`, passing all output to `serializer`. Only ever called within a worker.
+    using GradeFn = std::function<void(std::size_t idx, const std::shared_ptr<Serializer>& serializer)>;
+
+    /// Called with the output of student `idx` once it's graded, or an error if every attempt to grade it failed
+    using DoneFn = std::function<void(std::size_t idx, Result<std::shared_ptr<BufferedSerializer>> output)>;
+
+    /// Maximum time for a worker to grade a single student before it's assumed to be hung
+    static constexpr std::chrono::minutes DEFAULT_STUDENT_TIMEOUT{5};
+
+    /// Number of times a student is handed to a worker before giving up on it
+    static constexpr int MAX_ATTEMPTS = 2;
+
+    /// Strings viewed by the output of students are interned in `interner`, which must outlive that output
+    StudentWorkerPool(std::size_t num_workers, GradeFn grade_fn, StringInterner& interner,
+                      std::chrono::milliseconds student_timeout = DEFAULT_STUDENT_TIMEOUT);
+
+    /// Kills and reaps every worker
+    ~StudentWorkerPool();
+
+    /// Grades students [0, order.size()), handing them to workers in the given `order` (a permutation of that range),
+    /// and calling `on_done` for each in order of completion. Fails only if workers can't be spawned at all.
+    Result<void> run(const std::vector<std::size_t>& order, const DoneFn& on_done);
+
+private:
+    struct Worker
+    {
+        pid_t pid = -1;
+
+        /// Write end of the pipe that students are sent over
+        int task_fd = -1;
+        /// Read end of the same pipe. Kept open so that sending to a dead worker never raises SIGPIPE.
+        int task_read_fd = -1;
+        /// Read end of the pipe that output is streamed back over; non-blocking
+        int result_fd = -1;
+
+        /// Bytes received for the current student so far
+        std::string received;
+
+        std::optional<std::size_t> student;
+        std::chrono::steady_clock::time_point student_start;
+    };
+
+    Result<void> spawn(Worker& worker);
+
+    /// Kill and reap `worker`, closing all of its fds
+    static void kill(Worker& worker);
+
+    /// The main loop of a worker process, which grades students until the task pipe is closed
+    void worker_main(int task_fd, int result_fd) const;
+
+    /// Hand `idx` to `worker`
+    Result<void> dispatch(Worker& worker, std::size_t idx);
+
+    /// Read whatever is available from `worker`. Returns the index and decoded output of its student if it's done.
+    /// Fails if the worker exited or sent a malformed frame.
+    Result<std::optional<std::pair<std::size_t, std::shared_ptr<BufferedSerializer>>>> receive(Worker& worker);
+
+    std::size_t num_workers_;
+    GradeFn grade_fn_;
+    StringInterner* interner_;
+    std::chrono::milliseconds student_timeout_;
+
+    std::vector<Worker> workers_;
+};
+
+} // namespace asmgrader
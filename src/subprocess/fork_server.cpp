@@ -0,0 +1,43 @@
+#include "subprocess/fork_server.hpp"
+
+#include "common/error_types.hpp"
+#include "logging.hpp"
+#include "subprocess/traced_subprocess.hpp"
+#include "subprocess/tracer_options.hpp"
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace asmgrader {
+
+ForkServer::ForkServer(std::string exec, std::vector<std::string> args, TracerOptions options)
+    : exec_{std::move(exec)}
+    , args_{std::move(args)}
+    , options_{std::move(options)}
+    , pristine_{std::make_unique<TracedSubprocess>(exec_, args_, options_)} {}
+
+ForkServer::~ForkServer() {
+    // The pristine tracee is never meant to run, so don't give it the chance to upon destruction
+    if (pristine_->get_pid() != 0 && pristine_->is_alive()) {
+        std::ignore = pristine_->kill();
+    }
+}
+
+Result<void> ForkServer::start() {
+    TRY(pristine_->start());
+
+    LOG_DEBUG("Started fork server for {:?} (pid={})", exec_, pristine_->get_pid());
+
+    return {};
+}
+
+Result<pid_t> ForkServer::fork_child() {
+    return pristine_->get_tracer().fork_tracee();
+}
+
+} // namespace asmgrader
@@ -6,6 +6,7 @@
 
 #include <libassert/assert.hpp>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
@@ -14,11 +15,17 @@
 namespace asmgrader {
 
 Result<NativeByteVector> MemoryIOBase::read_until(std::uintptr_t address, const std::function<bool(Byte)>& predicate) {
+    // Only used to avoid reading across a page boundary; an overestimate is harmless
+    constexpr std::size_t PAGE_SIZE = 4096;
+
     NativeByteVector result;
 
     bool pred_satisfied = false;
-    for (std::uintptr_t current_address = address; !pred_satisfied; current_address += 8) {
-        auto next_block = TRY(read_block_impl(current_address, 8));
+    for (std::uintptr_t current_address = address; !pred_satisfied;) {
+        const std::size_t block_size =
+            std::min(preferred_block_size(), PAGE_SIZE - (current_address % PAGE_SIZE));
+        auto next_block = TRY(read_block_impl(current_address, block_size));
+        current_address += block_size;
 
         for (Byte byte : next_block) {
             if (predicate(byte)) {
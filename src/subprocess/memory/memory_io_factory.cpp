@@ -0,0 +1,100 @@
+#include "subprocess/memory/memory_io_factory.hpp"
+
+#include "common/error_types.hpp"
+#include "common/linux.hpp"
+#include "logging.hpp"
+#include "subprocess/memory/memory_io_base.hpp"
+#include "subprocess/memory/proc_mem_memory_io.hpp"
+#include "subprocess/memory/process_vm_memory_io.hpp"
+#include "subprocess/memory/ptrace_memory_io.hpp"
+#include "subprocess/tracer_options.hpp"
+
+#include <libassert/assert.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace asmgrader {
+
+namespace {
+
+constexpr std::size_t PROBE_SIZE = 8;
+
+bool probe_proc_mem(pid_t pid, std::uintptr_t probe_addr) {
+    auto mio = ProcMemMemoryIO::open(pid);
+    if (!mio) {
+        return false;
+    }
+
+    auto orig_bytes = (*mio)->read_bytes(probe_addr, PROBE_SIZE);
+
+    // Writing the same bytes back is a no-op for the tracee, but verifies that the kernel
+    // permits writes to protected pages through /proc/<pid>/mem (see proc_mem.force_override)
+    return orig_bytes && (*mio)->write(probe_addr, *orig_bytes);
+}
+
+bool probe_process_vm(pid_t pid, std::uintptr_t probe_addr) {
+    std::array<char, PROBE_SIZE> buffer{};
+
+    iovec local_iov{.iov_base = buffer.data(), .iov_len = buffer.size()};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast,performance-no-int-to-ptr)
+    iovec remote_iov{.iov_base = reinterpret_cast<void*>(probe_addr), .iov_len = buffer.size()};
+
+    auto res = linux::process_vm_readv(pid, {&local_iov, 1}, {&remote_iov, 1});
+
+    return res && static_cast<std::size_t>(*res) == buffer.size();
+}
+
+} // namespace
+
+MemoryIOKind probe_memory_io_kind(pid_t pid, std::uintptr_t probe_addr) {
+    static std::once_flag probed;
+    static MemoryIOKind result = MemoryIOKind::Ptrace;
+
+    std::call_once(probed, [&] {
+        if (probe_proc_mem(pid, probe_addr)) {
+            result = MemoryIOKind::ProcMem;
+        } else if (probe_process_vm(pid, probe_addr)) {
+            result = MemoryIOKind::ProcessVm;
+        } else {
+            result = MemoryIOKind::Ptrace;
+        }
+
+        LOG_DEBUG("Memory IO probe selected {}", result);
+    });
+
+    return result;
+}
+
+Result<std::unique_ptr<MemoryIOBase>> make_memory_io(pid_t pid, MemoryIOKind kind, std::uintptr_t probe_addr) {
+    if (kind == MemoryIOKind::Auto) {
+        kind = probe_memory_io_kind(pid, probe_addr);
+    }
+
+    switch (kind) {
+    case MemoryIOKind::Ptrace:
+        return std::make_unique<PtraceMemoryIO>(pid);
+    case MemoryIOKind::ProcessVm:
+        return std::make_unique<ProcessVmMemoryIO>(pid);
+    case MemoryIOKind::ProcMem: {
+        auto mio = ProcMemMemoryIO::open(pid);
+        if (!mio) {
+            return mio.error();
+        }
+        return std::move(*mio);
+    }
+    case MemoryIOKind::Auto:
+        break;
+    }
+
+    UNREACHABLE("MemoryIOKind::Auto should have been resolved by probing", kind);
+}
+
+} // namespace asmgrader
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common/error_types.hpp"
+#include "subprocess/memory/memory_io_base.hpp"
+#include "subprocess/tracer_options.hpp"
+
+#include <cstdint>
+#include <memory>
+
+#include <sys/types.h>
+
+namespace asmgrader {
+
+/// Determine the fastest memory IO mechanism that works on this system
+///
+/// The probe is run against the tracee `pid` (which must be stopped, after exec) upon the first call,
+/// reading and re-writing a few bytes at `probe_addr`, which should be in a non-writable text page.
+/// The result is cached for the remainder of the grader's lifetime, as it only depends on the
+/// kernel configuration and our privileges.
+///
+/// Preference: /proc/<pid>/mem, then process_vm_readv/writev, then ptrace.
+MemoryIOKind probe_memory_io_kind(pid_t pid, std::uintptr_t probe_addr);
+
+/// Create a memory IO instance for the stopped, post-exec tracee `pid`
+///
+/// If `kind` is MemoryIOKind::Auto, the mechanism is chosen with \ref probe_memory_io_kind
+Result<std::unique_ptr<MemoryIOBase>> make_memory_io(pid_t pid, MemoryIOKind kind, std::uintptr_t probe_addr);
+
+} // namespace asmgrader
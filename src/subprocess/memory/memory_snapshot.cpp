@@ -0,0 +1,284 @@
+#include "subprocess/memory/memory_snapshot.hpp"
+
+#include "common/aliases.hpp"
+#include "common/byte_vector.hpp"
+#include "common/error_types.hpp"
+#include "common/linux.hpp"
+#include "logging.hpp"
+#include "subprocess/memory/memory_io_base.hpp"
+
+#include <fmt/format.h>
+#include <gsl/util>
+#include <range/v3/algorithm/find_if.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/types.h>
+
+namespace asmgrader {
+
+namespace {
+
+/// See the kernel's Documentation/admin-guide/mm/pagemap.rst
+constexpr int PAGEMAP_SOFT_DIRTY_BIT = 55;
+
+/// Value to write to /proc/<pid>/clear_refs to clear soft-dirty bits
+constexpr std::string_view CLEAR_REFS_SOFT_DIRTY = "4";
+
+/// Returns: the parts of `mapping` outside of every range in `excluded`, in order of address
+std::vector<MemorySnapshot::Range> ranges_outside(const MemorySnapshot::Mapping& mapping,
+                                                  std::span<const MemorySnapshot::Range> excluded) {
+    std::vector<MemorySnapshot::Range> result{{.start = mapping.start, .end = mapping.end}};
+
+    for (const MemorySnapshot::Range& hole : excluded) {
+        std::vector<MemorySnapshot::Range> remaining;
+
+        for (const MemorySnapshot::Range& range : result) {
+            if (hole.end <= range.start || hole.start >= range.end) {
+                remaining.push_back(range);
+                continue;
+            }
+
+            if (range.start < hole.start) {
+                remaining.push_back({.start = range.start, .end = hole.start});
+            }
+            if (hole.end < range.end) {
+                remaining.push_back({.start = hole.end, .end = range.end});
+            }
+        }
+
+        result = std::move(remaining);
+    }
+
+    return result;
+}
+
+} // namespace
+
+Result<std::vector<MemorySnapshot::Mapping>> MemorySnapshot::read_mappings(pid_t pid) {
+    // see proc_pid_maps(5)
+    std::ifstream maps_file(fmt::format("/proc/{}/maps", pid));
+
+    if (!maps_file) {
+        return ErrorKind::SyscallFailure;
+    }
+
+    std::vector<Mapping> result;
+
+    for (std::string line; std::getline(maps_file, line);) {
+        // format: address perms offset dev inode pathname
+        std::istringstream line_stream(line);
+        Mapping mapping{};
+        char dash{};
+        std::string offset;
+        std::string dev;
+        std::string inode;
+
+        line_stream >> std::hex >> mapping.start >> dash >> mapping.end >> mapping.perms >> offset >> dev >> inode;
+
+        if (!line_stream || dash != '-') {
+            LOG_DEBUG("Could not parse line of /proc/{}/maps: {:?}", pid, line);
+            return ErrorKind::UnknownError;
+        }
+
+        // pathname is optional, and may contain spaces
+        std::getline(line_stream >> std::ws, mapping.pathname);
+
+        result.push_back(std::move(mapping));
+    }
+
+    return result;
+}
+
+Result<MemorySnapshot> MemorySnapshot::take(MemoryIOBase& memory_io, std::span<const Range> excluded) {
+    const pid_t pid = memory_io.get_pid();
+    std::vector<Region> regions;
+
+    for (const Mapping& mapping : TRY(read_mappings(pid))) {
+        if (!mapping.is_snapshotted()) {
+            continue;
+        }
+
+        for (const Range& range : ranges_outside(mapping, excluded)) {
+            NativeByteVector data = TRY(memory_io.read_bytes(range.start, range.end - range.start));
+            regions.push_back({.mapping = mapping, .start = range.start, .data = std::move(data)});
+        }
+    }
+
+    MemorySnapshot snapshot(pid, std::move(regions));
+
+    snapshot.soft_dirty_ = snapshot.clear_soft_dirty() && snapshot.probe_soft_dirty(memory_io).value_or(false);
+
+    LOG_DEBUG("Took memory snapshot of pid {} ({} regions, {} bytes, soft-dirty={})", pid, snapshot.regions_.size(),
+              snapshot.size(), snapshot.soft_dirty_);
+
+    return snapshot;
+}
+
+Result<std::size_t> MemorySnapshot::restore(MemoryIOBase& memory_io, std::span<const Range> excluded) {
+    if (!TRY(mappings_compatible(excluded))) {
+        LOG_DEBUG("Mappings of pid {} changed since snapshot; cannot restore in place", pid_);
+        return ErrorKind::BadArgument;
+    }
+
+    std::size_t num_pages_written = 0;
+
+    for (const Region& region : regions_) {
+        const std::vector<bool> dirty = TRY(get_dirty_pages(memory_io, region));
+
+        // Coalesce runs of dirty pages into a single write each
+        for (std::size_t page = 0; page < dirty.size();) {
+            if (!dirty[page]) {
+                ++page;
+                continue;
+            }
+
+            std::size_t run_end = page;
+            while (run_end < dirty.size() && dirty[run_end]) {
+                ++run_end;
+            }
+
+            const auto first = region.data.begin() + gsl::narrow_cast<std::ptrdiff_t>(page * PAGE_SIZE);
+            const auto last = region.data.begin() + gsl::narrow_cast<std::ptrdiff_t>(run_end * PAGE_SIZE);
+
+            TRY(memory_io.write(region.start + page * PAGE_SIZE, NativeByteVector(first, last)));
+
+            num_pages_written += run_end - page;
+            page = run_end;
+        }
+    }
+
+    // Our own writes marked the restored pages as dirty
+    if (soft_dirty_) {
+        TRY(clear_soft_dirty());
+    }
+
+    LOG_DEBUG("Restored {} pages of pid {}", num_pages_written, pid_);
+
+    return num_pages_written;
+}
+
+std::size_t MemorySnapshot::size() const {
+    std::size_t result = 0;
+
+    for (const Region& region : regions_) {
+        result += region.data.size();
+    }
+
+    return result;
+}
+
+Result<bool> MemorySnapshot::mappings_compatible(std::span<const Range> excluded) const {
+    std::size_t num_ranges = 0;
+
+    for (const Mapping& mapping : TRY(read_mappings(pid_))) {
+        if (!mapping.is_snapshotted()) {
+            continue;
+        }
+
+        for (const Range& range : ranges_outside(mapping, excluded)) {
+            ++num_ranges;
+
+            auto matching = ranges::find_if(regions_, [&mapping, &range](const Region& region) {
+                // The stack grows down automatically, which is harmless to leave as-is
+                if (mapping.is_stack() && region.mapping.is_stack()) {
+                    return range.start <= region.start && range.end == region.end();
+                }
+
+                return range.start == region.start && range.end == region.end();
+            });
+
+            if (matching == regions_.end()) {
+                return false;
+            }
+        }
+    }
+
+    return num_ranges == regions_.size();
+}
+
+Result<void> MemorySnapshot::clear_soft_dirty() const {
+    int fd = TRYE(linux::open(fmt::format("/proc/{}/clear_refs", pid_), O_WRONLY | O_CLOEXEC), SyscallFailure);
+    auto write_res = linux::write(fd, CLEAR_REFS_SOFT_DIRTY);
+    std::ignore = linux::close(fd);
+
+    TRYE(write_res, SyscallFailure);
+
+    return {};
+}
+
+Result<bool> MemorySnapshot::probe_soft_dirty(MemoryIOBase& memory_io) const {
+    if (regions_.empty()) {
+        return false;
+    }
+
+    const Region& probe_region = regions_.front();
+
+    // Write back the same byte, which must still mark the page as dirty
+    TRY(memory_io.write(probe_region.start, NativeByteVector{probe_region.data[0]}));
+
+    const bool is_supported = TRY(read_soft_dirty_bits(probe_region)).front();
+
+    if (is_supported) {
+        TRY(clear_soft_dirty());
+    } else {
+        LOG_DEBUG("Soft-dirty bits are unsupported; falling back to comparing pages for memory snapshots");
+    }
+
+    return is_supported;
+}
+
+Result<std::vector<bool>> MemorySnapshot::read_soft_dirty_bits(const Region& region) const {
+    const std::size_t num_pages = region.data.size() / PAGE_SIZE;
+
+    // see the kernel's Documentation/admin-guide/mm/pagemap.rst; one 64-bit entry per virtual page
+    int fd = TRYE(linux::open(fmt::format("/proc/{}/pagemap", pid_), O_RDONLY | O_CLOEXEC), SyscallFailure);
+    std::vector<u64> entries(num_pages);
+
+    auto read_res = linux::pread(fd, entries.data(), entries.size() * sizeof(u64),
+                                 static_cast<off_t>(region.start / PAGE_SIZE * sizeof(u64)));
+    std::ignore = linux::close(fd);
+
+    if (TRYE(read_res, SyscallFailure) != static_cast<ssize_t>(entries.size() * sizeof(u64))) {
+        return ErrorKind::SyscallFailure;
+    }
+
+    std::vector<bool> result(num_pages);
+    std::ranges::transform(entries, result.begin(),
+                           [](u64 entry) { return ((entry >> PAGEMAP_SOFT_DIRTY_BIT) & 1) != 0; });
+
+    return result;
+}
+
+Result<std::vector<bool>> MemorySnapshot::get_dirty_pages(MemoryIOBase& memory_io, const Region& region) const {
+    if (soft_dirty_) {
+        return read_soft_dirty_bits(region);
+    }
+
+    const std::size_t num_pages = region.data.size() / PAGE_SIZE;
+    std::vector<bool> result(num_pages);
+
+    const NativeByteVector current = TRY(memory_io.read_bytes(region.start, region.data.size()));
+
+    for (std::size_t page = 0; page < num_pages; ++page) {
+        const auto offset = gsl::narrow_cast<std::ptrdiff_t>(page * PAGE_SIZE);
+
+        result[page] = !std::equal(region.data.begin() + offset, region.data.begin() + offset + PAGE_SIZE,
+                                   current.begin() + offset);
+    }
+
+    return result;
+}
+
+} // namespace asmgrader
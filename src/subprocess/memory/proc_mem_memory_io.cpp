@@ -0,0 +1,74 @@
+#include "subprocess/memory/proc_mem_memory_io.hpp"
+
+#include "common/byte_vector.hpp"
+#include "common/error_types.hpp"
+#include "common/linux.hpp"
+#include "logging.hpp"
+#include "subprocess/memory/memory_io_base.hpp"
+
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/types.h>
+
+namespace asmgrader {
+
+Result<std::unique_ptr<ProcMemMemoryIO>> ProcMemMemoryIO::open(pid_t pid) {
+    int mem_fd = TRYE(linux::open(fmt::format("/proc/{}/mem", pid), O_RDWR | O_CLOEXEC), SyscallFailure);
+
+    // private constructor; cannot use std::make_unique
+    return std::unique_ptr<ProcMemMemoryIO>(new ProcMemMemoryIO(pid, mem_fd));
+}
+
+ProcMemMemoryIO::ProcMemMemoryIO(pid_t pid, int mem_fd)
+    : MemoryIOBase{pid}
+    , mem_fd_{mem_fd} {}
+
+ProcMemMemoryIO::~ProcMemMemoryIO() {
+    std::ignore = linux::close(mem_fd_);
+}
+
+Result<NativeByteVector> ProcMemMemoryIO::read_block_impl(std::uintptr_t address, std::size_t length) {
+    NativeByteVector result(length);
+
+    // The kernel transfers at most a page per iteration internally, and may return early
+    for (std::size_t done = 0; done < length;) {
+        auto num_read = TRYE(linux::pread(mem_fd_, result.data() + done, length - done, static_cast<off_t>(address + done)),
+                             SyscallFailure);
+
+        if (num_read == 0) {
+            LOG_DEBUG("Unexpected EOF reading /proc/{}/mem at {:#x}", get_pid(), address + done);
+            return ErrorKind::SyscallFailure;
+        }
+
+        done += static_cast<std::size_t>(num_read);
+    }
+
+    return result;
+}
+
+Result<void> ProcMemMemoryIO::write_block_impl(std::uintptr_t address, const NativeByteVector& data) {
+    const std::size_t length = data.size();
+
+    for (std::size_t done = 0; done < length;) {
+        auto num_written = TRYE(
+            linux::pwrite(mem_fd_, data.data() + done, length - done, static_cast<off_t>(address + done)),
+            SyscallFailure);
+
+        if (num_written == 0) {
+            LOG_DEBUG("Unexpected EOF writing /proc/{}/mem at {:#x}", get_pid(), address + done);
+            return ErrorKind::SyscallFailure;
+        }
+
+        done += static_cast<std::size_t>(num_written);
+    }
+
+    return {};
+}
+
+} // namespace asmgrader
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common/byte_vector.hpp"
+#include "common/error_types.hpp"
+#include "subprocess/memory/memory_io_base.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <sys/types.h>
+
+namespace asmgrader {
+
+/// TraceeMemory implemented using pread(2) and pwrite(2) on /proc/<pid>/mem
+///
+/// The file is opened once, and refers to the address space of the tracee at the time of opening.
+/// Thus, an instance must be created only *after* the tracee has exec'd.
+///
+/// As the caller is the tracer, writes are permitted to pages that are not writable by the tracee
+/// itself (e.g., .text), so no fallback mechanism is necessary.
+class ProcMemMemoryIO final : public MemoryIOBase
+{
+public:
+    /// Opens /proc/<pid>/mem for reading and writing
+    static Result<std::unique_ptr<ProcMemMemoryIO>> open(pid_t pid);
+
+    ProcMemMemoryIO(const ProcMemMemoryIO&) = delete;
+    ProcMemMemoryIO& operator=(const ProcMemMemoryIO&) = delete;
+
+    ~ProcMemMemoryIO() override;
+
+private:
+    ProcMemMemoryIO(pid_t pid, int mem_fd);
+
+    Result<NativeByteVector> read_block_impl(std::uintptr_t address, std::size_t length) override;
+    Result<void> write_block_impl(std::uintptr_t address, const NativeByteVector& data) override;
+
+    std::size_t preferred_block_size() const override { return PREFERRED_BLOCK_SIZE; }
+
+    static constexpr std::size_t PREFERRED_BLOCK_SIZE = 256;
+
+    int mem_fd_;
+};
+
+} // namespace asmgrader
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "common/byte_vector.hpp"
+#include "common/error_types.hpp"
+#include "subprocess/memory/memory_io_base.hpp"
+#include "subprocess/memory/ptrace_memory_io.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/types.h>
+
+namespace asmgrader {
+
+/// TraceeMemory implemented using process_vm_readv(2) and process_vm_writev(2)
+///
+/// A whole block is transferred with a single syscall, split into one remote iovec per page.
+/// These syscalls respect the tracee's page protections, so any part of a transfer that fails
+/// (e.g. a write to a read-only or text page) is retried using ptrace(2), which does not.
+class ProcessVmMemoryIO final : public MemoryIOBase
+{
+public:
+    explicit ProcessVmMemoryIO(pid_t pid);
+
+private:
+    Result<NativeByteVector> read_block_impl(std::uintptr_t address, std::size_t length) override;
+    Result<void> write_block_impl(std::uintptr_t address, const NativeByteVector& data) override;
+
+    std::size_t preferred_block_size() const override { return PREFERRED_BLOCK_SIZE; }
+
+    static constexpr std::size_t PREFERRED_BLOCK_SIZE = 256;
+
+    PtraceMemoryIO fallback_;
+};
+
+} // namespace asmgrader
@@ -0,0 +1,64 @@
+#include "subprocess/memory/shared_memory_io.hpp"
+
+#include "common/byte_vector.hpp"
+#include "common/error_types.hpp"
+#include "subprocess/memory/memory_io_base.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+
+namespace asmgrader {
+
+SharedMemoryIO::SharedMemoryIO(std::unique_ptr<MemoryIOBase> inner)
+    : MemoryIOBase{inner->get_pid()}
+    , inner_{std::move(inner)} {}
+
+void SharedMemoryIO::set_region(std::uintptr_t tracee_address, std::span<std::byte> local) {
+    region_ = Region{.tracee_address = tracee_address, .local = local};
+}
+
+std::optional<std::span<std::byte>> SharedMemoryIO::find_local(std::uintptr_t address, std::size_t length) const {
+    if (!region_ || address < region_->tracee_address) {
+        return std::nullopt;
+    }
+
+    const std::size_t offset = address - region_->tracee_address;
+
+    if (offset > region_->local.size() || length > region_->local.size() - offset) {
+        return std::nullopt;
+    }
+
+    return region_->local.subspan(offset, length);
+}
+
+Result<NativeByteVector> SharedMemoryIO::read_block_impl(std::uintptr_t address, std::size_t length) {
+    const auto local = find_local(address, length);
+
+    if (!local) {
+        return inner_->read_block_impl(address, length);
+    }
+
+    NativeByteVector result(length);
+    std::memcpy(result.data(), local->data(), length);
+
+    return result;
+}
+
+Result<void> SharedMemoryIO::write_block_impl(std::uintptr_t address, const NativeByteVector& data) {
+    const auto local = find_local(address, data.size());
+
+    if (!local) {
+        return inner_->write_block_impl(address, data);
+    }
+
+    std::memcpy(local->data(), data.data(), data.size());
+
+    return {};
+}
+
+} // namespace asmgrader
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "common/byte_vector.hpp"
+#include "common/error_types.hpp"
+#include "subprocess/memory/memory_io_base.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+
+namespace asmgrader {
+
+/// Decorates another memory IO backend, short-circuiting transfers to tracee memory that is also
+/// mapped into the grader (see \ref SharedRegion)
+///
+/// A block entirely within the shared region is transferred with a memcpy; everything else is
+/// delegated to the inner backend.
+class SharedMemoryIO final : public MemoryIOBase
+{
+public:
+    explicit SharedMemoryIO(std::unique_ptr<MemoryIOBase> inner);
+
+    /// Tracee memory at [`tracee_address`, `tracee_address` + local.size()) is mirrored by `local`,
+    /// replacing any previous region
+    void set_region(std::uintptr_t tracee_address, std::span<std::byte> local);
+
+    void clear_region() { region_.reset(); }
+
+private:
+    struct Region
+    {
+        std::uintptr_t tracee_address;
+        std::span<std::byte> local;
+    };
+
+    /// The part of the shared region corresponding to [address, address + length), if it's fully contained
+    std::optional<std::span<std::byte>> find_local(std::uintptr_t address, std::size_t length) const;
+
+    Result<NativeByteVector> read_block_impl(std::uintptr_t address, std::size_t length) override;
+    Result<void> write_block_impl(std::uintptr_t address, const NativeByteVector& data) override;
+
+    std::size_t preferred_block_size() const override { return inner_->preferred_block_size(); }
+
+    std::unique_ptr<MemoryIOBase> inner_;
+    std::optional<Region> region_;
+};
+
+} // namespace asmgrader
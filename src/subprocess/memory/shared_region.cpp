@@ -0,0 +1,74 @@
+#include "subprocess/memory/shared_region.hpp"
+
+#include "common/error_types.hpp"
+#include "common/linux.hpp"
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+#include <sys/mman.h>
+#include <sys/types.h>
+
+namespace asmgrader {
+
+namespace {
+
+constexpr std::size_t PAGE_SIZE = 4096;
+
+} // namespace
+
+Result<SharedRegion> SharedRegion::create(std::size_t size) {
+    size = (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+
+    const int fd = TRYE(linux::memfd_create("asmgrader-shared", MFD_CLOEXEC), SyscallFailure);
+
+    if (auto res = linux::ftruncate(fd, static_cast<off_t>(size)); !res) {
+        std::ignore = linux::close(fd);
+        return ErrorKind::SyscallFailure;
+    }
+
+    auto data = linux::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (!data) {
+        std::ignore = linux::close(fd);
+        return ErrorKind::SyscallFailure;
+    }
+
+    return SharedRegion{fd, static_cast<std::byte*>(data.value()), size};
+}
+
+SharedRegion::SharedRegion(SharedRegion&& other) noexcept
+    : fd_{std::exchange(other.fd_, -1)}
+    , data_{std::exchange(other.data_, nullptr)}
+    , size_{std::exchange(other.size_, 0)} {}
+
+SharedRegion& SharedRegion::operator=(SharedRegion&& other) noexcept {
+    if (this != &other) {
+        reset();
+        fd_ = std::exchange(other.fd_, -1);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+
+    return *this;
+}
+
+SharedRegion::~SharedRegion() {
+    reset();
+}
+
+void SharedRegion::reset() {
+    if (data_ != nullptr) {
+        std::ignore = linux::munmap(data_, size_);
+    }
+
+    if (fd_ != -1) {
+        std::ignore = linux::close(fd_);
+    }
+
+    fd_ = -1;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+} // namespace asmgrader
@@ -0,0 +1,185 @@
+#include "subprocess/memory/tracee_heap.hpp"
+
+#include "common/aliases.hpp"
+#include "common/error_types.hpp"
+#include "logging.hpp"
+
+#include <libassert/assert.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace asmgrader {
+
+namespace {
+
+constexpr std::size_t round_up(std::size_t value, std::size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+TraceeAllocation::Block::~Block() {
+    const std::shared_ptr<TraceeHeap> locked_heap = heap.lock();
+
+    if (!locked_heap || locked_heap->get_generation() != generation) {
+        return;
+    }
+
+    if (auto res = locked_heap->deallocate(address); !res) {
+        LOG_WARN("Failed to free tracee allocation at {:#x}", address);
+    }
+}
+
+std::optional<TraceeAllocation> TraceeHeap::allocate(std::size_t size) {
+    size = std::max(size, std::size_t{1});
+
+    if (size > MAX_SMALL_BLOCK_SIZE) {
+        const std::size_t length = round_up(size, PAGE_SIZE);
+        const std::optional<std::uintptr_t> start = take_pages(length);
+
+        if (!start) {
+            return std::nullopt;
+        }
+
+        return make_allocation(*start, length);
+    }
+
+    const std::size_t size_class = size_class_of(size);
+    const std::size_t block_size = size_of_class(size_class);
+
+    if (auto& free_list = free_lists_.at(size_class); !free_list.empty()) {
+        const std::uintptr_t address = free_list.back();
+        free_list.pop_back();
+
+        return make_allocation(address, block_size);
+    }
+
+    if (bump_end_ - bump_ptr_ < block_size) {
+        const std::optional<std::uintptr_t> run = take_pages(SMALL_RUN_SIZE);
+
+        if (!run) {
+            return std::nullopt;
+        }
+
+        retire_small_run();
+        bump_ptr_ = *run;
+        bump_end_ = *run + SMALL_RUN_SIZE;
+    }
+
+    const std::uintptr_t address = bump_ptr_;
+    bump_ptr_ += block_size;
+
+    return make_allocation(address, block_size);
+}
+
+std::size_t TraceeHeap::arena_size_for(std::size_t size) {
+    if (size > MAX_SMALL_BLOCK_SIZE) {
+        return round_up(size, PAGE_SIZE);
+    }
+
+    return SMALL_RUN_SIZE;
+}
+
+void TraceeHeap::add_arena(std::uintptr_t start, std::size_t length, bool shared) {
+    DEBUG_ASSERT(start % PAGE_SIZE == 0 && length % PAGE_SIZE == 0, "Misaligned tracee heap arena", start, length);
+
+    arenas_.push_back({.start = start, .length = length, .shared = shared});
+    free_pages_.emplace(length, start);
+}
+
+Result<void> TraceeHeap::deallocate(std::uintptr_t address) {
+    auto iter = live_.find(address);
+
+    if (iter == live_.end()) {
+        LOG_DEBUG("Attempted to free {:#x}, which is not a live tracee allocation", address);
+        return ErrorKind::BadArgument;
+    }
+
+    const std::size_t size = iter->second;
+    live_.erase(iter);
+
+    if (size > MAX_SMALL_BLOCK_SIZE) {
+        free_pages_.emplace(size, address);
+    } else {
+        free_lists_.at(size_class_of(size)).push_back(address);
+    }
+
+    return {};
+}
+
+void TraceeHeap::reset() {
+    for (auto& free_list : free_lists_) {
+        free_list.clear();
+    }
+
+    free_pages_.clear();
+    for (const Arena& arena : arenas_) {
+        free_pages_.emplace(arena.length, arena.start);
+    }
+
+    bump_ptr_ = bump_end_ = 0;
+    live_.clear();
+    ++generation_;
+}
+
+std::vector<TraceeHeap::Arena> TraceeHeap::release() {
+    std::vector<Arena> arenas = std::move(arenas_);
+    arenas_.clear();
+
+    reset();
+
+    return arenas;
+}
+
+std::size_t TraceeHeap::size_class_of(std::size_t size) {
+    DEBUG_ASSERT(size <= MAX_SMALL_BLOCK_SIZE);
+
+    const std::size_t block_size = std::bit_ceil(std::max(size, MIN_BLOCK_SIZE));
+
+    return static_cast<std::size_t>(std::countr_zero(block_size / MIN_BLOCK_SIZE));
+}
+
+TraceeAllocation TraceeHeap::make_allocation(std::uintptr_t address, std::size_t size) {
+    live_.emplace(address, size);
+
+    return TraceeAllocation{std::make_shared<TraceeAllocation::Block>(weak_from_this(), generation_, address, size)};
+}
+
+std::optional<std::uintptr_t> TraceeHeap::take_pages(std::size_t length) {
+    // Best fit
+    auto iter = free_pages_.lower_bound(length);
+
+    if (iter == free_pages_.end()) {
+        return std::nullopt;
+    }
+
+    const auto [run_length, start] = *iter;
+    free_pages_.erase(iter);
+
+    if (run_length > length) {
+        free_pages_.emplace(run_length - length, start + length);
+    }
+
+    return start;
+}
+
+void TraceeHeap::retire_small_run() {
+    // Greedily hand out the largest blocks that fit; bump_ptr_ is always aligned to MIN_BLOCK_SIZE
+    while (bump_end_ - bump_ptr_ >= MIN_BLOCK_SIZE) {
+        const std::size_t block_size = std::min(std::bit_floor(bump_end_ - bump_ptr_), MAX_SMALL_BLOCK_SIZE);
+
+        free_lists_.at(size_class_of(block_size)).push_back(bump_ptr_);
+        bump_ptr_ += block_size;
+    }
+
+    bump_ptr_ = bump_end_ = 0;
+}
+
+} // namespace asmgrader
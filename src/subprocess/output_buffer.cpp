@@ -0,0 +1,110 @@
+#include "subprocess/output_buffer.hpp"
+
+#include "common/error_types.hpp"
+#include "common/linux.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+#include <sys/ioctl.h>
+#include <sys/types.h>
+
+namespace asmgrader {
+
+namespace {
+
+/// Discarded data at the front of the storage is only compacted away past this size
+constexpr std::size_t MIN_COMPACT_SIZE = 4096;
+
+} // namespace
+
+OutputBuffer::OutputBuffer(std::optional<std::size_t> capacity, OutputOverflow overflow)
+    : capacity_{capacity}
+    , overflow_{overflow} {}
+
+Result<std::size_t> OutputBuffer::drain(int fd) {
+    std::size_t total = 0;
+
+    while (true) {
+        int num_bytes_avail = 0;
+        TRYE(linux::ioctl(fd, FIONREAD, &num_bytes_avail), SyscallFailure);
+
+        if (num_bytes_avail <= 0) {
+            break;
+        }
+
+        // Read directly into the end of the storage; any excess is trimmed by enforce_capacity
+        const std::size_t old_size = data_.size();
+        data_.resize(old_size + static_cast<std::size_t>(num_bytes_avail));
+
+        auto num_read = linux::read(fd, data_.data() + old_size, static_cast<std::size_t>(num_bytes_avail));
+        if (!num_read) {
+            data_.resize(old_size);
+            return ErrorKind::SyscallFailure;
+        }
+
+        data_.resize(old_size + static_cast<std::size_t>(num_read.value()));
+        total += static_cast<std::size_t>(num_read.value());
+
+        enforce_capacity();
+
+        if (num_read.value() == 0) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+void OutputBuffer::append(std::string_view data) {
+    data_ += data;
+
+    enforce_capacity();
+}
+
+std::string_view OutputBuffer::consume() {
+    const std::string_view result = unread();
+    cursor_ = data_.size();
+
+    return result;
+}
+
+void OutputBuffer::clear() {
+    data_.clear();
+    head_ = cursor_ = 0;
+    num_dropped_ = 0;
+}
+
+void OutputBuffer::enforce_capacity() {
+    if (!capacity_ || size() <= *capacity_) {
+        return;
+    }
+
+    const std::size_t excess = size() - *capacity_;
+    num_dropped_ += excess;
+
+    if (overflow_ == OutputOverflow::DropNewest) {
+        data_.resize(data_.size() - excess);
+        cursor_ = std::min(cursor_, data_.size());
+        return;
+    }
+
+    head_ += excess;
+    cursor_ = std::max(cursor_, head_);
+
+    maybe_compact();
+}
+
+void OutputBuffer::maybe_compact() {
+    if (head_ < MIN_COMPACT_SIZE || head_ * 2 < data_.size()) {
+        return;
+    }
+
+    data_.erase(0, head_);
+    cursor_ -= head_;
+    head_ = 0;
+}
+
+} // namespace asmgrader
@@ -0,0 +1,94 @@
+#include "subprocess/process_reaper.hpp"
+
+#include "common/expected.hpp"
+#include "common/linux.hpp"
+#include "logging.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <tuple>
+
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+namespace asmgrader {
+
+ProcessReaper::ProcessReaper()
+    : thread_{[this] { run(); }} {}
+
+ProcessReaper::~ProcessReaper() {
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+
+    pending_cv_.notify_one();
+    thread_.join();
+}
+
+void ProcessReaper::reap(pid_t pid, int pidfd) {
+    {
+        std::lock_guard lock{mutex_};
+        pending_.push_back({.pid = pid, .pidfd = pidfd});
+    }
+
+    pending_cv_.notify_one();
+}
+
+void ProcessReaper::wait_idle() {
+    std::unique_lock lock{mutex_};
+    idle_cv_.wait(lock, [this] { return pending_.empty() && num_in_progress_ == 0; });
+}
+
+std::size_t ProcessReaper::num_reaped() const {
+    std::lock_guard lock{mutex_};
+    return num_reaped_;
+}
+
+Expected<siginfo_t> ProcessReaper::reap_now(pid_t pid, int pidfd) {
+    // Only exits are waited for, so ptrace stops along the way are of no concern
+    if (pidfd != -1) {
+        return linux::waitid(P_PIDFD, static_cast<id_t>(pidfd), WEXITED);
+    }
+
+    return linux::waitid(P_PID, static_cast<id_t>(pid), WEXITED);
+}
+
+void ProcessReaper::run() {
+    std::unique_lock lock{mutex_};
+
+    while (true) {
+        pending_cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+
+        // Remaining processes are still reaped upon stopping
+        if (pending_.empty()) {
+            return;
+        }
+
+        const Child child = pending_.front();
+        pending_.pop_front();
+        ++num_in_progress_;
+
+        lock.unlock();
+
+        if (auto res = reap_now(child.pid, child.pidfd); !res) {
+            LOG_WARN("Failed to reap child process (pid={}): '{}'", child.pid, res.error());
+        }
+
+        if (child.pidfd != -1) {
+            std::ignore = linux::close(child.pidfd);
+        }
+
+        lock.lock();
+
+        --num_in_progress_;
+        ++num_reaped_;
+
+        if (pending_.empty() && num_in_progress_ == 0) {
+            idle_cv_.notify_all();
+        }
+    }
+}
+
+} // namespace asmgrader
@@ -0,0 +1,133 @@
+#include "subprocess/seccomp_filter.hpp"
+
+#include "common/aliases.hpp"
+#include "common/error_types.hpp"
+#include "common/expected.hpp"
+#include "common/linux.hpp"
+#include "logging.hpp"
+
+#include <fmt/format.h>
+#include <range/v3/algorithm/sort.hpp>
+#include <range/v3/algorithm/unique.hpp>
+
+#include <cerrno>
+#include <cstddef>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace asmgrader {
+
+namespace {
+
+#if defined(ASMGRADER_AARCH64)
+constexpr u32 NATIVE_AUDIT_ARCH = AUDIT_ARCH_AARCH64;
+#elif defined(ASMGRADER_X86_64)
+constexpr u32 NATIVE_AUDIT_ARCH = AUDIT_ARCH_X86_64;
+#endif
+
+constexpr sock_filter bpf_stmt(u16 code, u32 k) {
+    return {.code = code, .jt = 0, .jf = 0, .k = k};
+}
+
+constexpr sock_filter bpf_jump(u16 code, u32 k, u8 jt, u8 jf) {
+    return {.code = code, .jt = jt, .jf = jf, .k = k};
+}
+
+} // namespace
+
+SeccompTraceFilter::SeccompTraceFilter(std::span<const u64> syscall_nrs) {
+    std::vector<u64> nrs(syscall_nrs.begin(), syscall_nrs.end());
+    ranges::sort(nrs);
+    nrs.erase(ranges::unique(nrs), nrs.end());
+
+    // NOLINTBEGIN(hicpp-signed-bitwise) - BPF_* macros
+
+    // Layout:
+    //     load arch
+    //     if arch != native: return TRACE
+    //     load nr
+    //     if nr == nrs[0]: goto trace
+    //     ...
+    //     if nr == nrs[n-1]: goto trace
+    //     return ALLOW
+    // trace:
+    //     return TRACE
+    //
+    // BPF jump offsets are only 8 bits, so for very large sets, just trace everything
+    if (nrs.size() >= std::numeric_limits<u8>::max()) {
+        LOG_DEBUG("Too many syscalls ({}) for seccomp filter; tracing all", nrs.size());
+        program_ = {bpf_stmt(BPF_RET | BPF_K, SECCOMP_RET_TRACE)};
+        return;
+    }
+
+    program_.reserve(nrs.size() + 5);
+
+    program_.push_back(bpf_stmt(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)));
+    program_.push_back(bpf_jump(BPF_JMP | BPF_JEQ | BPF_K, NATIVE_AUDIT_ARCH, 1, 0));
+    program_.push_back(bpf_stmt(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+    program_.push_back(bpf_stmt(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)));
+
+    for (std::size_t i = 0; i < nrs.size(); ++i) {
+        // number of instructions to skip to reach the final TRACE return
+        const auto to_trace = static_cast<u8>(nrs.size() - i);
+        program_.push_back(bpf_jump(BPF_JMP | BPF_JEQ | BPF_K, static_cast<u32>(nrs[i]), to_trace, 0));
+    }
+
+    program_.push_back(bpf_stmt(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    program_.push_back(bpf_stmt(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+
+    // NOLINTEND(hicpp-signed-bitwise)
+}
+
+Expected<> SeccompTraceFilter::install() const {
+    // The linux:: wrappers log on failure, which may allocate, so the syscalls are made directly
+
+    // Required to install a filter without CAP_SYS_ADMIN
+    // NOLINTNEXTLINE(*vararg)
+    if (::prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == -1) {
+        return linux::make_error_code(errno);
+    }
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-const-cast,google-runtime-int) - the kernel does not modify the program
+    sock_fprog prog{.len = static_cast<unsigned short>(program_.size()),
+                    .filter = const_cast<sock_filter*>(program_.data())};
+    // NOLINTEND(cppcoreguidelines-pro-type-const-cast,google-runtime-int)
+
+    // no glibc wrapper exists
+    // NOLINTNEXTLINE(*vararg)
+    if (::syscall(SYS_seccomp, SECCOMP_SET_MODE_FILTER, 0, &prog) == -1) {
+        return linux::make_error_code(errno);
+    }
+
+    return {};
+}
+
+Result<bool> SeccompTraceFilter::is_installed(pid_t pid) {
+    // see proc_pid_status(5); "Seccomp: 2" denotes filter mode
+    std::ifstream status_file(fmt::format("/proc/{}/status", pid));
+
+    if (!status_file) {
+        return ErrorKind::SyscallFailure;
+    }
+
+    for (std::string line; std::getline(status_file, line);) {
+        if (line.starts_with("Seccomp:")) {
+            return line.find(std::to_string(SECCOMP_MODE_FILTER)) != std::string::npos;
+        }
+    }
+
+    return false;
+}
+
+} // namespace asmgrader
@@ -0,0 +1,119 @@
+#include "subprocess/stdin_pump.hpp"
+
+#include "common/error_types.hpp"
+#include "common/linux.hpp"
+#include "logging.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <sys/ioctl.h>
+
+namespace asmgrader {
+
+void StdinPump::attach(int write_fd, int read_fd) {
+    write_fd_ = write_fd;
+    read_fd_ = read_fd;
+
+    queue_.clear();
+    front_offset_ = 0;
+    num_queued_ = 0;
+    num_written_ = 0;
+    num_discarded_ = 0;
+}
+
+Result<void> StdinPump::push(std::string_view input) {
+    if (input.empty()) {
+        return {};
+    }
+
+    queue_.emplace_back(input);
+    num_queued_ += input.size();
+
+    TRY(pump());
+
+    return {};
+}
+
+Result<std::size_t> StdinPump::pump() {
+    std::size_t total = 0;
+
+    while (!queue_.empty() && write_fd_ != -1) {
+        const std::string_view pending = std::string_view{queue_.front()}.substr(front_offset_);
+        auto res = linux::write(write_fd_, pending);
+
+        if (res == std::make_error_code(std::errc::resource_unavailable_try_again)) {
+            // The pipe is full
+            break;
+        }
+
+        if (!res) {
+            return ErrorKind::SyscallFailure;
+        }
+
+        const auto num_written = static_cast<std::size_t>(res.value());
+        total += num_written;
+        num_written_ += num_written;
+        num_queued_ -= num_written;
+
+        if (num_written < pending.size()) {
+            front_offset_ += num_written;
+            break;
+        }
+
+        queue_.pop_front();
+        front_offset_ = 0;
+    }
+
+    if (total != 0) {
+        LOG_DEBUG("Wrote {} bytes to stdin pipe ({} still queued)", total, num_queued_);
+    }
+
+    return total;
+}
+
+Result<std::size_t> StdinPump::num_unread() const {
+    if (write_fd_ == -1) {
+        return 0;
+    }
+
+    int num_bytes_avail = 0;
+    TRYE(linux::ioctl(write_fd_, FIONREAD, &num_bytes_avail), SyscallFailure);
+
+    return static_cast<std::size_t>(num_bytes_avail);
+}
+
+Result<std::size_t> StdinPump::num_consumed() const {
+    const std::size_t unread = TRY(num_unread());
+
+    return num_written_ - num_discarded_ - unread;
+}
+
+Result<std::size_t> StdinPump::discard() {
+    std::size_t num_discarded = num_queued_;
+
+    queue_.clear();
+    front_offset_ = 0;
+    num_queued_ = 0;
+
+    if (read_fd_ == -1) {
+        return num_discarded;
+    }
+
+    // Only read what is known to be available, as the read end is shared with the child and thus can't
+    // be made non-blocking
+    for (std::size_t unread = TRY(num_unread()); unread > 0; unread = TRY(num_unread())) {
+        const std::string data = TRYE(linux::read(read_fd_, unread), SyscallFailure);
+
+        num_discarded += data.size();
+        num_discarded_ += data.size();
+    }
+
+    LOG_DEBUG("Discarded {} bytes of stdin", num_discarded);
+
+    return num_discarded;
+}
+
+} // namespace asmgrader
@@ -4,16 +4,23 @@
 #include "common/expected.hpp"
 #include "common/linux.hpp"
 #include "logging.hpp"
+#include "subprocess/process_reaper.hpp"
 #include "subprocess/tracer_types.hpp"
 
 #include <fmt/ranges.h>
 #include <libassert/assert.hpp>
+#include <range/v3/algorithm/transform.hpp>
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
 #include <chrono>
 #include <csignal>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <string>
 #include <string_view>
 #include <tuple>
 #include <utility>
@@ -21,8 +28,9 @@
 
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 #include <sched.h>
-#include <sys/ioctl.h>
+#include <signal.h>
 #include <sys/poll.h>
 #include <sys/ptrace.h>
 #include <sys/types.h>
@@ -31,6 +39,48 @@
 
 namespace asmgrader {
 
+namespace {
+
+constexpr std::size_t SPAWN_STACK_SIZE = std::size_t{64} * 1024;
+
+/// Everything the child of Subprocess::spawn needs, prepared beforehand
+struct SpawnArgs
+{
+    const char* exec;
+    char* const* argv;
+    char* const* envp;
+    int stdin_fd;
+    int stdout_fd;
+    bool traceme;
+    /// Signal mask of the grader, to be restored in the child
+    sigset_t sigmask;
+    /// Set by the child upon failure
+    int child_errno;
+};
+
+/// Entry point of the child of Subprocess::spawn
+///
+/// The child shares the grader's memory until execve, so only async-signal-safe functions may be used,
+/// and nothing may be modified other than SpawnArgs::child_errno.
+int spawn_child(void* arg) {
+    auto* spawn_args = static_cast<SpawnArgs*>(arg);
+
+    // All other pipe ends are closed upon execve, as they are O_CLOEXEC
+    if (::dup2(spawn_args->stdin_fd, STDIN_FILENO) == -1 || ::dup2(spawn_args->stdout_fd, STDOUT_FILENO) == -1 ||
+        (spawn_args->traceme && ::ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) == -1)) {
+        spawn_args->child_errno = errno;
+        _exit(127);
+    }
+
+    ::sigprocmask(SIG_SETMASK, &spawn_args->sigmask, nullptr);
+    ::execve(spawn_args->exec, spawn_args->argv, spawn_args->envp);
+
+    spawn_args->child_errno = errno;
+    _exit(127);
+}
+
+} // namespace
+
 Subprocess::Subprocess(std::string exec, std::vector<std::string> args)
     : exec_{std::move(exec)}
     , args_{std::move(args)} {}
@@ -48,6 +98,8 @@ Subprocess::~Subprocess() {
         wait_for_exit();
     }
 
+    close_pidfd();
+
     // TODO: should probably kill instead
 }
 
@@ -73,14 +125,29 @@ int Subprocess::wait_for_exit() {
 }
 
 Result<void> Subprocess::kill() {
-    using namespace std::literals;
-
     std::ignore = close_pipes();
-    TRYE(linux::kill(child_pid_, SIGKILL), SyscallFailure);
 
-    auto waitid_res = TRYE(TracedWaitid::wait_with_timeout(child_pid_, 10ms), SyscallFailure);
+    // The pidfd can't refer to an unrelated process that happens to have been given the same pid
+    if (pidfd_ != -1) {
+        TRYE(linux::pidfd_send_signal(pidfd_, SIGKILL), SyscallFailure);
+    } else {
+        TRYE(linux::kill(child_pid_, SIGKILL), SyscallFailure);
+    }
+
+    killed_ = true;
+
+    // SIGKILL can't be caught or ignored, so the child is certain to exit; there's no need for a timeout
+    if (reaper_ != nullptr) {
+        reaper_->reap(child_pid_, std::exchange(pidfd_, -1));
+        return {};
+    }
+
+    auto waitid_res = ProcessReaper::reap_now(child_pid_, pidfd_);
+    close_pidfd();
+
+    TRYE(waitid_res, SyscallFailure);
 
-    ASSERT(waitid_res.type == CLD_KILLED, "Waitid res after killing process should be `CLD_KILLED`");
+    LOG_DEBUG("Killed child process (pid={}): {}", child_pid_, TracedWaitid::parse(waitid_res.value()));
 
     return {};
 }
@@ -128,10 +195,18 @@ Result<void> Subprocess::close_pipes() {
     // Make sure all available data is read before pipes are closed
     std::ignore = read_stdout_impl();
 
+    // Any input that doesn't fit in the pipe by now is lost
+    std::ignore = stdin_pump_.pump();
+    stdin_pump_.detach();
+
     if (stdin_pipe_.write_fd != -1) {
         TRYE(linux::close(stdin_pipe_.write_fd), SyscallFailure);
         stdin_pipe_.write_fd = -1;
     }
+    if (stdin_pipe_.read_fd != -1) {
+        TRYE(linux::close(stdin_pipe_.read_fd), SyscallFailure);
+        stdin_pipe_.read_fd = -1;
+    }
     if (stdout_pipe_.read_fd != -1) {
         TRYE(linux::close(stdout_pipe_.read_fd), SyscallFailure);
         stdout_pipe_.read_fd = -1;
@@ -144,24 +219,41 @@ Subprocess::Subprocess(Subprocess&& other) noexcept
     : child_pid_{std::exchange(other.child_pid_, 0)}
     , stdin_pipe_{std::exchange(other.stdin_pipe_, {})}
     , stdout_pipe_{std::exchange(other.stdout_pipe_, {})}
-    , stdout_buffer_{std::exchange(other.stdout_buffer_, {})}
-    , stdout_cursor_{std::exchange(other.stdout_cursor_, 0)} {}
+    , stdin_pump_{std::exchange(other.stdin_pump_, {})}
+    , pidfd_{std::exchange(other.pidfd_, -1)}
+    , killed_{std::exchange(other.killed_, false)}
+    , reaper_{std::exchange(other.reaper_, nullptr)}
+    , stdout_capture_options_{other.stdout_capture_options_}
+    , stdout_buffer_{std::exchange(other.stdout_buffer_, {})} {}
 
 Subprocess& Subprocess::operator=(Subprocess&& rhs) noexcept {
     child_pid_ = std::exchange(rhs.child_pid_, 0);
     stdin_pipe_ = std::exchange(rhs.stdin_pipe_, {});
     stdout_pipe_ = std::exchange(rhs.stdout_pipe_, {});
+    stdin_pump_ = std::exchange(rhs.stdin_pump_, {});
+    pidfd_ = std::exchange(rhs.pidfd_, -1);
+    killed_ = std::exchange(rhs.killed_, false);
+    reaper_ = std::exchange(rhs.reaper_, nullptr);
+    stdout_capture_options_ = rhs.stdout_capture_options_;
     stdout_buffer_ = std::exchange(rhs.stdout_buffer_, {});
-    stdout_cursor_ = std::exchange(rhs.stdout_cursor_, 0);
 
     return *this;
 }
 
 bool Subprocess::is_alive() const {
-    return linux::kill(child_pid_, 0) != std::make_error_code(std::errc::no_such_process);
+    // Once killed, the child may still exist until it's reaped (possibly by another thread)
+    return !killed_ && linux::kill(child_pid_, 0) != std::make_error_code(std::errc::no_such_process);
+}
+
+void Subprocess::set_stdout_capture(const OutputCaptureOptions& options) {
+    stdout_capture_options_ = options;
+    stdout_buffer_ = OutputBuffer{options.capacity, options.overflow};
 }
 
-Result<std::string> Subprocess::read_stdout_poll_impl(int timeout_ms) {
+Result<std::string_view> Subprocess::read_stdout_poll_impl(int timeout_ms) {
+    // The child may be waiting on input before producing any output
+    TRY(stdin_pump_.pump());
+
     // If the pipe is already closed, all we can do is try reading from the buffer
     if (stdout_pipe_.read_fd == -1) {
         return read_stdout();
@@ -169,8 +261,18 @@ Result<std::string> Subprocess::read_stdout_poll_impl(int timeout_ms) {
 
     struct pollfd poll_struct = {.fd = stdout_pipe_.read_fd, .events = POLLIN, .revents = 0};
 
+    using std::chrono::steady_clock;
+    const auto deadline = steady_clock::now() + std::chrono::milliseconds{timeout_ms};
+
     // TODO: Create wrapper in linux.hpp
     int res = poll(&poll_struct, 1, timeout_ms);
+
+    // poll(2) is never restarted after a signal handler, and SIGCHLD is handled while waiting on tracees
+    while (res == -1 && errno == EINTR) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - steady_clock::now());
+        res = poll(&poll_struct, 1, static_cast<int>(std::max(remaining, std::chrono::milliseconds{0}).count()));
+    }
+
     // Error
     if (res == -1) {
         LOG_WARN("Error polling for read from stdout pipe: '{}'", get_err_msg());
@@ -184,58 +286,59 @@ Result<std::string> Subprocess::read_stdout_poll_impl(int timeout_ms) {
     return read_stdout();
 }
 
-Result<std::string> Subprocess::read_stdout() {
+Result<std::string_view> Subprocess::read_stdout() {
     TRY(read_stdout_impl());
 
-    // Cursor is still at the end of the buffer -> no data was read
-    if (stdout_cursor_ == stdout_buffer_.size()) {
-        return "";
-    }
-
-    auto res = stdout_buffer_.substr(stdout_cursor_);
-    stdout_cursor_ = stdout_buffer_.size();
-
-    return res;
+    return stdout_buffer_.consume();
 }
 
-const std::string& Subprocess::get_full_stdout() {
+std::string_view Subprocess::get_full_stdout() {
     std::ignore = read_stdout_impl();
 
-    return stdout_buffer_;
+    return stdout_buffer_.view();
 }
 
 Result<void> Subprocess::read_stdout_impl() {
-    std::size_t num_bytes_avail = 0;
-
     if (stdout_pipe_.read_fd == -1) {
         return {};
     }
 
-    TRYE(linux::ioctl(stdout_pipe_.read_fd, FIONREAD, &num_bytes_avail), SyscallFailure);
-
-    LOG_DEBUG("{} bytes available from stdout_pipe", num_bytes_avail);
+    const std::size_t num_read = TRY(stdout_buffer_.drain(stdout_pipe_.read_fd));
 
-    if (num_bytes_avail == 0) {
-        return {};
-    }
-
-    std::string res = TRYE(linux::read(stdout_pipe_.read_fd, num_bytes_avail), SyscallFailure);
-
-    stdout_buffer_ += res;
+    LOG_DEBUG("{} bytes read from stdout_pipe ({} dropped in total)", num_read, stdout_buffer_.num_dropped());
 
     return {};
 }
 
 Result<void> Subprocess::send_stdin(std::string_view str) {
-    // TODO: more abstract write wrapper that ensures all bytes were sent
-    TRYE(linux::write(stdin_pipe_.write_fd, str), SyscallFailure);
+    return stdin_pump_.push(str);
+}
+
+Result<void> Subprocess::create_pipes() {
+    // Only inherited by way of dup2 in init_child, or explicitly (see TracedSubprocess::create)
+    stdout_pipe_ = TRYE(linux::pipe2(O_CLOEXEC), SyscallFailure);
+    stdin_pipe_ = TRYE(linux::pipe2(O_CLOEXEC), SyscallFailure);
+
+    // A larger pipe lets a program that prints in a loop run longer before it must be drained.
+    // Not fatal, as the pipe is still usable at its default size.
+    const auto pipe_size = static_cast<int>(stdout_capture_options_.pipe_size);
+    if (auto res = linux::fcntl(stdout_pipe_.read_fd, F_SETPIPE_SZ, pipe_size); !res) {
+        LOG_DEBUG("Could not grow stdout pipe to {} bytes", pipe_size);
+    }
 
     return {};
 }
 
 Result<void> Subprocess::create(const std::string& exec, const std::vector<std::string>& args) {
-    stdout_pipe_ = TRYE(linux::pipe2(), SyscallFailure);
-    stdin_pipe_ = TRYE(linux::pipe2(), SyscallFailure);
+    TRY(create_pipes());
+    close_pidfd();
+    killed_ = false;
+
+    if (const SpawnMethod method = get_spawn_method(); method != SpawnMethod::Fork) {
+        if (TRY(spawn(exec, args, method == SpawnMethod::VforkTraced))) {
+            return init_parent();
+        }
+    }
 
     linux::Fork fork_res = TRYE(linux::fork(), SyscallFailure);
 
@@ -255,6 +358,67 @@ Result<void> Subprocess::create(const std::string& exec, const std::vector<std::
     return init_parent();
 }
 
+Result<bool> Subprocess::spawn(const std::string& exec, const std::vector<std::string>& args, bool traced) {
+    // Same as linux::execve: exec, then args, with an empty environment
+    // Reason: execve requires non-const strings
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-const-cast)
+    std::vector<char*> argv(args.size() + 2, nullptr);
+    argv.front() = const_cast<char*>(exec.c_str());
+    ranges::transform(args, argv.begin() + 1, [](const std::string& str) { return const_cast<char*>(str.c_str()); });
+    // NOLINTEND(cppcoreguidelines-pro-type-const-cast)
+    std::array<char*, 1> envp{nullptr};
+
+    SpawnArgs spawn_args{.exec = exec.c_str(),
+                         .argv = argv.data(),
+                         .envp = envp.data(),
+                         .stdin_fd = stdin_pipe_.read_fd,
+                         .stdout_fd = stdout_pipe_.write_fd,
+                         .traceme = traced,
+                         .sigmask = {},
+                         .child_errno = 0};
+
+    // The grader is suspended until the child execs or exits, so its stack only needs to last this call
+    auto stack = std::make_unique_for_overwrite<std::byte[]>(SPAWN_STACK_SIZE);
+
+    // Signal handlers of the grader must not run in the child while it shares the grader's memory
+    sigset_t all_signals{};
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &spawn_args.sigmask);
+
+    int pidfd = -1;
+    auto clone_res = linux::clone(spawn_child, stack.get() + SPAWN_STACK_SIZE,
+                                  CLONE_VM | CLONE_VFORK | CLONE_PIDFD | SIGCHLD, &spawn_args, &pidfd);
+
+    pthread_sigmask(SIG_SETMASK, &spawn_args.sigmask, nullptr);
+
+    if (!clone_res) {
+        LOG_DEBUG("Could not spawn child with clone ({}); falling back to fork", clone_res.error());
+        return false;
+    }
+
+    child_pid_ = clone_res.value();
+    pidfd_ = pidfd;
+
+    if (spawn_args.child_errno != 0) {
+        LOG_WARN("Failed to start '{}': '{}'", exec, linux::make_error_code(spawn_args.child_errno));
+
+        // Reap the child, which has already exited
+        std::ignore = linux::waitid(P_PID, static_cast<id_t>(child_pid_), WEXITED);
+        close_pidfd();
+
+        return ErrorKind::SyscallFailure;
+    }
+
+    return true;
+}
+
+void Subprocess::close_pidfd() {
+    if (pidfd_ != -1) {
+        std::ignore = linux::close(pidfd_);
+        pidfd_ = -1;
+    }
+}
+
 Result<void> Subprocess::init_child() {
     TRYE(linux::dup2(stdin_pipe_.read_fd, STDIN_FILENO), SyscallFailure);
     TRYE(linux::dup2(stdout_pipe_.write_fd, STDOUT_FILENO), SyscallFailure);
@@ -269,19 +433,21 @@ Result<void> Subprocess::init_child() {
 }
 
 Result<void> Subprocess::init_parent() {
-    // Close the pipe ends being used in the parent proc
-    //  - write end for stdout
-    //  - read end for stdin
-    TRYE(linux::close(stdin_pipe_.read_fd), SyscallFailure);
+    // Close the write end for stdout, which is only used in the child proc
+    // The read end for stdin is kept so that StdinPump can discard unread input. It must *not* be made
+    // non-blocking, as it shares an open file description with the child's stdin.
     TRYE(linux::close(stdout_pipe_.write_fd), SyscallFailure);
-    // stdin_pipefd_ = stdin_pipe.write_fd;  // write end of stdin pipe
-    // stdout_pipefd_ = stdout_pipe.read_fd; // read end of stdout pipe
+    stdout_pipe_.write_fd = -1;
+
+    // Make reading from stdout and writing to stdin non-blocking
+    for (int fd : {stdout_pipe_.read_fd, stdin_pipe_.write_fd}) {
+        int pre_flags = TRYE(linux::fcntl(fd, F_GETFL), SyscallFailure);
 
-    // Make reading from stdout non-blocking
-    int pre_flags = TRYE(linux::fcntl(stdout_pipe_.read_fd, F_GETFL), SyscallFailure);
+        TRYE(linux::fcntl(fd, F_SETFL, pre_flags | O_NONBLOCK), // NOLINT
+             SyscallFailure);
+    }
 
-    TRYE(linux::fcntl(stdout_pipe_.read_fd, F_SETFL, pre_flags | O_NONBLOCK), // NOLINT
-         SyscallFailure);
+    stdin_pump_.attach(stdin_pipe_.write_fd, stdin_pipe_.read_fd);
 
     return {};
 }
@@ -0,0 +1,317 @@
+#include "subprocess/syscall_log.hpp"
+
+#include "common/aliases.hpp"
+#include "common/error_types.hpp"
+#include "common/expected.hpp"
+#include "common/linux.hpp"
+#include "subprocess/syscall.hpp"
+#include "subprocess/syscall_record.hpp"
+#include "subprocess/tracer_options.hpp"
+
+#include <libassert/assert.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace asmgrader {
+
+namespace {
+
+/// Don't bother compacting the arena of a ring-mode log until it is at least this large
+constexpr std::size_t MIN_COMPACT_ARENA_SIZE = 64 * 1024;
+
+// Payload format, for each argument referring to tracee memory, in order:
+//   u8 has_value; then the value if has_value, or ErrorKind otherwise
+// where a string is a u64 length followed by its characters, and a string array is a u64
+// count followed by each (fallible) string.
+
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+void put(std::vector<char>& arena, const T& val) {
+    const auto old_size = arena.size();
+    arena.resize(old_size + sizeof(T));
+    std::memcpy(arena.data() + old_size, &val, sizeof(T));
+}
+
+template <typename T, typename Func>
+void put_result(std::vector<char>& arena, const Result<T>& res, Func&& put_value) {
+    put<u8>(arena, res.has_value() ? 1 : 0);
+
+    if (res.has_value()) {
+        put_value(arena, res.value());
+    } else {
+        put(arena, res.error());
+    }
+}
+
+void put_string(std::vector<char>& arena, const std::string& str) {
+    put<u64>(arena, str.size());
+    arena.insert(arena.end(), str.begin(), str.end());
+}
+
+/// Reads back values written with \ref put
+class PayloadReader
+{
+public:
+    PayloadReader(const std::vector<char>& arena, std::size_t offset)
+        : arena_{&arena}
+        , cursor_{offset} {}
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    T get() {
+        T val;
+        std::memcpy(&val, arena_->data() + cursor_, sizeof(T));
+        cursor_ += sizeof(T);
+        return val;
+    }
+
+    std::string get_string() {
+        const auto size = get<u64>();
+        std::string str(arena_->data() + cursor_, size);
+        cursor_ += size;
+        return str;
+    }
+
+    template <typename T, typename Func>
+    Result<T> get_result(Func&& get_value) {
+        if (get<u8>() == 0) {
+            return get<ErrorKind>();
+        }
+
+        return get_value();
+    }
+
+private:
+    const std::vector<char>* arena_;
+    std::size_t cursor_;
+};
+
+} // namespace
+
+SyscallLog::SyscallLog(std::optional<std::size_t> capacity, SyscallLogOverflow overflow,
+                       std::weak_ptr<const TraceeStopState> tracee_state)
+    : capacity_{capacity}
+    , overflow_{overflow}
+    , tracee_state_{std::move(tracee_state)} {}
+
+void SyscallLog::push(const SyscallRecord& record) {
+    awaiting_ret_ = true;
+    last_slot_ = next_slot();
+
+    if (!last_slot_) {
+        return;
+    }
+
+    const std::size_t slot = *last_slot_;
+
+    nums_[slot] = record.num;
+    raw_args_[slot] = record.raw_args;
+    rets_[slot] = 0;
+    ret_states_[slot] = RetState::None;
+    instruction_pointers_[slot] = record.instruction_pointer;
+    stack_pointers_[slot] = record.stack_pointer;
+    stop_ids_[slot] = record.stop_id;
+
+    if (record.decoded_args) {
+        payload_offsets_[slot] = append_payload(record.num, *record.decoded_args);
+        payload_sizes_[slot] = arena_.size() - payload_offsets_[slot];
+        live_payload_bytes_ += payload_sizes_[slot];
+    } else {
+        payload_offsets_[slot] = NO_PAYLOAD;
+        payload_sizes_[slot] = 0;
+    }
+
+    maybe_compact_arena();
+}
+
+void SyscallLog::set_last_ret(const Expected<i64>& ret) {
+    DEBUG_ASSERT(awaiting_ret_, "Syscall return value set without a corresponding entry");
+    awaiting_ret_ = false;
+
+    if (!last_slot_) {
+        return;
+    }
+
+    if (ret.has_value()) {
+        ret_states_[*last_slot_] = RetState::Value;
+        rets_[*last_slot_] = ret.value();
+    } else {
+        ret_states_[*last_slot_] = RetState::Error;
+        rets_[*last_slot_] = ret.error().value();
+    }
+}
+
+SyscallRecord SyscallLog::at(std::size_t idx) const {
+    const std::size_t slot = physical_index(idx);
+
+    std::optional<Expected<i64>> ret;
+    switch (ret_states_[slot]) {
+    case RetState::None:
+        break;
+    case RetState::Value:
+        ret = rets_[slot];
+        break;
+    case RetState::Error:
+        ret = linux::make_error_code(static_cast<int>(rets_[slot]));
+        break;
+    }
+
+    std::optional<std::vector<SyscallRecord::SyscallArg>> decoded_args;
+    if (payload_offsets_[slot] != NO_PAYLOAD) {
+        decoded_args = read_payload(slot);
+    }
+
+    return SyscallRecord{.num = nums_[slot],
+                         .raw_args = raw_args_[slot],
+                         .ret = std::move(ret),
+                         .instruction_pointer = instruction_pointers_[slot],
+                         .stack_pointer = stack_pointers_[slot],
+                         .stop_id = stop_ids_[slot],
+                         .tracee_state = tracee_state_,
+                         .decoded_args = std::move(decoded_args)};
+}
+
+void SyscallLog::clear() {
+    *this = SyscallLog{capacity_, overflow_, std::move(tracee_state_)};
+}
+
+std::size_t SyscallLog::physical_index(std::size_t idx) const {
+    if (idx >= size()) {
+        throw std::out_of_range("SyscallLog index out of range");
+    }
+
+    return (head_ + idx) % size();
+}
+
+std::optional<std::size_t> SyscallLog::next_slot() {
+    if (!capacity_ || size() < *capacity_) {
+        const std::size_t new_size = size() + 1;
+
+        nums_.resize(new_size);
+        raw_args_.resize(new_size);
+        rets_.resize(new_size);
+        ret_states_.resize(new_size);
+        instruction_pointers_.resize(new_size);
+        stack_pointers_.resize(new_size);
+        stop_ids_.resize(new_size);
+        payload_offsets_.resize(new_size);
+        payload_sizes_.resize(new_size);
+
+        return new_size - 1;
+    }
+
+    ++num_dropped_;
+
+    if (overflow_ == SyscallLogOverflow::DropNewest || *capacity_ == 0) {
+        return std::nullopt;
+    }
+
+    // Ring mode; overwrite the oldest record
+    const std::size_t slot = head_;
+    head_ = (head_ + 1) % *capacity_;
+    live_payload_bytes_ -= payload_sizes_[slot];
+
+    return slot;
+}
+
+std::size_t SyscallLog::append_payload(u64 num, const std::vector<SyscallRecord::SyscallArg>& args) {
+    using enum SyscallEntry::Type;
+
+    const std::size_t offset = arena_.size();
+    const auto params = SYSCALL_MAP.at(num).parameters();
+
+    for (std::size_t i = 0; i < std::min(params.size(), args.size()); ++i) {
+        switch (params[i].type) {
+        case CString:
+            put_result(arena_, std::get<Result<std::string>>(args[i]), put_string);
+            break;
+        case NTCStringArray:
+            put_result(arena_, std::get<Result<std::vector<Result<std::string>>>>(args[i]),
+                       [](std::vector<char>& arena, const std::vector<Result<std::string>>& strs) {
+                           put<u64>(arena, strs.size());
+                           for (const auto& str : strs) {
+                               put_result(arena, str, put_string);
+                           }
+                       });
+            break;
+        case TimeSpecPtr:
+            put_result(arena_, std::get<Result<std::timespec>>(args[i]),
+                       [](std::vector<char>& arena, const std::timespec& val) { put(arena, val); });
+            break;
+        default:
+            // Reconstructed from the raw value
+            break;
+        }
+    }
+
+    return offset;
+}
+
+std::vector<SyscallRecord::SyscallArg> SyscallLog::read_payload(std::size_t slot) const {
+    using enum SyscallEntry::Type;
+
+    PayloadReader reader(arena_, payload_offsets_[slot]);
+    std::vector<SyscallRecord::SyscallArg> result;
+
+    const auto params = SYSCALL_MAP.at(nums_[slot]).parameters();
+
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        switch (params[i].type) {
+        case CString:
+            result.emplace_back(reader.get_result<std::string>([&] { return reader.get_string(); }));
+            break;
+        case NTCStringArray:
+            result.emplace_back(reader.get_result<std::vector<Result<std::string>>>([&] {
+                std::vector<Result<std::string>> strs(reader.get<u64>());
+                for (auto& str : strs) {
+                    str = reader.get_result<std::string>([&] { return reader.get_string(); });
+                }
+                return strs;
+            }));
+            break;
+        case TimeSpecPtr:
+            result.emplace_back(reader.get_result<std::timespec>([&] { return reader.get<std::timespec>(); }));
+            break;
+        default:
+            result.push_back(SyscallRecord::decode_arg(raw_args_[slot].at(i), params[i].type, nullptr));
+            break;
+        }
+    }
+
+    return result;
+}
+
+void SyscallLog::maybe_compact_arena() {
+    if (overflow_ != SyscallLogOverflow::Ring || arena_.size() < MIN_COMPACT_ARENA_SIZE ||
+        live_payload_bytes_ * 2 > arena_.size()) {
+        return;
+    }
+
+    std::vector<char> new_arena;
+    new_arena.reserve(live_payload_bytes_);
+
+    for (std::size_t slot = 0; slot < size(); ++slot) {
+        if (payload_offsets_[slot] == NO_PAYLOAD) {
+            continue;
+        }
+
+        const auto first = arena_.begin() + static_cast<std::ptrdiff_t>(payload_offsets_[slot]);
+
+        payload_offsets_[slot] = new_arena.size();
+        new_arena.insert(new_arena.end(), first, first + static_cast<std::ptrdiff_t>(payload_sizes_[slot]));
+    }
+
+    arena_ = std::move(new_arena);
+}
+
+} // namespace asmgrader
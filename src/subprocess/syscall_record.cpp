@@ -0,0 +1,123 @@
+#include "subprocess/syscall_record.hpp"
+
+#include "common/aliases.hpp"
+#include "common/error_types.hpp"
+#include "logging.hpp"
+#include "subprocess/memory/memory_io.hpp"
+#include "subprocess/syscall.hpp"
+
+#include <libassert/assert.hpp>
+#include <range/v3/view/zip.hpp>
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asmgrader {
+
+namespace {
+
+bool refers_to_memory(SyscallEntry::Type type) {
+    using enum SyscallEntry::Type;
+
+    return type == CString || type == NTCStringArray || type == TimeSpecPtr;
+}
+
+} // namespace
+
+bool SyscallRecord::can_decode_args() const {
+    if (decoded_args) {
+        return true;
+    }
+
+    const std::shared_ptr<const TraceeStopState> state = tracee_state.lock();
+
+    return state && state->memory_io != nullptr && state->stop_id == stop_id;
+}
+
+const std::vector<SyscallRecord::SyscallArg>& SyscallRecord::args() const {
+    if (decoded_args) {
+        return *decoded_args;
+    }
+
+    // Memory contents are only meaningful if the tracee has not run since the syscall was entered
+    MemoryIOBase* memory_io = nullptr;
+    if (const auto state = tracee_state.lock(); state && state->stop_id == stop_id) {
+        memory_io = state->memory_io;
+    }
+
+    const auto& syscall_entry = SYSCALL_MAP.at(num);
+    std::vector<SyscallArg> result;
+
+    for (const auto& [reg_value, syscall_param] : ranges::views::zip(raw_args, syscall_entry.parameters())) {
+        result.push_back(decode_arg(reg_value, syscall_param.type, memory_io));
+    }
+
+    decoded_args = std::move(result);
+
+    return *decoded_args;
+}
+
+// FIXME: Parse fixed-length strings seperately
+SyscallRecord::SyscallArg SyscallRecord::decode_arg(u64 value, SyscallEntry::Type type, MemoryIOBase* memory_io) {
+    using enum SyscallEntry::Type;
+
+    if (memory_io == nullptr && refers_to_memory(type)) {
+        LOG_DEBUG("Tracee memory for syscall argument at {:#x} is no longer available", value);
+
+        switch (type) {
+        case CString:
+            return Result<std::string>{ErrorKind::UnknownError};
+        case NTCStringArray:
+            return Result<std::vector<Result<std::string>>>{ErrorKind::UnknownError};
+        default:
+            return Result<std::timespec>{ErrorKind::UnknownError};
+        }
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto convert = [&]<typename T>(T /*unused*/) { return *reinterpret_cast<T*>(&value); };
+
+    switch (type) {
+    case Int32:
+        return convert(i32{});
+    case Int64:
+        return convert(i64{});
+    case Uint32:
+        return convert(u32{});
+    case Uint64:
+        return convert(u64{});
+    case VoidPtr:
+        return convert(static_cast<void*>(nullptr));
+
+    case CString:
+        return memory_io->read<std::string>(value);
+    case NTCStringArray: {
+        auto string_ptr_array =
+            memory_io->read_array<std::uintptr_t>(value, [](const auto& elem) { return elem == 0; });
+
+        if (!string_ptr_array) {
+            // FIXME: ouch... these types hurt me
+            return Result<std::vector<Result<std::string>>>{string_ptr_array.error()};
+        }
+
+        std::vector<Result<std::string>> result(string_ptr_array->size());
+        for (const auto& [ptr, elem] : ranges::views::zip(string_ptr_array.value(), result)) {
+            elem = memory_io->read<std::string>(ptr);
+        }
+
+        return {Result<decltype(result)>{result}};
+    }
+
+    case TimeSpecPtr:
+        return memory_io->read<std::timespec>(value);
+
+    default:
+        UNREACHABLE(false, "Invalid syscall entry type parse");
+    }
+}
+
+} // namespace asmgrader
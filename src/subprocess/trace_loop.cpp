@@ -0,0 +1,110 @@
+#include "subprocess/trace_loop.hpp"
+
+#include "common/error_types.hpp"
+#include "logging.hpp"
+#include "subprocess/run_result.hpp"
+#include "subprocess/syscall_record.hpp"
+#include "subprocess/tracer.hpp"
+#include "subprocess/tracer_options.hpp"
+#include "subprocess/tracer_types.hpp"
+
+#include <libassert/assert.hpp>
+#include <range/v3/algorithm/find_if.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace asmgrader {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+/// Timeout of each poll by \ref TraceLoop::run. Runs are ticked more often than this as needed.
+constexpr auto RUN_POLL_TIMEOUT = 100ms;
+
+} // namespace
+
+Result<void> TraceLoop::start(Tracer& tracer, Callback on_done, std::function<bool(SyscallRecord)> pred,
+                              TracingPolicy policy) {
+    TRY(tracer.start_run(std::move(pred), policy));
+
+    runs_.push_back({.tracer = &tracer, .on_done = std::move(on_done)});
+
+    return {};
+}
+
+std::size_t TraceLoop::poll(std::chrono::nanoseconds timeout) {
+    std::vector<std::pair<Callback, Result<RunResult>>> finished;
+
+    const auto finish = [&finished](Run& run, Result<RunResult> result) {
+        finished.emplace_back(std::move(run.on_done), std::move(result));
+        run.tracer = nullptr;
+    };
+
+    // Enforce the limits of every run, and determine how long we may wait before that has to be done again
+    for (Run& run : runs_) {
+        auto tick_res = run.tracer->tick_run();
+
+        if (!tick_res) {
+            finish(run, tick_res.error());
+            continue;
+        }
+
+        timeout = std::min(timeout, *tick_res);
+    }
+
+    std::erase_if(runs_, [](const Run& run) { return run.tracer == nullptr; });
+
+    // Runs that are over are reported before waiting on the rest
+    if (finished.empty() && !runs_.empty()) {
+        pids_.clear();
+        std::ranges::transform(runs_, std::back_inserter(pids_), [](const Run& run) { return run.tracer->get_pid(); });
+
+        auto wait_res = TracedWaitid::wait_any_with_timeout(pids_, timeout);
+
+        if (!wait_res) {
+            if (wait_res != ErrorKind::TimedOut) {
+                LOG_WARN("Failed to wait on {} tracees: {}", pids_.size(), wait_res.error());
+            }
+
+            return 0;
+        }
+
+        for (const auto& [pid, waitid_data] : *wait_res) {
+            auto run_iter = ranges::find_if(
+                runs_, [pid](const Run& run) { return run.tracer != nullptr && run.tracer->get_pid() == pid; });
+            ASSERT(run_iter != runs_.end(), "state change of a tracee without a run", pid);
+
+            if (auto run_result = run_iter->tracer->handle_stop(waitid_data)) {
+                finish(*run_iter, std::move(*run_result));
+            }
+        }
+
+        std::erase_if(runs_, [](const Run& run) { return run.tracer == nullptr; });
+    }
+
+    // Only now that runs_ is consistent, as callbacks may start new runs
+    for (auto& [on_done, result] : finished) {
+        if (on_done) {
+            on_done(std::move(result));
+        }
+    }
+
+    return finished.size();
+}
+
+void TraceLoop::run() {
+    while (!runs_.empty()) {
+        poll(RUN_POLL_TIMEOUT);
+    }
+}
+
+} // namespace asmgrader
@@ -1,29 +1,53 @@
 #include "subprocess/traced_subprocess.hpp"
 
 #include "common/error_types.hpp"
+#include "common/linux.hpp"
 #include "logging.hpp"
+#include "subprocess/fork_server.hpp"
 #include "subprocess/run_result.hpp"
 #include "subprocess/subprocess.hpp"
 #include "subprocess/syscall_record.hpp"
 #include "subprocess/tracer.hpp"
+#include "subprocess/tracer_options.hpp"
+
+#include <fmt/format.h>
 
 #include <chrono>
 #include <functional>
-#include <thread>
+#include <string>
 #include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
 
 namespace asmgrader {
 
+TracedSubprocess::TracedSubprocess(std::string exec, std::vector<std::string> args, TracerOptions options)
+    : Subprocess(std::move(exec), std::move(args))
+    , tracer_{std::move(options)} {
+    tracer_.set_stdin_pump(&get_stdin_pump());
+    tracer_.set_stdout_buffer(&get_stdout_buffer(), &get_stdout_pipe());
+}
+
+TracedSubprocess::TracedSubprocess(ForkServer& fork_server)
+    : TracedSubprocess(fork_server.get_exec(), fork_server.get_args(), fork_server.get_options()) {
+    fork_server_ = &fork_server;
+}
+
 TracedSubprocess::~TracedSubprocess() {
-    using namespace std::chrono_literals;
+    // if the pid is 0, then initialization failed, or the object was moved from
+    if (get_pid() == 0) {
+        return;
+    }
 
+    // Also means that a child blocked on reading stdin gets an EOF if it's run again
     std::ignore = close_pipes();
 
-    // Give the child time to complete operations in case that open pipes were blocking
-    std::this_thread::sleep_for(10ms);
-
-    // Try running child process to exit one last time, as it may have been blocking on open pipes
-    if (is_alive()) {
+    // The child is stopped whenever it's not being run, so all of this is decided from the tracer's state
+    if (is_alive() && (teardown_policy_ == TeardownPolicy::Drain || tracer_.will_exit_when_resumed())) {
         std::ignore = run();
     }
 
@@ -37,7 +61,7 @@ TracedSubprocess::~TracedSubprocess() {
 Result<void> TracedSubprocess::init_child() {
     TRY(Subprocess::init_child());
 
-    TRY(Tracer::init_child());
+    TRY(tracer_.init_child());
 
     return {};
 }
@@ -47,15 +71,76 @@ Result<void> TracedSubprocess::init_parent() {
 
     TRY(tracer_.begin(get_pid()));
 
+    checkpoint_startup_state();
+
+    return {};
+}
+
+void TracedSubprocess::checkpoint_startup_state() {
+    if (auto res = tracer_.checkpoint(); !res) {
+        LOG_DEBUG("Failed to checkpoint tracee (pid={}); restarts will spawn a new process ({})", get_pid(), res);
+    }
+}
+
+Result<void> TracedSubprocess::restart() {
+    // Restoring in place requires the same pipes to still be usable
+    const bool can_restore =
+        tracer_.has_checkpoint() && is_alive() && get_stdin_pipe().write_fd != -1 && get_stdout_pipe().read_fd != -1;
+
+    if (can_restore) {
+        // The child's stdin may also have been closed, in which case the process must be restarted anyways
+        if (tracer_.restore_checkpoint() && discard_pending_stdin()) {
+            return {};
+        }
+
+        LOG_DEBUG("Could not restore tracee (pid={}) in place; spawning a new process", get_pid());
+    }
+
+    return Subprocess::restart();
+}
+
+Result<void> TracedSubprocess::discard_pending_stdin() {
+    // The child may have closed its stdin, which restoring the checkpoint does not undo
+    TRYE(linux::stat(fmt::format("/proc/{}/fd/{}", get_pid(), STDIN_FILENO)), SyscallFailure);
+
+    TRY(get_stdin_pump().discard());
+
+    return {};
+}
+
+Result<void> TracedSubprocess::create(const std::string& exec, const std::vector<std::string>& args) {
+    if (fork_server_ == nullptr) {
+        return Subprocess::create(exec, args);
+    }
+
+    TRY(create_pipes());
+
+    pid_t pid = TRY(fork_server_->fork_child());
+    set_child_pid(pid);
+
+    TRY(tracer_.begin_forked(pid, fork_server_->get_tracer()));
+
+    // The child shares the fds of the pristine tracee, so the ends of our new pipes are installed
+    // in its place, by way of the grader's /proc/<pid>/fd entries
+    auto proc_fd_path = [](int fd) { return fmt::format("/proc/{}/fd/{}", getpid(), fd); };
+
+    TRY(tracer_.redirect_fd(STDIN_FILENO, proc_fd_path(get_stdin_pipe().read_fd), O_RDONLY));
+    TRY(tracer_.redirect_fd(STDOUT_FILENO, proc_fd_path(get_stdout_pipe().write_fd), O_WRONLY));
+
+    // Tracer::begin must not be run again for the child, so skip our own override
+    TRY(Subprocess::init_parent());
+
+    checkpoint_startup_state();
+
     return {};
 }
 
-Result<RunResult> TracedSubprocess::run() {
-    return tracer_.run();
+Result<RunResult> TracedSubprocess::run(TracingPolicy policy) {
+    return tracer_.run(policy);
 }
 
-Result<RunResult> TracedSubprocess::run_until(const std::function<bool(SyscallRecord)>& pred) {
-    return tracer_.run_until(pred);
+Result<RunResult> TracedSubprocess::run_until(const std::function<bool(SyscallRecord)>& pred, TracingPolicy policy) {
+    return tracer_.run_until(pred, policy);
 }
 
 Result<int> TracedSubprocess::wait_for_exit(std::chrono::microseconds /*timeout*/) {
@@ -10,8 +10,15 @@
 #include "common/os.hpp"
 #include "common/unreachable.hpp"
 #include "logging.hpp"
-#include "subprocess/memory/ptrace_memory_io.hpp"
+#include "subprocess/memory/memory_io_factory.hpp"
+#include "subprocess/memory/memory_snapshot.hpp"
+#include "subprocess/memory/shared_memory_io.hpp"
+#include "subprocess/memory/shared_region.hpp"
+#include "subprocess/memory/tracee_heap.hpp"
+#include "subprocess/output_buffer.hpp"
 #include "subprocess/run_result.hpp"
+#include "subprocess/seccomp_filter.hpp"
+#include "subprocess/stdin_pump.hpp"
 #include "subprocess/syscall.hpp"
 #include "subprocess/syscall_record.hpp"
 #include "subprocess/tracer_types.hpp"
@@ -23,10 +30,13 @@
 #include <libassert/assert.hpp>
 #include <range/v3/algorithm.hpp>
 #include <range/v3/view.hpp>
-#include <range/v3/view/zip.hpp>
 
+#include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <csignal>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
@@ -37,6 +47,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -55,29 +66,214 @@ namespace asmgrader {
 
 using namespace std::chrono_literals;
 
+namespace {
+
+// NOLINTBEGIN(readability-magic-numbers) : they're instr opcodes, hex is alright as long as there are comments
+
+/// Encoding of a syscall instruction, padded to 4 bytes
+NativeByteVector syscall_gadget() {
+#if defined(ASMGRADER_AARCH64)
+    // Encoding for:
+    //   svc 0         - d4000001
+    return to_bytes<NativeByteVector, u32>(0xD4000001);
+#elif defined(ASMGRADER_X86_64)
+    // Encoding for:
+    //   syscall - 0f05
+    //   nop     - 90
+    return {0x0F, 0x05, 0x90, 0x90};
+#endif
+}
+
+/// Encoding of a breakpoint instruction, which raises a SIGTRAP
+NativeByteVector breakpoint_gadget() {
+#if defined(ASMGRADER_AARCH64)
+    // Encoding for:
+    //   brk 0x1234    - d4224680
+    return to_bytes<NativeByteVector, u32>(0xD4224680);
+#elif defined(ASMGRADER_X86_64)
+    // Encoding for:
+    //   int3 - 0xcc
+    return {0xCC};
+#endif
+}
+
+/// Encoding of the loop used by Tracer::setup_batch_call. It addresses its state PC-relatively, which must be
+/// 32 bytes before the loop: 3 words of the current table entry, the end of the table, and the function's address.
+NativeByteVector batch_loop_gadget() {
+    static_assert(Tracer::BATCH_CALL_ENTRY_WORDS * sizeof(u64) == 56, "Table entry offsets below must be updated");
+
+#if defined(ASMGRADER_AARCH64)
+    // Encoding for:
+    //   loop:
+    //     adr  x9, state          - 10ffff09
+    //     ldr  x10, [x9]          - f940012a
+    //     ldr  x11, [x9, #8]      - f940052b
+    //     cmp  x10, x11           - eb0b015f
+    //     b.hs done               - 54000182
+    //     ldp  x0, x1, [x10]      - a9400540
+    //     ldp  x2, x3, [x10, #16] - a9410d42
+    //     ldp  x4, x5, [x10, #32] - a9421544
+    //     ldr  x12, [x9, #16]     - f940092c
+    //     blr  x12                - d63f0180
+    //     adr  x9, state          - 10fffdc9
+    //     ldr  x10, [x9]          - f940012a
+    //     str  x0, [x10, #48]     - f9001940
+    //     add  x10, x10, #56      - 9100e14a
+    //     str  x10, [x9]          - f900012a
+    //     b    loop               - 17fffff1
+    //   done:
+    //     brk  0x1234             - d4224680
+    return to_bytes<NativeByteVector, u32, u32, u32, u32, u32, u32, u32, u32, u32, u32, u32, u32, u32, u32, u32, u32,
+                    u32>(0x10FFFF09, 0xF940012A, 0xF940052B, 0xEB0B015F, 0x54000182, 0xA9400540, 0xA9410D42,
+                         0xA9421544, 0xF940092C, 0xD63F0180, 0x10FFFDC9, 0xF940012A, 0xF9001940, 0x9100E14A,
+                         0xF900012A, 0x17FFFFF1, 0xD4224680);
+#elif defined(ASMGRADER_X86_64)
+    // Encoding for:
+    //   loop:
+    //     mov r11, [rip+cursor]       - 4c 8b 1d d9 ff ff ff
+    //     cmp r11, [rip+end]          - 4c 3b 1d da ff ff ff
+    //     jae done                    - 73 32
+    //     mov rdi, [r11]              - 49 8b 3b
+    //     mov rsi, [r11+8]            - 49 8b 73 08
+    //     mov rdx, [r11+16]           - 49 8b 53 10
+    //     mov rcx, [r11+24]           - 49 8b 4b 18
+    //     mov r8, [r11+32]            - 4d 8b 43 20
+    //     mov r9, [r11+40]            - 4d 8b 4b 28
+    //     call [rip+function]         - ff 15 c3 ff ff ff
+    //     mov r11, [rip+cursor]       - 4c 8b 1d ac ff ff ff
+    //     mov [r11+48], rax           - 49 89 43 30
+    //     add qword [rip+cursor], 56  - 48 83 05 a0 ff ff ff 38
+    //     jmp loop                    - eb be
+    //   done:
+    //     int3                        - cc
+    return {0x4C, 0x8B, 0x1D, 0xD9, 0xFF, 0xFF, 0xFF, //
+            0x4C, 0x3B, 0x1D, 0xDA, 0xFF, 0xFF, 0xFF, //
+            0x73, 0x32,                               //
+            0x49, 0x8B, 0x3B,                         //
+            0x49, 0x8B, 0x73, 0x08,                   //
+            0x49, 0x8B, 0x53, 0x10,                   //
+            0x49, 0x8B, 0x4B, 0x18,                   //
+            0x4D, 0x8B, 0x43, 0x20,                   //
+            0x4D, 0x8B, 0x4B, 0x28,                   //
+            0xFF, 0x15, 0xC3, 0xFF, 0xFF, 0xFF,       //
+            0x4C, 0x8B, 0x1D, 0xAC, 0xFF, 0xFF, 0xFF, //
+            0x49, 0x89, 0x43, 0x30,                   //
+            0x48, 0x83, 0x05, 0xA0, 0xFF, 0xFF, 0xFF, 0x38, //
+            0xEB, 0xBE,                               //
+            0xCC};
+#endif
+}
+
+// NOLINTEND(readability-magic-numbers)
+
+/// Number of times to check whether the tracee is blocked within \ref CpuTimeLimits::max_blocked
+constexpr int BLOCKED_CHECKS_PER_LIMIT = 4;
+
+/// Longest wait before retrying to write queued stdin, for when the pipe is full
+constexpr auto STDIN_PUMP_INTERVAL = std::chrono::milliseconds{1};
+
+/// Longest wait before draining stdout again, for when the tracee has just been printing (and so may fill the pipe)
+constexpr auto STDOUT_DRAIN_INTERVAL = std::chrono::milliseconds{1};
+
+/// Whether `pid` is sleeping in the kernel (e.g., in a blocking read), rather than running or runnable
+bool is_blocked_in_kernel(pid_t pid) {
+    // see proc_pid_stat(5); format: pid (comm) state ...
+    std::ifstream stat_file(fmt::format("/proc/{}/stat", pid));
+    std::string stat;
+
+    if (!std::getline(stat_file, stat)) {
+        return false;
+    }
+
+    // comm may itself contain parentheses, but not the final one
+    const std::size_t comm_end = stat.rfind(')');
+    if (comm_end == std::string::npos || comm_end + 2 >= stat.size()) {
+        return false;
+    }
+
+    const char state = stat[comm_end + 2];
+
+    return state == 'S' || state == 'D';
+}
+
+/// Whether syscall `nr` is stopped for and recorded under `policy`
+bool is_traced_by(TracingPolicy policy, u64 nr) {
+    switch (policy) {
+    case TracingPolicy::None:
+        return false;
+    case TracingPolicy::ExitOnly:
+        return nr == SYS_exit || nr == SYS_exit_group;
+    case TracingPolicy::Filtered:
+    case TracingPolicy::Full:
+        return true;
+    }
+
+    unreachable();
+}
+
+} // namespace
+
+Tracer::Tracer(TracerOptions options)
+    : options_{std::move(options)} {
+    if (options_.traced_syscalls) {
+        std::vector<u64> syscall_nrs = *options_.traced_syscalls;
+
+        // Always needed to observe the termination of the program
+        syscall_nrs.push_back(SYS_exit);
+        syscall_nrs.push_back(SYS_exit_group);
+
+        seccomp_filter_.emplace(syscall_nrs);
+    }
+}
+
 Result<void> Tracer::begin(pid_t pid) {
     pid_ = pid;
+    checkpoint_.reset();
+    regs_cache_ = {};
+    fp_regs_cache_ = {};
+    mmaped_address_ = 0;
 
     assert_invariants();
 
-    // TODO: Extract this
-    memory_io_ = std::make_unique<PtraceMemoryIO>(pid);
-
-    // Wait for SIGSTOP raised by Tracer::init_child
+    // Wait for either the SIGSTOP raised by Tracer::init_child, or the SIGTRAP after exec of a child that only
+    // requested to be traced
     auto waitid_res = TRYE(TracedWaitid::waitid(P_PID, static_cast<id_t>(pid_)), SyscallFailure);
-    ASSERT(waitid_res.signal_num == SIGSTOP, "Tracer::init_child was not called in child process");
     LOG_DEBUG("Waitid returned: {}", waitid_res);
+
+    if (waitid_res.type == CLD_EXITED || waitid_res.type == CLD_KILLED || waitid_res.type == CLD_DUMPED) {
+        LOG_WARN("Child process (pid={}) exited before it could be traced", pid_);
+        return ErrorKind::SyscallFailure;
+    }
+
+    const bool stopped_after_exec = waitid_res.signal_num == SIGTRAP;
+    ASSERT(waitid_res.signal_num == SIGSTOP || (stopped_after_exec && !requires_init_child()),
+           "Tracer::init_child was not called in child process");
+
     // Set options:
     //   Stop tracee upon execve
     //   Deliver a info on a syscall trap (see TracedWaitid::parse or ptrace(2))
-    TRYE(linux::ptrace(PTRACE_SETOPTIONS, pid_, NULL, PTRACE_O_TRACEEXEC | PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL),
-         SyscallFailure);
+    //   Stop tracee upon a SECCOMP_RET_TRACE filter result, if we're using a filter
+    TRYE(linux::ptrace(PTRACE_SETOPTIONS, pid_, NULL, get_ptrace_options()), SyscallFailure);
 
-    TRY(resume_until([](TracedWaitid event) { return event.ptrace_event == PtraceEvent::Exec; }));
+    // Otherwise, the tracee is already where we want it. The SIGTRAP is suppressed upon the next resumption.
+    if (!stopped_after_exec) {
+        TRY(resume_until([](TracedWaitid event) { return event.ptrace_event == PtraceEvent::Exec; }));
 
-    // TODO: Figure out exactly what's going on here
-    // I think a syscall-exit occurs after PTRACE_EXEC event
-    TRY(resume_until([](TracedWaitid wait_res) { return wait_res.is_syscall_trap; }, DEFAULT_TIMEOUT, PTRACE_SYSCALL));
+        // TODO: Figure out exactly what's going on here
+        // I think a syscall-exit occurs after PTRACE_EXEC event
+        TRY(resume_until([](TracedWaitid wait_res) { return wait_res.is_syscall_trap; }, DEFAULT_TIMEOUT,
+                         PTRACE_SYSCALL));
+    }
+
+    // Memory IO must only be set up after exec, as /proc/<pid>/mem refers to the address space at the time of opening.
+    TRY(init_memory_io());
+    TRY(init_cpu_clock());
+
+    // The child may have failed to install the filter, in which case we just trace everything
+    seccomp_active_ = seccomp_filter_ && SeccompTraceFilter::is_installed(pid_).value_or(false);
+    if (seccomp_filter_ && !seccomp_active_) {
+        LOG_WARN("Seccomp filter was not installed in tracee; falling back to tracing all syscalls");
+    }
 
     // Set up mmap to give some anonymous anywhere on the system of size PAGE_SIZE
     // (4096). This is to be used for some instructions to not overwrite code
@@ -94,16 +290,293 @@ Result<void> Tracer::begin(pid_t pid) {
 
     LOG_DEBUG("mmaped address: {:#X}", mmaped_address_);
 
+    TRY(install_trampoline());
+
+    TRY(map_shared_region());
+
+    // Only applicable if this tracer was used for a previous process
+    TRY(map_heap_arenas());
+
+    return {};
+}
+
+Result<void> Tracer::begin_forked(pid_t pid, const Tracer& parent) {
+    pid_ = pid;
+    checkpoint_.reset();
+    regs_cache_ = {};
+    fp_regs_cache_ = {};
+
+    assert_invariants();
+
+    // Options are inherited from the parent tracee, which had fork tracing enabled at the time
+    TRYE(linux::ptrace(PTRACE_SETOPTIONS, pid_, NULL, get_ptrace_options()), SyscallFailure);
+
+    TRY(init_memory_io());
+    TRY(init_cpu_clock());
+
+    // The forked tracee is a copy of the parent, including its seccomp filter and our mmapped page
+    seccomp_active_ = parent.seccomp_active_;
+    mmaped_address_ = parent.mmaped_address_;
+
+    // The child inherited the parent's mapping of its shared region, which must not remain shared with the parent
+    if (parent.shared_address_ != 0) {
+        TRY(execute_checked_syscall(SYS_munmap, {parent.shared_address_, parent.shared_region_.size(), 0, 0, 0, 0}));
+    }
+
+    TRY(map_shared_region());
+    TRY(map_heap_arenas());
+
+    return {};
+}
+
+Result<pid_t> Tracer::fork_tracee() {
+    assert_invariants();
+
+    const user_regs_struct orig_regs = TRY(get_registers());
+
+    // Automatically attach to the new child
+    TRYE(linux::ptrace(PTRACE_SETOPTIONS, pid_, NULL, get_ptrace_options() | PTRACE_O_TRACEFORK), SyscallFailure);
+
+    // CLONE_PARENT makes the new child *our* child, rather than the tracee's. Thus, it may be waited on as any other,
+    // and the tracee does not accumulate zombies.
+    // Exit signal of SIGCHLD is equivalent to fork(2), which does not exist on aarch64
+    auto clone_res = execute_syscall(SYS_clone, {/*flags=*/CLONE_PARENT | SIGCHLD, 0, 0, 0, 0, 0});
+
+    TRYE(linux::ptrace(PTRACE_SETOPTIONS, pid_, NULL, get_ptrace_options()), SyscallFailure);
+
+    const SyscallRecord clone_rec = TRY(clone_res);
+    if (!clone_rec.ret || clone_rec.ret->has_error()) {
+        LOG_WARN("Failed to fork tracee (pid={}): {}", pid_, clone_rec.ret);
+        return ErrorKind::SyscallFailure;
+    }
+
+    const auto child_pid = gsl::narrow_cast<pid_t>(clone_rec.ret->value());
+
+    // An automatically attached child starts with a SIGSTOP
+    auto waitid_res = TRYE(TracedWaitid::waitid(P_PID, static_cast<id_t>(child_pid)), SyscallFailure);
+    ASSERT(waitid_res.signal_num == SIGSTOP, "Unexpected initial state of forked tracee", waitid_res);
+
+    // Undo the syscall injection in the child, so that it is an exact copy of the tracee as it is now.
+    // The syscall ran from the trampoline, so only the registers differ.
+    user_regs_struct child_regs = orig_regs;
+    iovec iov = {.iov_base = &child_regs, .iov_len = sizeof(child_regs)};
+    TRYE(linux::ptrace(PTRACE_SETREGSET, child_pid, NT_PRSTATUS, &iov), SyscallFailure);
+
+    LOG_DEBUG("Forked tracee pid={} from pid={}", child_pid, pid_);
+
+    return child_pid;
+}
+
+Result<void> Tracer::redirect_fd(int target_fd, const std::string& path, int flags) {
+    // The mmapped page is only used as scratch space here; it's overwritten upon setting up a function call
+    const std::uintptr_t path_addr = mmaped_address_ + TRAMPOLINE_SIZE;
+    TRY(memory_io_->write(path_addr, path));
+
+    // openat is used, as open(2) does not exist on aarch64
+    const i64 new_fd = TRY(execute_checked_syscall(SYS_openat, {static_cast<u64>(AT_FDCWD), path_addr,
+                                                               static_cast<u64>(flags), 0, 0, 0}));
+
+    if (new_fd != target_fd) {
+        TRY(execute_checked_syscall(SYS_dup3, {static_cast<u64>(new_fd), static_cast<u64>(target_fd), 0, 0, 0, 0}));
+        TRY(execute_checked_syscall(SYS_close, {static_cast<u64>(new_fd), 0, 0, 0, 0, 0}));
+    }
+
+    return {};
+}
+
+Result<i64> Tracer::execute_checked_syscall(u64 sys_nr, std::array<std::uint64_t, 6> args) {
+    const SyscallRecord rec = TRY(execute_syscall(sys_nr, args));
+
+    if (!rec.ret || rec.ret->has_error()) {
+        LOG_WARN("Injected syscall {} failed in tracee (pid={}): {}", SYSCALL_MAP.at(sys_nr).name(), pid_, rec.ret);
+        return ErrorKind::SyscallFailure;
+    }
+
+    return rec.ret->value();
+}
+
+int Tracer::get_ptrace_options() const {
+    int ptrace_options = PTRACE_O_TRACEEXEC | PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL;
+
+    if (seccomp_filter_) {
+        ptrace_options |= PTRACE_O_TRACESECCOMP;
+    }
+
+    return ptrace_options;
+}
+
+Result<void> Tracer::init_memory_io() {
+    // The instruction pointer is within .text, which is a good target for the (one-time) capability probe
+    const user_regs_struct regs = TRY(get_registers());
+#if defined(ASMGRADER_AARCH64)
+    const std::uintptr_t instr_ptr = regs.pc;
+#elif defined(ASMGRADER_X86_64)
+    const std::uintptr_t instr_ptr = regs.rip;
+#endif
+
+    auto memory_io = make_memory_io(pid_, options_.memory_io, instr_ptr);
+    if (!memory_io) {
+        return memory_io.error();
+    }
+
+    if (options_.shared_heap_size > 0) {
+        // The shared region is registered once it's mapped; see map_shared_region
+        auto shared_memory_io = std::make_unique<SharedMemoryIO>(std::move(*memory_io));
+        shared_memory_io_ = shared_memory_io.get();
+        memory_io_ = std::move(shared_memory_io);
+    } else {
+        shared_memory_io_ = nullptr;
+        memory_io_ = std::move(*memory_io);
+    }
+
+    // Records of a previous tracee must not be decoded with the new tracee's memory
+    stop_state_->memory_io = memory_io_.get();
+    ++stop_state_->stop_id;
+
+    return {};
+}
+
+Result<void> Tracer::init_cpu_clock() {
+    cpu_clock_ = TRYE(linux::clock_getcpuclockid(pid_), SyscallFailure);
+    cpu_time_at_begin_ = {};
+    cpu_time_at_begin_ = TRY(get_cpu_time_used());
+
     return {};
 }
 
-Result<void> Tracer::init_child() {
+bool Tracer::will_exit_when_resumed() const {
+    if (exit_code_) {
+        return false;
+    }
+
+    struct ptrace_syscall_info info{};
+
+    // Fails if the tracee is not stopped
+    if (!linux::ptrace(PTRACE_GET_SYSCALL_INFO, pid_, sizeof(info), &info)) {
+        return false;
+    }
+
+    u64 nr{};
+    if (info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+        nr = info.entry.nr;
+    } else if (info.op == PTRACE_SYSCALL_INFO_SECCOMP) {
+        nr = info.seccomp.nr;
+    } else {
+        return false;
+    }
+
+    return nr == SYS_exit || nr == SYS_exit_group;
+}
+
+Result<std::chrono::nanoseconds> Tracer::get_cpu_time_used() const {
+    const timespec cpu_time = TRYE(linux::clock_gettime(cpu_clock_), SyscallFailure);
+
+    return std::chrono::seconds{cpu_time.tv_sec} + std::chrono::nanoseconds{cpu_time.tv_nsec} - cpu_time_at_begin_;
+}
+
+Result<std::chrono::nanoseconds> Tracer::tick_run() {
+    using std::chrono::steady_clock;
+
+    ASSERT(active_run_, "no run in progress");
+    ActiveRun& run = *active_run_;
+    const CpuTimeLimits& limits = options_.cpu_time_limits;
+
+    // Deliver as much pending input as the tracee has made room for, before it might block on reading it
+    std::size_t num_pumped = 0;
+    if (stdin_pump_ != nullptr) {
+        num_pumped = stdin_pump_->pump().value_or(0);
+    }
+
+    // Likewise, make room for more output before the tracee might block on writing it
+    std::size_t num_drained = 0;
+    if (stdout_buffer_ != nullptr && stdout_pipe_ != nullptr && stdout_pipe_->read_fd != -1) {
+        num_drained = stdout_buffer_->drain(stdout_pipe_->read_fd).value_or(0);
+    }
+
+    // The clock is gone once the tracee is reaped, but there's a pending state change to observe by then
+    run.cpu_used = get_cpu_time_used().value_or(run.cpu_used);
+
+    std::chrono::nanoseconds remaining = limits.per_run - (run.cpu_used - run.cpu_start);
+    if (limits.total) {
+        remaining = std::min(remaining, *limits.total - run.cpu_used);
+    }
+
+    // Either way, the outcome depends on timing, so it's a timeout as far as has_timed_out is concerned
+    const auto stop_timed_out = [this](ErrorKind reason) -> ErrorKind {
+        active_run_.reset();
+        has_timed_out_ = true;
+
+        // stop process to keep in tracable state
+        TRYE(linux::kill(pid_, SIGSTOP), SyscallFailure);
+
+        return reason;
+    };
+
+    if (remaining <= 0ns) {
+        LOG_DEBUG("Child process (pid={}) exceeded its CPU time limits ({} this run, {} in total). Stopping...", pid_,
+                  run.cpu_used - run.cpu_start, run.cpu_used);
+        return stop_timed_out(ErrorKind::TimedOut);
+    }
+
+    // A (single-threaded) tracee can't use CPU time faster than wall-clock time passes, so this never overshoots
+    // the limits. Waits are also kept short enough to notice a tracee that blocks indefinitely.
+    const auto blocked_check_interval = limits.max_blocked / BLOCKED_CHECKS_PER_LIMIT;
+    const auto now = steady_clock::now();
+
+    if (num_pumped != 0 || num_drained != 0) {
+        // Just given input to read, or room to write more output; any blocking was on us, not the tracee
+        run.blocked_since.reset();
+    } else if (now - run.last_blocked_check >= blocked_check_interval) {
+        run.last_blocked_check = now;
+
+        if (!is_blocked_in_kernel(pid_)) {
+            // Either running, or runnable but descheduled
+            run.blocked_since.reset();
+        } else if (!run.blocked_since) {
+            run.blocked_since = now;
+        } else if (now - *run.blocked_since >= limits.max_blocked) {
+            LOG_DEBUG("Child process (pid={}) has been blocked for {}, using no CPU time. Stopping...", pid_,
+                      now - *run.blocked_since);
+            return stop_timed_out(ErrorKind::Blocked);
+        }
+    }
+
+    auto wait_time = std::min<std::chrono::nanoseconds>(remaining, blocked_check_interval);
+    if (stdin_pump_ != nullptr && stdin_pump_->has_queued()) {
+        wait_time = std::min<std::chrono::nanoseconds>(wait_time, STDIN_PUMP_INTERVAL);
+    }
+    if (num_drained != 0) {
+        wait_time = std::min<std::chrono::nanoseconds>(wait_time, STDOUT_DRAIN_INTERVAL);
+    }
+
+    return wait_time;
+}
+
+Result<TracedWaitid> Tracer::wait_within_cpu_limits() {
+    for (;;) {
+        const std::chrono::nanoseconds wait_time = TRY(tick_run());
+
+        auto wait_result = TracedWaitid::wait_with_timeout(pid_, wait_time, options_.wait_spin);
+
+        if (wait_result != ErrorKind::TimedOut) {
+            return wait_result;
+        }
+    }
+}
+
+Result<void> Tracer::init_child() const {
     // Request to be traced by parent process
     TRYE(linux::ptrace(PTRACE_TRACEME), SyscallFailure);
 
     // Stop process so that parent has a chance to attach before further action
     TRYE(linux::raise(SIGSTOP), SyscallFailure);
 
+    // Must be done after the stop above, as the parent sets PTRACE_O_TRACESECCOMP then.
+    // Failure is detected by the parent in `begin`.
+    if (seccomp_filter_) {
+        std::ignore = seccomp_filter_->install();
+    }
+
     return {};
 }
 
@@ -178,29 +651,37 @@ void Tracer::assert_invariants() const {
 SyscallRecord Tracer::get_syscall_entry_info(struct ptrace_syscall_info* entry) const {
     assert_invariants();
 
-    ASSERT(entry->op == PTRACE_SYSCALL_INFO_ENTRY);
+    ASSERT(entry->op == PTRACE_SYSCALL_INFO_ENTRY || entry->op == PTRACE_SYSCALL_INFO_SECCOMP);
 
     // NOLINTBEGIN(cppcoreguidelines-pro-type-union-access) : necessary as return from ptrace(2)
 
-    decltype(SyscallRecord::args) args;
+    // A seccomp stop occurs at syscall entry, and carries the same information
+    const bool is_seccomp = entry->op == PTRACE_SYSCALL_INFO_SECCOMP;
+    const u64 nr = is_seccomp ? entry->seccomp.nr : entry->entry.nr;
+    const auto& raw_args = is_seccomp ? entry->seccomp.args : entry->entry.args;
 
-    // Get info from syscall entry
-    const auto& syscall_entry = SYSCALL_MAP.at(entry->entry.nr);
+    SyscallRecord record{.num = nr,
+                         .raw_args = {},
+                         .ret = std::nullopt,
+                         .instruction_pointer = entry->instruction_pointer,
+                         .stack_pointer = entry->stack_pointer,
+                         .stop_id = stop_state_->stop_id,
+                         .tracee_state = stop_state_,
+                         .decoded_args = std::nullopt};
+
+    ranges::copy(raw_args, record.raw_args.begin());
 
-    for (const auto& [reg_value, syscall_param] : ranges::views::zip(entry->entry.args, syscall_entry.parameters())) {
-        args.push_back(from_syscall_value(reg_value, syscall_param.type));
+    // Arguments are otherwise only decoded on demand, as reading tracee memory is comparatively slow
+    if (should_decode_eagerly(nr)) {
+        std::ignore = record.args();
     }
 
-    return SyscallRecord{.num = entry->entry.nr,
-                         .args = std::move(args),
-                         .ret = std::nullopt,
-                         .instruction_pointer = entry->instruction_pointer,
-                         .stack_pointer = entry->stack_pointer};
+    return record;
 
     // NOLINTEND(cppcoreguidelines-pro-type-union-access)
 }
 
-void Tracer::get_syscall_exit_info(SyscallRecord& rec, struct ptrace_syscall_info* exit) const {
+Expected<i64> Tracer::get_syscall_exit_info(struct ptrace_syscall_info* exit) const {
     assert_invariants();
 
     ASSERT(exit->op == PTRACE_SYSCALL_INFO_EXIT);
@@ -210,16 +691,259 @@ void Tracer::get_syscall_exit_info(SyscallRecord& rec, struct ptrace_syscall_inf
     // Get info (retcode/error) from syscall exit
     i64 ret_val = exit->exit.rval;
 
-    rec.ret = [&]() -> decltype(SyscallRecord::ret) {
-        if (exit->exit.is_error) {
-            return linux::make_error_code(static_cast<int>(-ret_val));
-        }
-        return ret_val;
-    }();
+    if (exit->exit.is_error) {
+        return linux::make_error_code(static_cast<int>(-ret_val));
+    }
+    return ret_val;
 
     // NOLINTEND(cppcoreguidelines-pro-type-union-access)
 }
 
+Result<void> Tracer::checkpoint() {
+    assert_invariants();
+
+    user_regs_struct regs = TRY(get_registers());
+    user_fpregs_struct fp_regs = TRY(get_fp_registers());
+
+    // Heap allocations outlive restores, so the heap's memory is kept out of the snapshot
+    auto memory = MemorySnapshot::take(*memory_io_, get_heap_ranges());
+
+    if (!memory) {
+        return memory.error();
+    }
+
+    checkpoint_.emplace(regs, fp_regs, std::move(memory.value()));
+
+    return {};
+}
+
+Result<void> Tracer::restore_checkpoint() {
+    if (!checkpoint_) {
+        LOG_DEBUG("No checkpoint to restore");
+        return ErrorKind::BadArgument;
+    }
+
+    assert_invariants();
+
+    TRY(skip_pending_syscall());
+
+    // Arenas added since the checkpoint are excluded as well, so they needn't be unmapped
+    TRY(checkpoint_->memory.restore(*memory_io_, get_heap_ranges()));
+    TRY(set_registers(checkpoint_->regs));
+    TRY(set_fp_registers(checkpoint_->fp_regs));
+
+    mmaped_used_amt_ = TRAMPOLINE_SIZE;
+
+    return {};
+}
+
+Result<TraceeAllocation> Tracer::allocate(std::size_t size) {
+    if (auto allocation = heap_->allocate(size)) {
+        return *allocation;
+    }
+
+    const std::size_t length = TraceeHeap::arena_size_for(size);
+
+    const SyscallRecord mmap_rec =
+        TRY(execute_syscall(SYS_mmap, {/*addr=*/0,
+                                       /*length=*/length,
+                                       /*prot=*/PROT_READ | PROT_WRITE,
+                                       /*flags=*/MAP_PRIVATE | MAP_ANONYMOUS,
+                                       // NOLINTNEXTLINE(google-runtime-int)
+                                       /*fd=*/static_cast<unsigned long>(-1),
+                                       /*offset=*/0}));
+
+    if (!mmap_rec.ret || mmap_rec.ret->has_error()) {
+        LOG_WARN("Failed to map {} bytes for tracee heap (pid={}): {}", length, pid_, mmap_rec.ret);
+        return ErrorKind::SyscallFailure;
+    }
+
+    heap_->add_arena(static_cast<std::uintptr_t>(mmap_rec.ret->value()), length);
+
+    LOG_DEBUG("Added tracee heap arena of {} bytes at {:#x}", length, mmap_rec.ret->value());
+
+    auto allocation = heap_->allocate(size);
+    ASSERT(allocation.has_value(), "Tracee heap allocation failed with a sufficiently large arena", size, length);
+
+    return *allocation;
+}
+
+Result<void> Tracer::map_shared_region() {
+    if (options_.shared_heap_size == 0) {
+        return {};
+    }
+
+    if (!shared_region_) {
+        auto region = SharedRegion::create(options_.shared_heap_size);
+
+        if (!region) {
+            LOG_WARN("Could not create memory to share with tracee; the heap will only use private memory");
+            return {};
+        }
+
+        shared_region_ = std::move(region.value());
+    }
+
+    const bool in_heap = ranges::any_of(heap_->get_arenas(), &TraceeHeap::Arena::shared);
+
+    auto use_private_memory = [this, in_heap] {
+        LOG_WARN("Could not map shared memory into tracee (pid={}); the heap will only use private memory", pid_);
+
+        if (in_heap) {
+            heap_->release();
+        }
+        shared_address_ = 0;
+    };
+
+    // As with redirect_fd, the tracee opens our memfd through procfs; the mmapped page is scratch space for the path
+    const std::uintptr_t path_addr = mmaped_address_ + TRAMPOLINE_SIZE;
+    const pid_t grader_pid = TRYE(linux::getpid(), SyscallFailure);
+    TRY(memory_io_->write(path_addr, fmt::format("/proc/{}/fd/{}", grader_pid, shared_region_.get_fd())));
+
+    auto open_res = execute_checked_syscall(
+        SYS_openat, {static_cast<u64>(AT_FDCWD), path_addr, static_cast<u64>(O_RDWR | O_CLOEXEC), 0, 0, 0});
+
+    if (open_res == ErrorKind::SyscallFailure) {
+        use_private_memory();
+        return {};
+    }
+
+    const i64 fd = TRY(open_res);
+
+    auto map_at = [this, fd](std::uintptr_t address, int extra_flags) {
+        return execute_syscall(SYS_mmap, {/*addr=*/address,
+                                          /*length=*/shared_region_.size(),
+                                          /*prot=*/PROT_READ | PROT_WRITE,
+                                          /*flags=*/static_cast<u64>(MAP_SHARED | extra_flags),
+                                          /*fd=*/static_cast<u64>(fd),
+                                          /*offset=*/0});
+    };
+
+    // Prefer the previous address, so that existing allocations stay valid
+    SyscallRecord mmap_rec = TRY(map_at(shared_address_, shared_address_ != 0 ? MAP_FIXED_NOREPLACE : 0));
+    if (shared_address_ != 0 && (!mmap_rec.ret || mmap_rec.ret->has_error())) {
+        mmap_rec = TRY(map_at(0, 0));
+    }
+
+    TRY(execute_checked_syscall(SYS_close, {static_cast<u64>(fd), 0, 0, 0, 0, 0}));
+
+    if (!mmap_rec.ret || mmap_rec.ret->has_error()) {
+        LOG_DEBUG("mmap of shared memory failed: {}", mmap_rec.ret);
+        use_private_memory();
+        return {};
+    }
+
+    const auto address = static_cast<std::uintptr_t>(mmap_rec.ret->value());
+
+    if (in_heap && address != shared_address_) {
+        LOG_WARN("Could not map shared memory at {:#x} (pid={}); existing allocations are abandoned", shared_address_,
+                 pid_);
+        heap_->release();
+    }
+
+    if (!in_heap || address != shared_address_) {
+        heap_->add_arena(address, shared_region_.size(), /*shared=*/true);
+    }
+
+    shared_address_ = address;
+
+    // A new tracee starts out with zeroed heap memory, as if it were mapped privately
+    ranges::fill(shared_region_.get_data(), std::byte{0});
+    shared_memory_io_->set_region(address, shared_region_.get_data());
+
+    LOG_DEBUG("Mapped {} bytes of shared memory at {:#x}", shared_region_.size(), address);
+
+    return {};
+}
+
+std::vector<MemorySnapshot::Range> Tracer::get_heap_ranges() const {
+    std::vector<MemorySnapshot::Range> result;
+
+    for (const TraceeHeap::Arena& arena : heap_->get_arenas()) {
+        result.push_back({.start = arena.start, .end = arena.start + arena.length});
+    }
+
+    return result;
+}
+
+Result<void> Tracer::map_heap_arenas() {
+    for (const TraceeHeap::Arena& arena : heap_->get_arenas()) {
+        if (arena.shared) {
+            continue;
+        }
+
+        const SyscallRecord mmap_rec =
+            TRY(execute_syscall(SYS_mmap, {/*addr=*/arena.start,
+                                           /*length=*/arena.length,
+                                           /*prot=*/PROT_READ | PROT_WRITE,
+                                           /*flags=*/MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+                                           // NOLINTNEXTLINE(google-runtime-int)
+                                           /*fd=*/static_cast<unsigned long>(-1),
+                                           /*offset=*/0}));
+
+        if (!mmap_rec.ret || mmap_rec.ret->has_error() ||
+            static_cast<std::uintptr_t>(mmap_rec.ret->value()) != arena.start) {
+            LOG_WARN("Could not remap tracee heap arena at {:#x} (pid={}): {}; existing allocations are abandoned",
+                     arena.start, pid_, mmap_rec.ret);
+            heap_->release();
+            return {};
+        }
+    }
+
+    return {};
+}
+
+Result<void> Tracer::skip_pending_syscall() {
+    struct ptrace_syscall_info info{};
+    TRYE(linux::ptrace(PTRACE_GET_SYSCALL_INFO, pid_, sizeof(info), &info), SyscallFailure);
+
+    if (info.op != PTRACE_SYSCALL_INFO_ENTRY && info.op != PTRACE_SYSCALL_INFO_SECCOMP) {
+        return {};
+    }
+
+    // An invalid syscall number of -1 makes the kernel skip the syscall; see ptrace(2)
+#if defined(ASMGRADER_AARCH64)
+    // x8 is not consulted after the syscall entry stop, so the number must be changed via its own regset
+    int syscall_nr = -1;
+    iovec iov = {.iov_base = &syscall_nr, .iov_len = sizeof(syscall_nr)};
+    TRYE(linux::ptrace(PTRACE_SETREGSET, pid_, NT_ARM_SYSTEM_CALL, &iov), SyscallFailure);
+#elif defined(ASMGRADER_X86_64)
+    user_regs_struct regs = TRY(get_registers());
+    regs.orig_rax = static_cast<u64>(-1);
+    TRY(set_registers(regs));
+#endif
+
+    // The tracee must get past the syscall, as registers set at the entry stop are clobbered by its return value
+    TRY(resume_until([](TracedWaitid wait_res) { return wait_res.is_syscall_trap; }, DEFAULT_TIMEOUT, PTRACE_SYSCALL));
+
+    return {};
+}
+
+Result<void> Tracer::setup_batch_call(std::uintptr_t fn_addr, std::uintptr_t table_addr, std::size_t num_calls) {
+    assert_invariants();
+
+    const std::uintptr_t table_end = table_addr + num_calls * BATCH_CALL_ENTRY_WORDS * sizeof(u64);
+    TRY(memory_io_->write(mmaped_address_ + TRAMPOLINE_BATCH_STATE_OFFSET,
+                          to_bytes<NativeByteVector>(table_addr, table_end, fn_addr)));
+
+    user_regs_struct regs = TRY(get_registers());
+
+    // Below the red zone of the interrupted code, and aligned as required at a call instruction
+    constexpr std::uintptr_t RED_ZONE_SIZE = 128;
+    constexpr std::uintptr_t STACK_ALIGNMENT = 16;
+#if defined(ASMGRADER_AARCH64)
+    regs.sp = (regs.sp - RED_ZONE_SIZE) & ~(STACK_ALIGNMENT - 1);
+    regs.pc = mmaped_address_ + TRAMPOLINE_BATCH_LOOP_OFFSET;
+#elif defined(ASMGRADER_X86_64)
+    regs.rsp = (regs.rsp - RED_ZONE_SIZE) & ~(STACK_ALIGNMENT - 1);
+    regs.rip = mmaped_address_ + TRAMPOLINE_BATCH_LOOP_OFFSET;
+#endif
+
+    TRY(set_registers(regs));
+
+    return {};
+}
+
 Result<void> Tracer::jump_to(std::uintptr_t address) {
     auto regs = TRY(get_registers());
 #if defined(ASMGRADER_AARCH64)
@@ -233,37 +957,58 @@ Result<void> Tracer::jump_to(std::uintptr_t address) {
 }
 
 Result<user_regs_struct> Tracer::get_registers() const {
-    user_regs_struct result{};
-
-    iovec iov = {.iov_base = &result, .iov_len = sizeof(result)};
+    return get_cached_regset(regs_cache_, NT_PRSTATUS);
+}
 
-    TRYE(linux::ptrace(PTRACE_GETREGSET, pid_, NT_PRSTATUS, &iov), SyscallFailure);
+Result<void> Tracer::set_registers(user_regs_struct regs) const {
+    regs_cache_ = {.regs = regs, .dirty = true};
 
-    return result;
+    return {};
 }
 
-Result<void> Tracer::set_registers(user_regs_struct regs) const {
-    iovec iov = {.iov_base = &regs, .iov_len = sizeof(regs)};
+Result<user_fpregs_struct> Tracer::get_fp_registers() const {
+    return get_cached_regset(fp_regs_cache_, NT_FPREGSET);
+}
 
-    TRYE(linux::ptrace(PTRACE_SETREGSET, pid_, NT_PRSTATUS, &iov), SyscallFailure);
+Result<void> Tracer::set_fp_registers(user_fpregs_struct regs) const {
+    fp_regs_cache_ = {.regs = regs, .dirty = true};
 
     return {};
 }
 
-Result<user_fpregs_struct> Tracer::get_fp_registers() const {
-    user_fpregs_struct result{};
+template <typename Regs>
+Result<Regs> Tracer::get_cached_regset(RegisterCache<Regs>& cache, int regset) const {
+    if (cache.regs) {
+        return *cache.regs;
+    }
+
+    Regs result{};
 
     iovec iov = {.iov_base = &result, .iov_len = sizeof(result)};
 
-    TRYE(linux::ptrace(PTRACE_GETREGSET, pid_, NT_FPREGSET, &iov), SyscallFailure);
+    TRYE(linux::ptrace(PTRACE_GETREGSET, pid_, regset, &iov), SyscallFailure);
+
+    cache = {.regs = result, .dirty = false};
 
     return result;
 }
 
-Result<void> Tracer::set_fp_registers(user_fpregs_struct regs) const {
-    iovec iov = {.iov_base = &regs, .iov_len = sizeof(regs)};
+template <typename Regs>
+Result<void> Tracer::flush_regset(RegisterCache<Regs>& cache, int regset) const {
+    if (cache.regs && cache.dirty) {
+        iovec iov = {.iov_base = &*cache.regs, .iov_len = sizeof(Regs)};
 
-    TRYE(linux::ptrace(PTRACE_SETREGSET, pid_, NT_FPREGSET, &iov), SyscallFailure);
+        TRYE(linux::ptrace(PTRACE_SETREGSET, pid_, regset, &iov), SyscallFailure);
+    }
+
+    cache = {};
+
+    return {};
+}
+
+Result<void> Tracer::flush_registers() const {
+    TRY(flush_regset(regs_cache_, NT_PRSTATUS));
+    TRY(flush_regset(fp_regs_cache_, NT_FPREGSET));
 
     return {};
 }
@@ -272,24 +1017,13 @@ Result<SyscallRecord> Tracer::execute_syscall(u64 sys_nr, std::array<std::uint64
     auto orig_regs = TRY(get_registers());
     auto new_regs = orig_regs;
 
-    // NOLINTBEGIN(readability-magic-numbers) : they're instr opcodes, hex is alright as long as there are comments
-
     // See syscall(2) for arguments order and registers
 #if defined(ASMGRADER_AARCH64)
     // syscall args are x0-x5
     ranges::copy(args, new_regs.regs);
     // syscall nr is x8
     new_regs.regs[8] = sys_nr;
-    u64 instr_ptr = orig_regs.pc;
-
-    auto orig_instrs = TRY(memory_io_->read_bytes(instr_ptr, 8));
-
-    // Encoding for:
-    //   svc 0         - d4000001
-    //   nop           - d503201f
-    NativeByteVector new_instrs = to_bytes<NativeByteVector, u32, u32>(0xD4000001, //
-                                                                       0xD503201F);
-    TRY(memory_io_->write(instr_ptr, new_instrs));
+    const std::uintptr_t instr_ptr = orig_regs.pc;
 #elif defined(ASMGRADER_X86_64)
     // syscall args are rdi, rsi, rdx, r10, r8, r9
     new_regs.rdi = args[0];
@@ -300,18 +1034,24 @@ Result<SyscallRecord> Tracer::execute_syscall(u64 sys_nr, std::array<std::uint64
     new_regs.r9 = args[5];
     // syscall nr is rax
     new_regs.rax = sys_nr;
+    const std::uintptr_t instr_ptr = orig_regs.rip;
+#endif
 
-    auto orig_instrs = TRY(memory_io_->read_bytes(orig_regs.rip, 8));
-
-    // Encoding for:
-    //   syscall - 0f05
-    NativeByteVector new_instrs = {0x0F, 0x05};
-    new_instrs.resize(8); // To keep proper alignment
+    // The trampoline page itself has to be mmapped with a syscall, which is patched in at the IP instead
+    const bool has_trampoline = mmaped_address_ != 0;
+    NativeByteVector orig_instrs;
 
-    TRY(memory_io_->write(orig_regs.rip, new_instrs));
+    if (has_trampoline) {
+#if defined(ASMGRADER_AARCH64)
+        new_regs.pc = mmaped_address_ + TRAMPOLINE_SYSCALL_OFFSET;
+#elif defined(ASMGRADER_X86_64)
+        new_regs.rip = mmaped_address_ + TRAMPOLINE_SYSCALL_OFFSET;
 #endif
-
-    // NOLINTEND(readability-magic-numbers)
+    } else {
+        const NativeByteVector gadget = syscall_gadget();
+        orig_instrs = TRY(memory_io_->read_bytes(instr_ptr, gadget.size()));
+        TRY(memory_io_->write(instr_ptr, gadget));
+    }
 
     TRY(set_registers(new_regs));
 
@@ -320,140 +1060,241 @@ Result<SyscallRecord> Tracer::execute_syscall(u64 sys_nr, std::array<std::uint64
     // Restore original instructions and program state
     TRY(set_registers(orig_regs));
 
-#if defined(ASMGRADER_AARCH64)
-    TRY(memory_io_->write(orig_regs.pc, orig_instrs));
-#elif defined(ASMGRADER_X86_64)
-    TRY(memory_io_->write(orig_regs.rip, orig_instrs));
-#endif
+    if (!has_trampoline) {
+        TRY(memory_io_->write(instr_ptr, orig_instrs));
+    }
 
     return result;
 }
 
-Result<RunResult> Tracer::run() {
-    return run_until({});
+Result<void> Tracer::install_trampoline() {
+    const NativeByteVector syscall = syscall_gadget();
+    const NativeByteVector breakpoint = breakpoint_gadget();
+    const NativeByteVector batch_loop = batch_loop_gadget();
+
+    static_assert(TRAMPOLINE_BATCH_LOOP_OFFSET - TRAMPOLINE_BATCH_STATE_OFFSET == 32,
+                  "Batch loop state must be where batch_loop_gadget expects it");
+
+    NativeByteVector trampoline;
+
+    auto pad_to = [&](std::size_t offset) {
+        while (trampoline.size() < offset) {
+            trampoline.insert(trampoline.end(), breakpoint.begin(), breakpoint.end());
+        }
+    };
+
+    pad_to(TRAMPOLINE_SYSCALL_OFFSET);
+    trampoline.insert(trampoline.end(), syscall.begin(), syscall.end());
+    pad_to(TRAMPOLINE_RETURN_OFFSET);
+    trampoline.insert(trampoline.end(), breakpoint.begin(), breakpoint.end());
+    pad_to(TRAMPOLINE_BATCH_LOOP_OFFSET);
+    trampoline.insert(trampoline.end(), batch_loop.begin(), batch_loop.end());
+    pad_to(TRAMPOLINE_SIZE);
+
+    DEBUG_ASSERT(trampoline.size() == TRAMPOLINE_SIZE);
+
+    TRY(memory_io_->write(mmaped_address_, trampoline));
+
+    return {};
+}
+
+Result<RunResult> Tracer::run(TracingPolicy policy) {
+    return run_until({}, policy);
 }
 
-Result<RunResult> Tracer::run_until(const std::function<bool(SyscallRecord)>& pred) {
-    assert_invariants();
+Result<RunResult> Tracer::run_until(const std::function<bool(SyscallRecord)>& pred, TracingPolicy policy) {
+    TRY(start_run(pred, policy));
 
     for (;;) {
-        ASSERT(linux::ptrace(PTRACE_SYSCALL, pid_), "PTRACE_SYSCALL failed");
+        auto wait_result = wait_within_cpu_limits();
+
+        if (!wait_result) {
+            if (wait_result != ErrorKind::TimedOut) {
+                LOG_DEBUG("Unhandled error in child process {}", wait_result.error());
+                active_run_.reset();
+            }
+
+            return wait_result.error();
+        }
 
-        auto wait_result = TracedWaitid::wait_with_timeout(pid_, DEFAULT_TIMEOUT);
+        if (auto run_result = handle_stop(wait_result.value())) {
+            return *run_result;
+        }
+    }
+
+    unreachable();
+}
+
+Result<void> Tracer::start_run(std::function<bool(SyscallRecord)> pred, TracingPolicy policy) {
+    assert_invariants();
+    ASSERT(!active_run_, "a run is already in progress");
+
+    // With a seccomp filter, we only need to stop for the exit of a syscall that caused a seccomp stop.
+    // This may have been the case before the last run was over.
+    const auto at_seccomp_stop = [this] {
+        struct ptrace_syscall_info info{};
+        return linux::ptrace(PTRACE_GET_SYSCALL_INFO, pid_, sizeof(info), &info) &&
+               info.op == PTRACE_SYSCALL_INFO_SECCOMP;
+    };
+
+    const std::chrono::nanoseconds cpu_start = TRY(get_cpu_time_used());
+
+    active_run_ = ActiveRun{
+        .pred = std::move(pred),
+        .policy = policy,
+        .stop_at_syscalls = policy == TracingPolicy::Full || (!seccomp_active_ && policy != TracingPolicy::None),
+        .awaiting_syscall_exit = seccomp_active_ && at_seccomp_stop(),
+        .cpu_start = cpu_start,
+        .cpu_used = cpu_start,
+        .last_blocked_check = std::chrono::steady_clock::now(),
+        .blocked_since = std::nullopt,
+    };
+
+    if (auto res = resume_run(); !res) {
+        active_run_.reset();
+        return res.error();
+    }
+
+    return {};
+}
 
-        if (wait_result == ErrorKind::TimedOut) {
-            LOG_DEBUG("Child process (pid={}) timed out. Stopping...", pid_);
+Result<void> Tracer::resume_run() {
+    ActiveRun& run = *active_run_;
 
-            // stop process to keep in tracable state
-            TRYE(linux::kill(pid_, SIGSTOP), SyscallFailure);
+    const int resume_request = (run.stop_at_syscalls || run.awaiting_syscall_exit) ? PTRACE_SYSCALL : PTRACE_CONT;
+    TRY(flush_registers());
+    ++stop_state_->stop_id;
+    ASSERT(linux::ptrace(resume_request, pid_), "ptrace resume failed");
+    run.awaiting_syscall_exit = false;
 
-            return ErrorKind::TimedOut;
+    return {};
+}
+
+std::optional<Result<RunResult>> Tracer::handle_stop(const TracedWaitid& waitid_data) {
+    ASSERT(active_run_, "no run in progress");
+    ActiveRun& run = *active_run_;
+
+    // Ends the run with `result`
+    const auto finish = [this](Result<RunResult> result) {
+        active_run_.reset();
+        return std::optional{std::move(result)};
+    };
+
+    // Continues the run, unless the tracee can't be resumed
+    const auto resume = [this, &finish]() -> std::optional<Result<RunResult>> {
+        if (auto res = resume_run(); !res) {
+            return finish(res.error());
         }
 
-        if (!wait_result) {
-            LOG_DEBUG("Unhandled error in child process {}", wait_result.error());
-            return wait_result.error();
+        return std::nullopt;
+    };
+
+    // Handle each case for a possible return of waitid
+    // For our purposes, this includes:
+    //   - syscall entry
+    //   - unhandled signal (e.g., SIGSEGV)
+    //   - program exit
+    // An unhandled event, such as a fork(2) or execve(2), will cause the this program to crash
+
+    // encountered a syscall traced by the seccomp filter
+    if (waitid_data.ptrace_event == PtraceEvent::Seccomp) {
+        // If stopping at every syscall, this is a spurious stop directly after the syscall entry
+        // which we have already handled (e.g., in case a filter was installed by the tracee)
+        if (run.stop_at_syscalls) {
+            return resume();
         }
 
-        const TracedWaitid waitid_data = wait_result.value();
-
-        // Handle each case for a possible return of waitid
-        // For our purposes, this includes:
-        //   - syscall entry
-        //   - unhandled signal (e.g., SIGSEGV)
-        //   - program exit
-        // An unhandled event, such as a fork(2) or execve(2), will cause the this program to crash
-
-        // encountered a syscall
-        if (waitid_data.is_syscall_trap) {
-            struct ptrace_syscall_info info{};
-
-            ASSERT(linux::ptrace(PTRACE_GET_SYSCALL_INFO, pid_, sizeof(info), &info));
-
-            if (info.op == PTRACE_SYSCALL_INFO_ENTRY) {
-                SyscallRecord record = get_syscall_entry_info(&info);
-                syscall_records_.push_back(std::move(record));
-
-                if (pred && pred(syscall_records_.back())) {
-                    return ErrorKind::SyscallPredSat;
-                }
-            } else if (info.op == PTRACE_SYSCALL_INFO_EXIT) {
-                if (syscall_records_.empty() || syscall_records_.back().ret != std::nullopt) {
-                    LOG_DEBUG("Expected syscall entry but encountered exit. Skipping handling...");
-                    continue;
-                }
-
-                get_syscall_exit_info(syscall_records_.back(), &info);
-            } else {
-                LOG_WARN("Unhandled syscall trap (op = {}). Skipping handling...", info.op);
+        struct ptrace_syscall_info info{};
+
+        ASSERT(linux::ptrace(PTRACE_GET_SYSCALL_INFO, pid_, sizeof(info), &info));
+        ASSERT(info.op == PTRACE_SYSCALL_INFO_SECCOMP);
+
+        if (!is_traced_by(run.policy, info.seccomp.nr)) {
+            return resume();
+        }
+
+        SyscallRecord record = get_syscall_entry_info(&info);
+        syscall_log_.push(record);
+        run.awaiting_syscall_exit = true;
+
+        if (run.pred && run.pred(std::move(record))) {
+            return finish(ErrorKind::SyscallPredSat);
+        }
+
+        return resume();
+    }
+
+    // encountered a syscall
+    if (waitid_data.is_syscall_trap) {
+        struct ptrace_syscall_info info{};
+
+        ASSERT(linux::ptrace(PTRACE_GET_SYSCALL_INFO, pid_, sizeof(info), &info));
+
+        if (info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+            if (!is_traced_by(run.policy, info.entry.nr)) {
+                run.skipped_syscall_entry = true;
+                return resume();
             }
 
-            continue;
+            SyscallRecord record = get_syscall_entry_info(&info);
+            syscall_log_.push(record);
+
+            if (run.pred && run.pred(std::move(record))) {
+                return finish(ErrorKind::SyscallPredSat);
+            }
+        } else if (info.op == PTRACE_SYSCALL_INFO_EXIT) {
+            if (std::exchange(run.skipped_syscall_entry, false)) {
+                return resume();
+            }
+
+            if (!syscall_log_.awaiting_ret()) {
+                LOG_DEBUG("Expected syscall entry but encountered exit. Skipping handling...");
+                return resume();
+            }
+
+            syscall_log_.set_last_ret(get_syscall_exit_info(&info));
+        } else {
+            LOG_WARN("Unhandled syscall trap (op = {}). Skipping handling...", info.op);
         }
 
-        // trapped by a signal (such as by a SEGFAULT)
-        if (waitid_data.type == CLD_TRAPPED) {
-            // FIXME: better macro, or abstracted registers
+        return resume();
+    }
+
+    // trapped by a signal (such as by a SEGFAULT)
+    if (waitid_data.type == CLD_TRAPPED) {
+        // FIXME: better macro, or abstracted registers
 #ifndef ASMGRADER_AARCH64
-            LOG_TRACE("Child proc trapped by signal ({}). Regs state: {}", *waitid_data.signal_num,
-                      format_or_unknown(get_registers()));
+        LOG_TRACE("Child proc trapped by signal ({}). Regs state: {}", *waitid_data.signal_num,
+                  format_or_unknown(get_registers()));
 #endif
-            return RunResult::make_signal_caught(*waitid_data.signal_num);
-        }
+        return finish(RunResult::make_signal_caught(*waitid_data.signal_num));
+    }
 
-        // program exiting
-        if (waitid_data.type == CLD_EXITED) {
-            exit_code_ = waitid_data.exit_code;
-            LOG_DEBUG("waitid got exit code = {}", exit_code_);
+    // program exiting
+    if (waitid_data.type == CLD_EXITED) {
+        exit_code_ = waitid_data.exit_code;
+        LOG_DEBUG("waitid got exit code = {}", exit_code_);
 
-            return RunResult::make_exited(waitid_data.exit_code.value());
-        }
+        return finish(RunResult::make_exited(waitid_data.exit_code.value()));
     }
 
-    unreachable();
+    return resume();
 }
 
 Result<void> Tracer::setup_function_return() {
-    // TODO: Could do a couple fewer context switches by doing register setup all at once if perf is a concern
     user_regs_struct regs = TRY(get_registers());
 
-    // NOLINTBEGIN(readability-magic-numbers)
-#if defined(ASMGRADER_AARCH64)
-    // Instructions must be 4-byte aligned
-    // TODO: Create helper for writing aligned data
-    constexpr std::size_t ALIGNMENT = 4;
-    const std::uintptr_t return_loc =
-        (mmaped_address_ + mmaped_used_amt_) + (ALIGNMENT - (mmaped_address_ + mmaped_used_amt_) % ALIGNMENT);
+    // The breakpoint was written by install_trampoline; only the return address needs to be set
+    const std::uintptr_t return_loc = mmaped_address_ + TRAMPOLINE_RETURN_OFFSET;
 
+#if defined(ASMGRADER_AARCH64)
     // LR
     regs.regs[30] = return_loc;
-
-    // Encoding for:
-    //   brk 0x1234    - d4224680
-    //   nop           - d503201f
-    // 32-bit alignment is required
-    auto instrs = to_bytes<NativeByteVector, u32, u32>( //
-        0xD4224680,                                     //
-        0xD503201F                                      //
-    );
-
 #elif defined(ASMGRADER_X86_64)
-    const std::uintptr_t return_loc = mmaped_address_ + mmaped_used_amt_;
     // return address placed on stack
     regs.rsp -= 8; // FIXME: Should it not be 16-byte aligned?
     TRY(memory_io_->write(regs.rsp, return_loc));
-
-    // Encoding for:
-    //   int3 - 0xcc
-    //   nop  - 0x90
-    NativeByteVector instrs = {0xCC, 0x90, 0x90, 0x90, //
-                               0x90, 0x90, 0x90, 0x90};
 #endif
-    // NOLINTEND(readability-magic-numbers)
-
-    TRY(memory_io_->write(return_loc, instrs));
-    // FIXME: Adding some extra padding so we don't run into issues with my buggy PtraceMemoryIO implementation
-    mmaped_used_amt_ = return_loc - (mmaped_address_ + mmaped_used_amt_) + instrs.size() + 32;
 
     TRY(set_registers(regs));
 
@@ -474,10 +1315,12 @@ Result<TracedWaitid> Tracer::resume_until(const std::function<bool(TracedWaitid)
     std::common_type_t<decltype(start_time - start_time), std::chrono::microseconds> remaining_time = timeout;
 
     while (remaining_time > 0us) {
+        TRY(flush_registers());
+        ++stop_state_->stop_id;
         auto ptrace_result = linux::ptrace(ptrace_request, pid_);
         ASSERT(ptrace_result, "ptrace failed in `resume_until`");
 
-        auto wait_result = TracedWaitid::wait_with_timeout(pid_, timeout);
+        auto wait_result = TracedWaitid::wait_with_timeout(pid_, timeout, options_.wait_spin);
 
         LOG_TRACE("waitid returned: {}", wait_result);
 
@@ -524,55 +1367,14 @@ Result<SyscallRecord> Tracer::run_next_syscall(std::chrono::microseconds timeout
     TRYE(linux::ptrace(PTRACE_GET_SYSCALL_INFO, pid_, sizeof(exit), &exit), SyscallFailure);
 
     SyscallRecord rec = get_syscall_entry_info(&entry);
-    get_syscall_exit_info(rec, &exit);
+    rec.ret = get_syscall_exit_info(&exit);
 
     return rec;
 }
 
-// FIXME: Parse fixed-length strings seperately
-SyscallRecord::SyscallArg Tracer::from_syscall_value(u64 value, SyscallEntry::Type type) const {
-    using enum SyscallEntry::Type;
-
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-    auto convert = [&]<typename T>(T /*unused*/) { return *reinterpret_cast<T*>(&value); };
-
-    switch (type) {
-    case Int32:
-        return convert(i32{});
-    case Int64:
-        return convert(i64{});
-    case Uint32:
-        return convert(u32{});
-    case Uint64:
-        return convert(u64{});
-    case VoidPtr:
-        return convert(static_cast<void*>(nullptr));
-
-    case CString:
-        return memory_io_->read<std::string>(value);
-    case NTCStringArray: {
-        auto string_ptr_array =
-            memory_io_->read_array<std::uintptr_t>(value, [](const auto& elem) { return elem == 0; });
-
-        if (!string_ptr_array) {
-            // FIXME: ouch... these types hurt me
-            return Result<std::vector<Result<std::string>>>{string_ptr_array.error()};
-        }
-
-        std::vector<Result<std::string>> result(string_ptr_array->size());
-        for (const auto& [ptr, elem] : ranges::views::zip(string_ptr_array.value(), result)) {
-            elem = memory_io_->read<std::string>(ptr);
-        }
-
-        return {Result<decltype(result)>{result}};
-    }
-
-    case TimeSpecPtr:
-        return memory_io_->read<std::timespec>(value);
-
-    default:
-        UNREACHABLE(false, "Invalid syscall entry type parse");
-    }
+bool Tracer::should_decode_eagerly(u64 nr) const {
+    return options_.syscall_arg_decoding == SyscallArgDecoding::Eager ||
+           ranges::contains(options_.eagerly_decoded_syscalls, nr);
 }
 
 MemoryIOBase& Tracer::get_memory_io() {
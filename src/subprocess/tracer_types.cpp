@@ -0,0 +1,228 @@
+#include "subprocess/tracer_types.hpp"
+
+#include "common/error_types.hpp"
+#include "common/extra_formatters.hpp" // IWYU pragma: keep
+#include "common/linux.hpp"
+#include "logging.hpp"
+#include "subprocess/tracer_options.hpp"
+
+#include <gsl/util>
+#include <libassert/assert.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace asmgrader {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+/// Incremented upon each SIGCHLD received by the grader. Waiters sleep on this as a futex word.
+///
+/// SIGCHLD is process-directed, so it is only delivered to a single (arbitrary) thread. Broadcasting
+/// via a futex ensures that every thread waiting on any child is woken up to re-check its own child.
+std::atomic<std::uint32_t> sigchld_seq{0};
+
+static_assert(sizeof(sigchld_seq) == sizeof(std::uint32_t) && decltype(sigchld_seq)::is_always_lock_free,
+              "sigchld_seq must be usable as a futex word");
+
+/// Upper bound of a single sleep, in case a SIGCHLD is somehow missed
+/// (e.g. the handler was replaced, or the signal is blocked in every thread)
+constexpr auto MAX_SLEEP_SLICE = 5ms;
+
+/// Never spin for longer than this; past this point, the cost of a context switch is negligible
+constexpr auto MAX_SPIN = 50us;
+
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-type-vararg)
+
+void on_sigchld(int /*signum*/) {
+    // Only async-signal-safe operations are permitted here
+    int saved_errno = errno;
+
+    sigchld_seq.fetch_add(1, std::memory_order_release);
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&sigchld_seq), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr,
+              nullptr, 0);
+
+    errno = saved_errno;
+}
+
+/// Sleeps until sigchld_seq != `seq`, or `timeout` passes
+void futex_wait_for_sigchld(std::uint32_t seq, std::chrono::nanoseconds timeout) {
+    const auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    const timespec timeout_ts{.tv_sec = secs.count(), .tv_nsec = (timeout - secs).count()};
+
+    // Return value intentionally ignored; EAGAIN (seq already changed), EINTR and ETIMEDOUT all
+    // mean that the caller should simply re-check its child
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&sigchld_seq), FUTEX_WAIT_PRIVATE, seq, &timeout_ts,
+              nullptr, 0);
+}
+
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-type-vararg)
+
+/// Installs \ref on_sigchld as the SIGCHLD handler, unless some other handler is already present
+void install_sigchld_handler() {
+    static std::once_flag installed;
+
+    std::call_once(installed, [] {
+        auto cur_act = linux::sigaction(SIGCHLD);
+
+        // Don't override a handler installed by somebody else. SIG_IGN in particular must be
+        // left alone, as it changes the semantics of waitid(2).
+        if (!cur_act || (cur_act->sa_flags & SA_SIGINFO) != 0 || cur_act->sa_handler != SIG_DFL) {
+            LOG_WARN("SIGCHLD disposition has been modified; waiting on children will fall back to polling every {}",
+                     MAX_SLEEP_SLICE);
+            return;
+        }
+
+        struct sigaction act{};
+        act.sa_handler = on_sigchld;
+        sigemptyset(&act.sa_mask);
+        // Don't interrupt unrelated blocking syscalls in the grader
+        // Note: SA_NOCLDSTOP must *not* be set, as we need to be notified of ptrace stops
+        act.sa_flags = SA_RESTART;
+
+        std::ignore = linux::sigaction(SIGCHLD, act);
+    });
+}
+
+/// Exponential moving average of the time it took for recent waits on this thread to complete
+thread_local std::chrono::nanoseconds avg_wait_latency = MAX_SPIN / 2;
+
+void record_wait_latency(std::chrono::nanoseconds latency) {
+    constexpr int EMA_WEIGHT = 8;
+
+    avg_wait_latency = (avg_wait_latency * (EMA_WEIGHT - 1) + latency) / EMA_WEIGHT;
+}
+
+std::chrono::nanoseconds get_spin_duration(WaitSpin spin) {
+    if (spin == WaitSpin::None || avg_wait_latency >= MAX_SPIN) {
+        return 0ns;
+    }
+
+    // Spin for somewhat longer than expected, as a miss costs us a context switch anyways
+    return std::min<std::chrono::nanoseconds>(avg_wait_latency * 2, MAX_SPIN);
+}
+
+/// Non-blocking check for a state change of `pid`
+std::optional<siginfo_t> try_waitid(pid_t pid) {
+    Expected<siginfo_t> waitid_res = linux::waitid(P_PID, gsl::narrow_cast<id_t>(pid), WEXITED | WSTOPPED | WNOHANG);
+
+    ASSERT(waitid_res);
+
+    // si_pid will only be 0 if waitid returned early from WNOHANG
+    // see waitid(2)
+    if (waitid_res.value().si_pid == 0) {
+        return std::nullopt;
+    }
+
+    return waitid_res.value();
+}
+
+} // namespace
+
+Result<TracedWaitid> TracedWaitid::wait_with_timeout_impl(pid_t pid, std::chrono::nanoseconds timeout,
+                                                          WaitSpin spin) {
+    using std::chrono::steady_clock;
+
+    install_sigchld_handler();
+
+    const auto start_time = steady_clock::now();
+    const auto deadline = start_time + timeout;
+    const auto spin_deadline = std::min(deadline, start_time + get_spin_duration(spin));
+
+    auto on_event = [start_time](const siginfo_t& siginfo) {
+        record_wait_latency(steady_clock::now() - start_time);
+        return TracedWaitid::parse(siginfo);
+    };
+
+    // Phase 1: the child is expected to stop very soon, so avoid the cost of going to sleep
+    do {
+        if (auto siginfo = try_waitid(pid)) {
+            return on_event(*siginfo);
+        }
+
+        std::this_thread::yield();
+    } while (steady_clock::now() < spin_deadline);
+
+    // Phase 2: sleep until any child changes state
+    for (auto now = steady_clock::now(); now < deadline; now = steady_clock::now()) {
+        // Must be read *before* checking the child, so that a SIGCHLD in between the two is not missed
+        const std::uint32_t seq = sigchld_seq.load(std::memory_order_acquire);
+
+        if (auto siginfo = try_waitid(pid)) {
+            return on_event(*siginfo);
+        }
+
+        futex_wait_for_sigchld(seq, std::min<std::chrono::nanoseconds>(deadline - now, MAX_SLEEP_SLICE));
+    }
+
+    // One last check, as the child may have changed state right at the deadline
+    if (auto siginfo = try_waitid(pid)) {
+        return on_event(*siginfo);
+    }
+
+    LOG_DEBUG("waitid timed out at {}", timeout);
+    record_wait_latency(timeout);
+
+    return ErrorKind::TimedOut;
+}
+
+Result<std::vector<std::pair<pid_t, TracedWaitid>>>
+TracedWaitid::wait_any_with_timeout(std::span<const pid_t> pids, std::chrono::nanoseconds timeout) {
+    using std::chrono::steady_clock;
+
+    install_sigchld_handler();
+
+    const auto deadline = steady_clock::now() + timeout;
+    std::vector<std::pair<pid_t, TracedWaitid>> results;
+
+    const auto collect = [&pids, &results] {
+        for (const pid_t pid : pids) {
+            if (auto siginfo = try_waitid(pid)) {
+                results.emplace_back(pid, TracedWaitid::parse(*siginfo));
+            }
+        }
+
+        return !results.empty();
+    };
+
+    // No spinning, as with many children, it's likely that one of them has already changed state
+    for (auto now = steady_clock::now(); now < deadline; now = steady_clock::now()) {
+        // Must be read *before* checking the children, so that a SIGCHLD in between the two is not missed
+        const std::uint32_t seq = sigchld_seq.load(std::memory_order_acquire);
+
+        if (collect()) {
+            return results;
+        }
+
+        futex_wait_for_sigchld(seq, std::min<std::chrono::nanoseconds>(deadline - now, MAX_SLEEP_SLICE));
+    }
+
+    if (collect()) {
+        return results;
+    }
+
+    return ErrorKind::TimedOut;
+}
+
+} // namespace asmgrader
@@ -5,6 +5,7 @@
 #include "symbols/symbol_table.hpp"
 
 #include <elfio/elf_types.hpp>
+#include <elfio/elfio_note.hpp>
 #include <elfio/elfio_section.hpp>
 #include <elfio/elfio_symbols.hpp>
 #include <fmt/format.h>
@@ -12,8 +13,10 @@
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <elf.h>
@@ -111,4 +114,34 @@ SymbolTable ElfReader::get_symbol_table() const {
     return SymbolTable{get_symbols()};
 }
 
+std::optional<std::string> ElfReader::get_build_id() const {
+    for (const auto& sect : elffile_.sections) {
+        if (sect->get_type() != SHT_NOTE) {
+            continue;
+        }
+
+        const ELFIO::note_section_accessor notes(elffile_, sect.get());
+
+        for (unsigned int i = 0; i < notes.get_notes_num(); i++) {
+            ELFIO::Elf_Word type = 0;
+            std::string name;
+            char* desc = nullptr;
+            ELFIO::Elf_Word desc_size = 0;
+
+            if (!notes.get_note(i, type, name, desc, desc_size) || type != NT_GNU_BUILD_ID || desc == nullptr) {
+                continue;
+            }
+
+            std::string build_id;
+            for (unsigned char byte : std::string_view{desc, desc_size}) {
+                build_id += fmt::format("{:02x}", byte);
+            }
+
+            return build_id;
+        }
+    }
+
+    return std::nullopt;
+}
+
 } // namespace asmgrader
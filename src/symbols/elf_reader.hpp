@@ -5,6 +5,8 @@
 
 #include <elfio/elfio.hpp>
 
+#include <optional>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -24,6 +26,12 @@ public:
 
     std::vector<std::string> get_symbol_names() const;
 
+    /// The GNU build ID (from the NT_GNU_BUILD_ID note) as a hex string, if the file has one
+    std::optional<std::string> get_build_id() const;
+
+    /// The GNU build ID (from the NT_GNU_BUILD_ID note) as a hex string, if the file has one
+    std::optional<std::string> get_build_id() const;
+
 private:
     ELFIO::elfio elffile_;
 };
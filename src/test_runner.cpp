@@ -3,18 +3,34 @@
 #include "api/assignment.hpp"
 #include "api/test_base.hpp"
 #include "api/test_context.hpp"
+#include "common/worker_threads.hpp"
 #include "exceptions.hpp"
 #include "grading_session.hpp"
 #include "logging.hpp"
+#include "output/buffered_serializer.hpp"
+#include "output/output_sequencer.hpp"
 #include "output/serializer.hpp"
 #include "program/program.hpp"
+#include "result_cache.hpp"
+#include "subprocess/fork_server.hpp"
+#include "subprocess/process_reaper.hpp"
+#include "subprocess/traced_subprocess.hpp"
+#include "subprocess/tracer_options.hpp"
+#include "timing_db.hpp"
 #include "version.hpp"
 
+#include <fmt/format.h>
 #include <range/v3/view/filter.hpp>
 #include <range/v3/view/map.hpp>
+#include <range/v3/view/zip.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <numeric>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -24,21 +40,136 @@
 
 namespace asmgrader {
 
+namespace {
+
+/// Memory shared with each tracee, from which test buffers are allocated first
+constexpr std::size_t SHARED_HEAP_SIZE = 1024 * 1024;
+
+/// Only exit and exit_group stop the tracee unless a policy asks for more (e.g., \ref TestContext::run records
+/// every syscall), so function calls run at full speed.
+TracerOptions make_tracer_options() {
+    return TracerOptions{.traced_syscalls = std::vector<u64>{}, .shared_heap_size = SHARED_HEAP_SIZE};
+}
+
+/// Every test runs the same executable, so load it just once and fork copies of it for each test.
+/// Null if `exec_path` can't be run by a fork server, in which case a new process must be spawned per test.
+std::unique_ptr<ForkServer> make_fork_server(const std::filesystem::path& exec_path) {
+    if (!Program::check_is_compat_elf(exec_path)) {
+        return nullptr;
+    }
+
+    auto fork_server =
+        std::make_unique<ForkServer>(exec_path.string(), std::vector<std::string>{}, make_tracer_options());
+
+    if (auto start_res = fork_server->start(); !start_res) {
+        LOG_WARN("Failed to start fork server ({}); falling back to spawning a new process per test", start_res);
+        return nullptr;
+    }
+
+    return fork_server;
+}
+
+} // namespace
+
+/// Starts a fork server upon first use, so that none is started if every test's result is cached
+class AssignmentTestRunner::LazyForkServer
+{
+public:
+    explicit LazyForkServer(const std::filesystem::path& exec_path)
+        : exec_path_{&exec_path} {}
+
+    /// Null if a fork server can't be used for the executable
+    ForkServer* get() {
+        if (!started_) {
+            server_ = make_fork_server(*exec_path_);
+            started_ = true;
+        }
+
+        return server_.get();
+    }
+
+private:
+    const std::filesystem::path* exec_path_;
+    std::unique_ptr<ForkServer> server_;
+    bool started_ = false;
+};
+
 AssignmentTestRunner::AssignmentTestRunner(Assignment& assignment, const std::shared_ptr<Serializer>& serializer,
-                                           const std::optional<std::string>& tests_filter)
+                                           const std::optional<std::string>& tests_filter,
+                                           const CpuTimeLimits& cpu_time_limits, std::size_t num_test_jobs,
+                                           ResultCache* cache, const TimingDb* timings)
     : assignment_{&assignment}
     , serializer_{serializer}
-    , filter_{tests_filter} {}
+    , filter_{tests_filter}
+    , cpu_time_limits_{cpu_time_limits}
+    , num_test_jobs_{num_test_jobs}
+    , cache_{cache}
+    , timings_{timings} {}
 
 AssignmentResult AssignmentTestRunner::run_all(std::optional<std::filesystem::path> alternative_path) const {
+    const auto start = std::chrono::steady_clock::now();
+
     // Assignment name -> TestResults
     std::unordered_map<std::string_view, std::vector<TestResult>> result;
     int num_total_requirements = 0;
 
-    if (alternative_path) {
-        assignment_->set_exec_path(std::move(*alternative_path));
+    // The assignment is shared by every thread grading a student, so it's left untouched
+    const std::filesystem::path exec_path = std::move(alternative_path).value_or(assignment_->get_exec_path());
+
+    const std::vector<TestBase*> tests = get_tests();
+
+    // Killed programs are reaped in the background while the next test runs
+    ProcessReaper reaper;
+
+    const std::optional<std::string> exec_key = cache_ ? cache_->make_exec_key(exec_path) : std::nullopt;
+
+    const std::vector<TestResult> test_results = num_test_jobs_ > 1 && tests.size() > 1
+                                                     ? run_concurrently(tests, exec_path, reaper, exec_key)
+                                                     : run_serially(tests, exec_path, reaper, exec_key);
+
+    for (const auto& [test, test_result] : ranges::views::zip(tests, test_results)) {
+        result[test->get_assignment().get_name()].push_back(test_result);
+
+        num_total_requirements += test_result.num_total;
     }
 
+    if (result.size() > 1) {
+        UNIMPLEMENTED("Multi-assignment runs are not yet supported! {}", result | ranges::views::keys);
+    }
+
+    AssignmentResult res{.name = std::string{result.begin()->first},
+                         .test_results = std::move(result.begin()->second),
+                         .num_requirements_total = num_total_requirements,
+                         .duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - start)};
+
+    serializer_->on_assignment_result(res);
+
+    return res;
+}
+
+std::chrono::milliseconds AssignmentTestRunner::predict_duration(const StudentInfo& student) const {
+    if (timings_ == nullptr || !student.assignment_path) {
+        return {};
+    }
+
+    const std::optional<std::string> exec_key = cache_ ? cache_->make_exec_key(*student.assignment_path) : std::nullopt;
+
+    // Test name -> test, for those that would be run
+    std::unordered_map<std::string_view, const TestBase*> tests;
+
+    for (const TestBase* test : get_tests()) {
+        tests.emplace(test->get_name(), test);
+    }
+
+    return timings_->predict_student(assignment_->get_name(), student, [&](std::string_view test_name) {
+        auto iter = tests.find(test_name);
+
+        return iter != tests.end() && !is_cached(*iter->second, exec_key);
+    });
+}
+
+std::vector<TestBase*> AssignmentTestRunner::get_tests() const {
     auto maybe_tests_filter = ranges::views::filter([this](const TestBase& test) -> bool {
         if (!filter_.has_value()) {
             return true;
@@ -47,51 +178,183 @@ AssignmentResult AssignmentTestRunner::run_all(std::optional<std::filesystem::pa
         return test.get_name().find(*filter_) != std::string::npos;
     });
 
+    std::vector<TestBase*> tests;
+
     for (TestBase& test : assignment_->get_tests() | maybe_tests_filter) {
         // Skip tests that are marked as professor-only if we're not in professor mode
         if (test.get_is_prof_only() && APP_MODE != AppMode::Professor) {
             continue;
         }
-        const std::string_view assignment_name = test.get_assignment().get_name();
 
-        const TestResult test_result = run_one(test);
+        tests.push_back(&test);
+    }
 
-        serializer_->on_test_result(test_result);
+    return tests;
+}
 
-        result[assignment_name].push_back(test_result);
+std::vector<TestResult> AssignmentTestRunner::run_serially(const std::vector<TestBase*>& tests,
+                                                           const std::filesystem::path& exec_path,
+                                                           ProcessReaper& reaper,
+                                                           const std::optional<std::string>& exec_key) const {
+    std::vector<TestResult> results;
+    results.reserve(tests.size());
 
-        num_total_requirements += test_result.num_total;
+    LazyForkServer fork_server{exec_path};
+
+    for (TestBase* test : tests) {
+        TestResult test_result = run_or_replay(*test, exec_path, fork_server, reaper, *serializer_, exec_key);
+
+        serializer_->on_test_result(test_result);
+
+        results.push_back(std::move(test_result));
     }
 
-    if (result.size() > 1) {
-        UNIMPLEMENTED("Multi-assignment runs are not yet supported! {}", result | ranges::views::keys);
+    return results;
+}
+
+std::vector<TestResult> AssignmentTestRunner::run_concurrently(const std::vector<TestBase*>& tests,
+                                                               const std::filesystem::path& exec_path,
+                                                               ProcessReaper& reaper,
+                                                               const std::optional<std::string>& exec_key) const {
+    std::vector<TestResult> results(tests.size());
+
+    // The output of each test is kept together as a block, and blocks are output in the same order as when tests
+    // are run serially
+    OutputSequencer sequencer{*serializer_, tests.size()};
+
+    auto run_block = [&](std::size_t idx, LazyForkServer& fork_server) {
+        auto block = std::make_shared<BufferedSerializer>();
+        results[idx] = run_or_replay(*tests[idx], exec_path, fork_server, reaper, *block, exec_key);
+        block->on_test_result(results[idx]);
+
+        sequencer.emit(idx, std::move(block));
+    };
+
+    // For serial tests, which are all run on this thread
+    LazyForkServer serial_fork_server{exec_path};
+
+    // Serial tests are barriers: each is run on its own, after every test before it and before every test after it.
+    // The tests in between are run concurrently.
+    for (std::size_t begin = 0; begin < tests.size();) {
+        if (tests[begin]->get_is_serial()) {
+            run_block(begin++, serial_fork_server);
+            continue;
+        }
+
+        std::size_t end = begin;
+        while (end < tests.size() && !tests[end]->get_is_serial()) {
+            ++end;
+        }
+
+        std::vector<std::size_t> batch(end - begin);
+        std::iota(batch.begin(), batch.end(), begin);
+
+        // Longest expected first, so that a long test isn't left running alone at the end
+        if (timings_ != nullptr) {
+            const std::string_view assignment_name = assignment_->get_name();
+            std::vector<std::chrono::milliseconds> predictions(tests.size());
+
+            for (const std::size_t idx : batch) {
+                // Replaying a cached result takes next to no time
+                if (!is_cached(*tests[idx], exec_key)) {
+                    predictions[idx] = timings_->predict_test(assignment_name, tests[idx]->get_name());
+                }
+            }
+
+            std::ranges::stable_sort(batch, std::ranges::greater{},
+                                     [&predictions](std::size_t idx) { return predictions[idx]; });
+        }
+
+        const std::size_t num_workers = std::min(num_test_jobs_, batch.size());
+        LOG_DEBUG("Running {} tests with {} workers", batch.size(), num_workers);
+
+        run_worker_threads(num_workers, batch.size(), [&](const auto& claim) {
+            // Only the thread tracing the pristine tracee may fork it, so each worker needs its own fork server
+            LazyForkServer fork_server{exec_path};
+
+            for (auto i = claim(); i; i = claim()) {
+                run_block(batch[*i], fork_server);
+            }
+        });
+
+        begin = end;
     }
 
-    AssignmentResult res{.name = std::string{result.begin()->first},
-                         .test_results = std::move(result.begin()->second),
-                         .num_requirements_total = num_total_requirements};
+    return results;
+}
 
-    serializer_->on_assignment_result(res);
+TestResult AssignmentTestRunner::run_or_replay(TestBase& test, const std::filesystem::path& exec_path,
+                                               LazyForkServer& fork_server, ProcessReaper& reaper, Serializer& output,
+                                               const std::optional<std::string>& exec_key) const {
+    if (cache_ == nullptr || !exec_key) {
+        return run_one(test, exec_path, fork_server, reaper, output);
+    }
 
-    return res;
+    return cache_->replay_or_run(*exec_key, make_settings_key(test), test.get_name(), output, [&](Serializer& tee) {
+        return run_one(test, exec_path, fork_server, reaper, tee);
+    });
 }
 
-TestResult AssignmentTestRunner::run_one(TestBase& test) const {
-    TestContext context(test, Program{assignment_->get_exec_path(), {}},
-                        [this](const RequirementResult& res) { serializer_->on_requirement_result(res); });
+TestResult AssignmentTestRunner::run_one(TestBase& test, const std::filesystem::path& exec_path,
+                                         LazyForkServer& fork_server, ProcessReaper& reaper,
+                                         Serializer& output) const {
+    const auto start = std::chrono::steady_clock::now();
 
-    serializer_->on_test_begin(test.get_name());
+    ForkServer* server = fork_server.get();
+    Program program = server ? Program{*server} : Program{exec_path, {}, make_tracer_options()};
+    TracedSubprocess& subproc = program.get_subproc();
+    subproc.get_tracer().set_cpu_time_limits(get_cpu_time_limits(test));
+    subproc.set_teardown_policy(test.get_drains_program() ? TeardownPolicy::Drain : TeardownPolicy::Kill);
+    subproc.set_reaper(&reaper);
+
+    TestContext context(test, std::move(program),
+                        [&output](const RequirementResult& res) { output.on_requirement_result(res); });
+
+    output.on_test_begin(test.get_name());
+
+    std::optional<ContextInternalError> error;
 
     try {
         test.run(context);
     } catch (const ContextInternalError& ex) {
         LOG_DEBUG("Internal context test error: {}", ex);
-        auto res = context.finalize();
-        res.error = ex;
-        return res;
+        error = ex;
+    }
+
+    TestResult res = context.finalize();
+    if (error) {
+        res.error = std::move(error);
+    }
+    res.timed_out = subproc.get_tracer().has_timed_out();
+    res.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    return res;
+}
+
+std::string AssignmentTestRunner::make_settings_key(const TestBase& test) const {
+    return fmt::format("{}/{}", get_cpu_time_limits(test), make_tracer_options());
+}
+
+bool AssignmentTestRunner::is_cached(const TestBase& test, const std::optional<std::string>& exec_key) const {
+    return cache_ != nullptr && exec_key && cache_->contains(*exec_key, make_settings_key(test), test.get_name());
+}
+
+CpuTimeLimits AssignmentTestRunner::get_cpu_time_limits(const TestBase& test) const {
+    using namespace std::chrono_literals;
+
+    CpuTimeLimits limits = cpu_time_limits_;
+
+    if (const auto budget = test.get_cpu_time_budget()) {
+        if (budget->per_call > 0ms) {
+            limits.per_run = budget->per_call;
+        }
+
+        if (budget->per_test > 0ms) {
+            limits.total = budget->per_test;
+        }
     }
 
-    return context.finalize();
+    return limits;
 }
 
 } // namespace asmgrader
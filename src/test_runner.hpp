@@ -3,11 +3,19 @@
 #include "api/test_base.hpp"
 #include "grading_session.hpp"
 #include "output/serializer.hpp"
+#include "result_cache.hpp"
+#include "subprocess/fork_server.hpp"
+#include "subprocess/process_reaper.hpp"
+#include "subprocess/tracer_options.hpp"
+#include "timing_db.hpp"
 
+#include <chrono>
+#include <cstddef>
 #include <filesystem>
 #include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace asmgrader {
 
@@ -15,17 +23,73 @@ namespace asmgrader {
 class AssignmentTestRunner
 {
 public:
+    /// `cpu_time_limits` applies to tests that don't specify their own \ref metadata::CpuTimeBudget
+    ///
+    /// Up to `num_test_jobs` tests are run concurrently, each on its own thread, except for those marked with
+    /// \ref metadata::Serial, which are run on their own in their usual place. The output of each test is passed to
+    /// `serializer` as a whole, in the usual order.
+    ///
+    /// Tests whose results are in `cache`, if set, are not run at all; their output is replayed instead.
+    ///
+    /// When run concurrently, tests expected to take the longest as per `timings`, if set, are started first.
     AssignmentTestRunner(Assignment& assignment, const std::shared_ptr<Serializer>& serializer,
-                         const std::optional<std::string>& tests_filter);
+                         const std::optional<std::string>& tests_filter, const CpuTimeLimits& cpu_time_limits = {},
+                         std::size_t num_test_jobs = 1, ResultCache* cache = nullptr,
+                         const TimingDb* timings = nullptr);
 
+    /// Runs every test on `alternative_path` if set, or on the assignment's executable otherwise
+    ///
+    /// May be called concurrently from multiple threads, each with its own serializer.
     AssignmentResult run_all(std::optional<std::filesystem::path> alternative_path) const;
 
+    /// Expected time to run every test of `student` as per `timings`, or zero if unset. Tests whose results are in
+    /// `cache` are expected to take no time, as they won't be run.
+    std::chrono::milliseconds predict_duration(const StudentInfo& student) const;
+
 private:
-    TestResult run_one(TestBase& test) const;
+    class LazyForkServer;
+
+    /// Tests of the assignment to be run, in order
+    std::vector<TestBase*> get_tests() const;
+
+    /// Everything besides the executable and test that the test's result may depend on, for \ref ResultCache
+    std::string make_settings_key(const TestBase& test) const;
+
+    /// Whether the result of `test` is in the cache, for the executable with `exec_key`
+    bool is_cached(const TestBase& test, const std::optional<std::string>& exec_key) const;
+
+    /// Runs `tests` one after another, returning their results in the same order.
+    /// `exec_key` is that of `exec_path` in the cache, if any (see \ref ResultCache::make_exec_key).
+    std::vector<TestResult> run_serially(const std::vector<TestBase*>& tests, const std::filesystem::path& exec_path,
+                                         ProcessReaper& reaper, const std::optional<std::string>& exec_key) const;
+
+    /// Runs `tests` on up to `num_test_jobs_` threads, returning their results in the same order. Serial tests are
+    /// barriers, run once every test before them is done and before any test after them is started.
+    std::vector<TestResult> run_concurrently(const std::vector<TestBase*>& tests,
+                                             const std::filesystem::path& exec_path, ProcessReaper& reaper,
+                                             const std::optional<std::string>& exec_key) const;
+
+    /// Replays the output of `test` from the cache if it's there, or runs it as by \ref run_one otherwise
+    TestResult run_or_replay(TestBase& test, const std::filesystem::path& exec_path, LazyForkServer& fork_server,
+                             ProcessReaper& reaper, Serializer& output,
+                             const std::optional<std::string>& exec_key) const;
+
+    /// Runs `test` with a program forked from `fork_server` if it can be used, or with a fresh process of
+    /// `exec_path` otherwise. The program is left to `reaper` once killed. Output is passed to `output`, except for
+    /// the test's result, which includes the time taken.
+    TestResult run_one(TestBase& test, const std::filesystem::path& exec_path, LazyForkServer& fork_server,
+                       ProcessReaper& reaper, Serializer& output) const;
+
+    /// The default limits, overridden by those in the metadata of `test`
+    CpuTimeLimits get_cpu_time_limits(const TestBase& test) const;
 
     Assignment* assignment_;
     std::shared_ptr<Serializer> serializer_;
     std::optional<std::string> filter_;
+    CpuTimeLimits cpu_time_limits_;
+    std::size_t num_test_jobs_;
+    ResultCache* cache_;
+    const TimingDb* timings_;
 };
 
 } // namespace asmgrader
@@ -0,0 +1,268 @@
+#include "timing_db.hpp"
+
+#include "common/atomic_file.hpp"
+#include "common/error_types.hpp"
+#include "grading_session.hpp"
+#include "logging.hpp"
+
+#include <nlohmann/json.hpp>
+#include <range/v3/view/map.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace asmgrader {
+
+namespace {
+
+/// Predictions for new students are scaled by at most this factor (or its inverse), as executable size is a rough
+/// indicator of run time at best
+constexpr double MAX_SIZE_SCALE = 2.0;
+
+template <typename T>
+T median(std::vector<T> values) {
+    if (values.empty()) {
+        return T{};
+    }
+
+    const auto mid = values.begin() + static_cast<std::ptrdiff_t>(values.size() / 2);
+    std::ranges::nth_element(values, mid);
+
+    return *mid;
+}
+
+std::optional<std::size_t> get_exec_size(const StudentInfo& student) {
+    if (!student.assignment_path) {
+        return std::nullopt;
+    }
+
+    std::error_code err;
+    const auto size = std::filesystem::file_size(*student.assignment_path, err);
+
+    if (err) {
+        return std::nullopt;
+    }
+
+    return size;
+}
+
+} // namespace
+
+TimingDb::TimingDb(std::filesystem::path path)
+    : path_{std::move(path)} {}
+
+std::optional<std::filesystem::path> TimingDb::default_path() {
+    if (const char* xdg_state_home = std::getenv("XDG_STATE_HOME"); xdg_state_home != nullptr && *xdg_state_home) {
+        return std::filesystem::path{xdg_state_home} / "asmgrader" / "timings.json";
+    }
+
+    if (const char* home = std::getenv("HOME"); home != nullptr && *home) {
+        return std::filesystem::path{home} / ".local" / "state" / "asmgrader" / "timings.json";
+    }
+
+    return std::nullopt;
+}
+
+Result<void> TimingDb::load() {
+    assignments_.clear();
+
+    std::ifstream file{path_};
+
+    if (!file) {
+        LOG_DEBUG("No timing database at {:?}", path_.string());
+        return {};
+    }
+
+    const auto json = nlohmann::json::parse(file, nullptr, /*allow_exceptions=*/false);
+
+    if (json.is_discarded()) {
+        LOG_WARN("Timing database at {:?} is malformed; ignoring it", path_.string());
+        return ErrorKind::BadArgument;
+    }
+
+    try {
+        for (const auto& [assignment_name, assignment_json] : json.at("assignments").items()) {
+            AssignmentTimings& timings = assignments_[assignment_name];
+
+            for (const auto& [test_name, samples_json] : assignment_json.at("tests").items()) {
+                auto& samples = timings.tests[test_name];
+
+                for (const auto& sample : samples_json) {
+                    samples.emplace_back(sample.get<std::chrono::milliseconds::rep>());
+                }
+            }
+
+            for (const auto& [exec_path, student_json] : assignment_json.at("students").items()) {
+                StudentTiming& student = timings.students[exec_path];
+                student.exec_size = student_json.at("exec_size").get<std::size_t>();
+
+                for (const auto& [test_name, duration_json] : student_json.at("tests").items()) {
+                    student.tests[test_name] =
+                        std::chrono::milliseconds{duration_json.get<std::chrono::milliseconds::rep>()};
+                }
+            }
+        }
+    } catch (const nlohmann::json::exception& ex) {
+        LOG_WARN("Timing database at {:?} is malformed ({}); ignoring it", path_.string(), ex.what());
+        assignments_.clear();
+        return ErrorKind::BadArgument;
+    }
+
+    return {};
+}
+
+Result<void> TimingDb::save() const {
+    nlohmann::json assignments_json = nlohmann::json::object();
+
+    for (const auto& [assignment_name, timings] : assignments_) {
+        nlohmann::json tests_json = nlohmann::json::object();
+        nlohmann::json students_json = nlohmann::json::object();
+
+        for (const auto& [test_name, samples] : timings.tests) {
+            auto& samples_json = tests_json[test_name] = nlohmann::json::array();
+
+            for (const std::chrono::milliseconds sample : samples) {
+                samples_json.push_back(sample.count());
+            }
+        }
+
+        for (const auto& [exec_path, student] : timings.students) {
+            nlohmann::json student_tests_json = nlohmann::json::object();
+
+            for (const auto& [test_name, duration] : student.tests) {
+                student_tests_json[test_name] = duration.count();
+            }
+
+            students_json[exec_path] = {{"exec_size", student.exec_size}, {"tests", std::move(student_tests_json)}};
+        }
+
+        assignments_json[assignment_name] = {{"tests", std::move(tests_json)}, {"students", std::move(students_json)}};
+    }
+
+    // So that a concurrent grader never sees a partially written database
+    return write_file_atomically(path_, nlohmann::json{{"assignments", std::move(assignments_json)}}.dump(2) + '\n');
+}
+
+std::chrono::milliseconds TimingDb::predict_test(std::string_view assignment_name, std::string_view test_name) const {
+    const AssignmentTimings* timings = find_assignment(assignment_name);
+
+    if (timings == nullptr) {
+        return {};
+    }
+
+    auto iter = timings->tests.find(test_name);
+
+    if (iter == timings->tests.end()) {
+        return {};
+    }
+
+    return median(iter->second);
+}
+
+std::chrono::milliseconds TimingDb::predict_student(std::string_view assignment_name, const StudentInfo& student,
+                                                    const std::function<bool(std::string_view)>& is_run) const {
+    const AssignmentTimings* timings = find_assignment(assignment_name);
+
+    if (timings == nullptr || !student.assignment_path) {
+        return {};
+    }
+
+    const std::optional<std::size_t> exec_size = get_exec_size(student);
+    std::chrono::milliseconds prediction{};
+
+    // The same submission as last time, unless it's since been replaced
+    if (auto iter = timings->students.find(student.assignment_path->string());
+        iter != timings->students.end() && iter->second.exec_size == exec_size) {
+        const StudentTiming& last_time = iter->second;
+
+        for (const auto& [test_name, samples] : timings->tests) {
+            if (!is_run(test_name)) {
+                continue;
+            }
+
+            // Tests never run for this student (e.g., added since) are as for any other student
+            auto test_iter = last_time.tests.find(test_name);
+            prediction += test_iter != last_time.tests.end() ? test_iter->second : median(samples);
+        }
+
+        return prediction;
+    }
+
+    for (const auto& [test_name, samples] : timings->tests) {
+        if (is_run(test_name)) {
+            prediction += median(samples);
+        }
+    }
+
+    std::vector<std::size_t> exec_sizes;
+    exec_sizes.reserve(timings->students.size());
+
+    for (const StudentTiming& other : timings->students | ranges::views::values) {
+        if (other.exec_size != 0) {
+            exec_sizes.push_back(other.exec_size);
+        }
+    }
+
+    const std::size_t typical_size = median(std::move(exec_sizes));
+
+    if (typical_size == 0 || !exec_size) {
+        return prediction;
+    }
+
+    const double scale = std::clamp(static_cast<double>(*exec_size) / static_cast<double>(typical_size),
+                                    1.0 / MAX_SIZE_SCALE, MAX_SIZE_SCALE);
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(prediction * scale);
+}
+
+void TimingDb::record(const StudentResult& student) {
+    const AssignmentResult& result = student.result;
+
+    // Not graded at all (e.g., no submission)
+    if (result.name.empty() || !student.info.assignment_path) {
+        return;
+    }
+
+    AssignmentTimings& timings = assignments_[result.name];
+    StudentTiming& student_timing = timings.students[student.info.assignment_path->string()];
+
+    // Durations of a replaced submission say nothing about the new one
+    if (const std::size_t exec_size = get_exec_size(student.info).value_or(0); student_timing.exec_size != exec_size) {
+        student_timing = StudentTiming{.exec_size = exec_size, .tests = {}};
+    }
+
+    for (const TestResult& test : result.test_results) {
+        // Replayed tests keep the duration of when they were last run
+        if (test.from_cache) {
+            continue;
+        }
+
+        auto& samples = timings.tests[test.name];
+        samples.push_back(test.duration);
+
+        if (samples.size() > MAX_SAMPLES_PER_TEST) {
+            samples.erase(samples.begin(), samples.end() - static_cast<std::ptrdiff_t>(MAX_SAMPLES_PER_TEST));
+        }
+
+        student_timing.tests[test.name] = test.duration;
+    }
+}
+
+const TimingDb::AssignmentTimings* TimingDb::find_assignment(std::string_view assignment_name) const {
+    auto iter = assignments_.find(assignment_name);
+
+    return iter == assignments_.end() ? nullptr : &iter->second;
+}
+
+} // namespace asmgrader
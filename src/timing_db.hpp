@@ -0,0 +1,80 @@
+#pragma once
+
+#include "common/error_types.hpp"
+#include "grading_session.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace asmgrader {
+
+/// How long tests and students took to grade on previous runs, used to grade the longest-running ones first
+///
+/// For each assignment, the last few durations of every test are kept, along with the last duration of every test of
+/// every student (keyed by the path of their executable). Each test of a student whose executable is the same size as
+/// last time is predicted to take as long as last time; for any other student, as long as its median duration, scaled
+/// by the size of their executable relative to others of the same assignment.
+///
+/// Stored as JSON. Not thread safe; predictions may be made concurrently only while nothing is recorded.
+class TimingDb
+{
+public:
+    explicit TimingDb(std::filesystem::path path);
+
+    /// `$XDG_STATE_HOME/asmgrader/timings.json`, or `~/.local/state/asmgrader/timings.json` if that's unset. Nullopt if
+    /// neither can be determined. Kept apart from the \ref ResultCache, so that clearing it keeps the history.
+    static std::optional<std::filesystem::path> default_path();
+
+    /// Replace the contents with those stored on disk. A missing file is just an empty database.
+    Result<void> load();
+
+    Result<void> save() const;
+
+    /// The median of the recorded durations of `test_name`, or zero if it's never been run
+    std::chrono::milliseconds predict_test(std::string_view assignment_name, std::string_view test_name) const;
+
+    /// The expected total duration of the tests of `student`, counting only known tests for which `is_run` holds
+    /// (e.g., excluding those whose results would be replayed from a \ref ResultCache)
+    std::chrono::milliseconds predict_student(std::string_view assignment_name, const StudentInfo& student,
+                                              const std::function<bool(std::string_view test_name)>& is_run) const;
+
+    /// Add the durations of every test of `student` that was actually run (i.e., not replayed from a cache)
+    void record(const StudentResult& student);
+
+    /// Number of durations kept for each test; older ones are dropped
+    static constexpr std::size_t MAX_SAMPLES_PER_TEST = 16;
+
+private:
+    struct StudentTiming
+    {
+        std::size_t exec_size{};
+
+        /// Test name -> last duration
+        std::map<std::string, std::chrono::milliseconds, std::less<>> tests;
+    };
+
+    struct AssignmentTimings
+    {
+        /// Test name -> durations, oldest first
+        std::map<std::string, std::vector<std::chrono::milliseconds>, std::less<>> tests;
+
+        /// Executable path -> timing
+        std::map<std::string, StudentTiming, std::less<>> students;
+    };
+
+    const AssignmentTimings* find_assignment(std::string_view assignment_name) const;
+
+    std::filesystem::path path_;
+
+    /// Assignment name -> timings
+    std::map<std::string, AssignmentTimings, std::less<>> assignments_;
+};
+
+} // namespace asmgrader
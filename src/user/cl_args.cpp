@@ -21,12 +21,16 @@
 #include <fmt/ostream.h>
 #include <gsl/util>
 
+#include <charconv>
+#include <chrono>
 #include <cstddef>
 #include <cstdlib>
 #include <exception>
 #include <filesystem>
 #include <span>
+#include <stdexcept>
 #include <string>
+#include <system_error>
 #include <string_view>
 
 namespace asmgrader {
@@ -38,7 +42,33 @@ CommandLineArgs::CommandLineArgs(std::span<const char*> args)
     setup_parser();
 }
 
-namespace {} // namespace
+namespace {
+
+/// Parses a positive number of milliseconds; throws std::invalid_argument otherwise
+std::chrono::milliseconds parse_milliseconds(std::string_view flag, const std::string& opt) {
+    std::chrono::milliseconds::rep value{};
+    const auto [ptr, ec] = std::from_chars(opt.data(), opt.data() + opt.size(), value);
+
+    if (ec != std::errc{} || ptr != opt.data() + opt.size() || value <= 0) {
+        throw std::invalid_argument(fmt::format("{} expects a positive number of milliseconds, got {:?}", flag, opt));
+    }
+
+    return std::chrono::milliseconds{value};
+}
+
+/// Parses a positive integer; throws std::invalid_argument otherwise
+std::size_t parse_positive(std::string_view flag, const std::string& opt) {
+    std::size_t value{};
+    const auto [ptr, ec] = std::from_chars(opt.data(), opt.data() + opt.size(), value);
+
+    if (ec != std::errc{} || ptr != opt.data() + opt.size() || value == 0) {
+        throw std::invalid_argument(fmt::format("{} expects a positive number, got {:?}", flag, opt));
+    }
+
+    return value;
+}
+
+} // namespace
 
 void CommandLineArgs::setup_parser() {
     if (auto term_sz = terminal_size(stdout)) {
@@ -179,6 +209,42 @@ void CommandLineArgs::setup_parser() {
         })
         .help("Filter for test cases to be run. Matching occurs if STR occurs anywhere within the test case name.");
 
+    arg_parser_.add_argument("--cpu-time-per-call")
+        .metavar("MS")
+        .nargs(1)
+        .action([this] (const std::string& opt) {
+                opts_buffer_.cpu_time_per_call = parse_milliseconds("--cpu-time-per-call", opt);
+        })
+        .help("CPU time that each function call (or run) of the program may use before timing out, "
+              "for tests that don't specify their own.");
+
+    arg_parser_.add_argument("--cpu-time-per-test")
+        .metavar("MS")
+        .nargs(1)
+        .action([this] (const std::string& opt) {
+                opts_buffer_.cpu_time_per_test = parse_milliseconds("--cpu-time-per-test", opt);
+        })
+        .help("CPU time that the program may use over an entire test before timing out, "
+              "for tests that don't specify their own. Unlimited by default.");
+
+    arg_parser_.add_argument("--max-blocked-time")
+        .metavar("MS")
+        .nargs(1)
+        .action([this] (const std::string& opt) {
+                opts_buffer_.max_blocked_time = parse_milliseconds("--max-blocked-time", opt);
+        })
+        .help("Wall-clock time that the program may spend blocked (e.g., waiting on input that never arrives) "
+              "before timing out, as it uses no CPU time meanwhile. 100 ms by default.");
+
+    arg_parser_.add_argument("--test-jobs")
+        .default_value(std::string{"1"})
+        .nargs(1)
+        .metavar("N")
+        .action([this] (const std::string& opt) {
+                opts_buffer_.num_test_jobs = parse_positive("--test-jobs", opt);
+        })
+        .help("Number of tests to run concurrently, per student. Tests marked as Serial are always run alone.");
+
     arg_parser_.add_argument("-c", "--color")
         .choices("never", "auto", "always")
         .default_value(std::string{"auto"})
@@ -228,6 +294,72 @@ void CommandLineArgs::setup_parser() {
                 opts_buffer_.search_path = opt;
         })
         .help("Root path to begin searching for student assignments.");
+
+    arg_parser_.add_argument("-j", "--jobs")
+        .default_value(std::string{"1"})
+        .nargs(1)
+        .metavar("N")
+        .action([this] (const std::string& opt) {
+                opts_buffer_.num_jobs = parse_positive("--jobs", opt);
+        })
+        .help("Number of students to grade concurrently.");
+
+    arg_parser_.add_argument("--output-order")
+        .choices("student", "completion")
+        .default_value(std::string{"student"})
+        .metavar("ORDER")
+        .nargs(1)
+        .action([this] (const std::string& opt) {
+                using enum ProgramOptions::OutputOrderOpt;
+
+                if (opt == "student") {
+                    opts_buffer_.output_order = Student;
+                } else if (opt == "completion") {
+                    opts_buffer_.output_order = Completion;
+                }
+        })
+        .help("Order in which to output the results of each student with --jobs: "
+              "the order that students were found in (the same as with a single job), or as soon as each is graded.");
+
+    arg_parser_.add_argument("--jobs-mode")
+        .choices("thread", "process")
+        .default_value(std::string{"thread"})
+        .metavar("MODE")
+        .nargs(1)
+        .action([this] (const std::string& opt) {
+                using enum ProgramOptions::JobsModeOpt;
+
+                if (opt == "thread") {
+                    opts_buffer_.jobs_mode = Thread;
+                } else if (opt == "process") {
+                    opts_buffer_.jobs_mode = Process;
+                }
+        })
+        .help("How to grade students concurrently with --jobs: on threads of the grader, or in separate worker "
+              "processes, which isolates students from each other's crashes and hangs.");
+
+    arg_parser_.add_argument("--no-cache")
+        .flag()
+        .action([this] (const std::string& /*unused*/) {
+                opts_buffer_.use_cache = false;
+        })
+        .help("Run every test, rather than reusing results stored by previous runs for unchanged executables. "
+              "No results are stored either.");
+
+    arg_parser_.add_argument("--clear-cache")
+        .flag()
+        .action([this] (const std::string& /*unused*/) {
+                opts_buffer_.clear_cache = true;
+        })
+        .help("Remove every result stored by previous runs before grading.");
+
+    arg_parser_.add_argument("--timing-report")
+        .flag()
+        .action([this] (const std::string& /*unused*/) {
+                opts_buffer_.timing_report = true;
+        })
+        .help("After grading, show how long the tests of each student were predicted to take, based on previous "
+              "runs, against how long they actually took.");
 #endif // PROFESSOR_VERSION
 
     arg_parser_.add_argument("-f", "--file")
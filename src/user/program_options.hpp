@@ -7,6 +7,7 @@
 #include "common/expected.hpp"
 #include "output/verbosity.hpp"
 #include "program/program.hpp"
+#include "subprocess/tracer_options.hpp"
 #include "user/assignment_file_searcher.hpp"
 #include "version.hpp"
 
@@ -16,6 +17,8 @@
 #include <libassert/assert.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <exception>
 #include <filesystem>
 #include <optional>
@@ -48,6 +51,16 @@ struct ProgramOptions
 
     enum class ColorizeOpt { Auto, Always, Never } colorize_option;
 
+    /// CPU time limits for tests that don't specify their own with \ref metadata::CpuTimeBudget
+    std::optional<std::chrono::milliseconds> cpu_time_per_call;
+    std::optional<std::chrono::milliseconds> cpu_time_per_test;
+
+    /// Wall-clock time the program may spend blocked (e.g., waiting on input) before timing out
+    std::optional<std::chrono::milliseconds> max_blocked_time;
+
+    /// Number of tests of a single student to run concurrently
+    std::size_t num_test_jobs = 1;
+
     // TODO: Premit simplified execution of individual files in prof mode. Has to be mutually excusive with some
     // other opts
 
@@ -59,6 +72,26 @@ struct ProgramOptions
     std::filesystem::path database_path = DEFAULT_DATABASE_PATH;
     std::filesystem::path search_path = DEFAULT_SEARCH_PATH;
 
+    /// Number of students to grade concurrently
+    std::size_t num_jobs = 1;
+
+    /// Student = output the results of each student in the order that students were found
+    /// Completion = output the results of each student as soon as they are graded
+    enum class OutputOrderOpt { Student, Completion } output_order = OutputOrderOpt::Student;
+
+    /// Thread = grade each student on a thread of the grader
+    /// Process = grade each student in a separate worker process, which is replaced if it crashes or hangs
+    enum class JobsModeOpt { Thread, Process } jobs_mode = JobsModeOpt::Thread;
+
+    /// Whether to reuse results stored by previous runs, and store new ones (see \ref ResultCache)
+    bool use_cache = true;
+
+    /// Whether to remove every stored result before grading
+    bool clear_cache = false;
+
+    /// Whether to output the predicted and actual time taken to grade each student (see \ref TimingDb)
+    bool timing_report = false;
+
     // ###### Argument defaults
 
     static constexpr std::string_view DEFAULT_DATABASE_PATH = "students.csv";
@@ -97,6 +130,22 @@ struct ProgramOptions
         return {};
     }
 
+    /// Default CPU time limits for the program under test
+    CpuTimeLimits get_cpu_time_limits() const {
+        CpuTimeLimits limits;
+
+        if (cpu_time_per_call) {
+            limits.per_run = *cpu_time_per_call;
+        }
+        limits.total = cpu_time_per_test;
+
+        if (max_blocked_time) {
+            limits.max_blocked = *max_blocked_time;
+        }
+
+        return limits;
+    }
+
     /// Verify that all fields are valid
     Expected<void, std::string> validate() {
         // Assume that all enumerators have valid values except for verbosity
@@ -11,6 +11,9 @@ constexpr std::string_view exec_filename = [] {
 FILE_METADATA(Assignment("thing", exec_filename));
 
 TEST("sum function") {
+    // The syscalls of sum_and_write are inspected below
+    ctx.set_call_tracing_policy(TracingPolicy::Full);
+
     AsmFunction sum = ctx.find_function<u64(u64, u64)>("putch");
     AsmFunction sum_and_write = ctx.find_function<void(u64, u64)>("sum_and_write");
 
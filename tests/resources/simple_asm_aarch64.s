@@ -55,6 +55,37 @@ exiting_fn:
     // status (x0) is passed as param
     svc     0
 
+/// This subroutine makes a number of cheap syscalls in a row
+///   Parameters:
+///     x0 (u64) - the number of syscalls to make
+syscall_loop_fn:
+    mov     x9, x0   // x0 is clobbered by each syscall
+1:
+    cbz     x9, 2f
+    mov     x8, 172  // SYS_getpid
+    svc     0
+    sub     x9, x9, 1
+    b       1b
+2:
+    ret
+
+/// This subroutine writes strHello to stdout a number of times
+///   Parameters:
+///     x0 (u64) - the number of times to write it
+write_loop_fn:
+    mov     x9, x0   // x0 is needed for each syscall
+1:
+    cbz     x9, 2f
+    mov     x8, 64         // SYS_write
+    mov     x0, 1          // fd param = stdout
+    ldr     x1, =strHello  // str param = &strHello
+    mov     x2, 22         // len param = 22
+    svc     0
+    sub     x9, x9, 1
+    b       1b
+2:
+    ret
+
 /// This subroutine will segfault by continuing execution into the next section
 segfaulting_fn:
 
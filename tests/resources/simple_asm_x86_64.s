@@ -58,6 +58,37 @@ exiting_fn:
     # status (rdi) is passed as param
     syscall
 
+/// This subroutine makes a number of cheap syscalls in a row
+///   Parameters:
+///     rdi (u64) - the number of syscalls to make
+syscall_loop_fn:
+    test    rdi, rdi
+    jz      .Lsyscall_loop_done
+    mov     rax, 39  # SYS_getpid
+    syscall
+    dec     rdi
+    jmp     syscall_loop_fn
+.Lsyscall_loop_done:
+    ret
+
+/// This subroutine writes strHello to stdout a number of times
+///   Parameters:
+///     rdi (u64) - the number of times to write it
+write_loop_fn:
+    mov     r8, rdi  # rdi is needed for each syscall
+.Lwrite_loop:
+    test    r8, r8
+    jz      .Lwrite_loop_done
+    mov     rax, 1   # SYS_write
+    mov     rdi, 1   # stdout
+    lea     rsi, [rip + strHello]
+    mov     rdx, 22
+    syscall
+    dec     r8
+    jmp     .Lwrite_loop
+.Lwrite_loop_done:
+    ret
+
 /// This subroutine will segfault by continuing execution into the next section
 segfaulting_fn:
 
@@ -0,0 +1,79 @@
+#include "catch2_custom.hpp"
+
+#include "grading_session.hpp"
+#include "output/buffered_serializer.hpp"
+#include "output/event_codec.hpp"
+#include "output/serializer.hpp"
+
+#include <optional>
+#include <string>
+
+using namespace asmgrader;
+
+namespace {
+
+/// Sends the same events to `target` every time, from locals which are gone by the time they're replayed
+void send_events(Serializer& target) {
+    const StudentInfo info{.first_name = "Jane",
+                           .last_name = "Doe",
+                           .names_known = true,
+                           .assignment_path = "lab.out",
+                           .subst_regex_string = ""};
+
+    const RequirementResult requirement{.passed = true,
+                                        .description = "it works",
+                                        .expression_repr = std::nullopt,
+                                        .debug_info = RequirementResult::DebugInfo{"1 == 1"}};
+
+    const TestResult test_result{.name = "passing",
+                                 .requirement_results = {requirement},
+                                 .num_passed = 1,
+                                 .num_total = 1,
+                                 .weight = 1,
+                                 .error = std::nullopt};
+
+    target.on_student_begin(info);
+    target.on_test_begin(test_result.name);
+    target.on_requirement_result(requirement);
+    target.on_test_result(test_result);
+    target.on_warning(std::string{"careful"});
+    target.on_error("oops");
+    target.on_assignment_result(
+        AssignmentResult{.name = "lab", .test_results = {test_result}, .num_requirements_total = 1});
+    target.on_cache_stats(CacheStats{.hits = 1, .misses = 2});
+    target.on_student_end(info);
+    target.finalize();
+}
+
+} // namespace
+
+TEST_CASE("Buffered events are replayed in order") {
+    EventEncoder expected;
+    send_events(expected);
+
+    BufferedSerializer buffered;
+    send_events(buffered);
+
+    EventEncoder actual;
+    buffered.replay(actual);
+
+    REQUIRE(actual.take_bytes() == expected.take_bytes());
+
+    REQUIRE(buffered.get_assignment_result().has_value());
+    REQUIRE(buffered.get_assignment_result()->name == "lab");
+    REQUIRE(buffered.get_assignment_result()->test_results.size() == 1);
+
+    // Replayed events are forgotten, but the assignment result is not
+    buffered.replay(actual);
+    REQUIRE(actual.take_bytes().empty());
+    REQUIRE(buffered.get_assignment_result().has_value());
+}
+
+TEST_CASE("Nothing is replayed when nothing is buffered") {
+    BufferedSerializer buffered;
+    REQUIRE_FALSE(buffered.get_assignment_result().has_value());
+
+    EventEncoder actual;
+    buffered.replay(actual);
+    REQUIRE(actual.take_bytes().empty());
+}
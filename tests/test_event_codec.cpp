@@ -0,0 +1,142 @@
+#include "catch2_custom.hpp"
+
+#include "common/aliases.hpp"
+#include "exceptions.hpp"
+#include "grading_session.hpp"
+#include "output/buffered_serializer.hpp"
+#include "output/event_codec.hpp"
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+
+using namespace asmgrader;
+
+namespace {
+
+AssignmentResult make_assignment_result() {
+    TestResult passing{.name = "passing",
+                       .requirement_results = {RequirementResult{.passed = true,
+                                                                 .description = "it works",
+                                                                 .expression_repr = std::nullopt,
+                                                                 .debug_info = RequirementResult::DebugInfo{"1 == 1"}}},
+                       .num_passed = 1,
+                       .num_total = 1,
+                       .weight = 2,
+                       .error = std::nullopt,
+                       .duration = std::chrono::milliseconds{125}};
+
+    TestResult erroring{.name = "erroring",
+                        .requirement_results = {},
+                        .num_passed = 0,
+                        .num_total = 3,
+                        .weight = 1,
+                        .error = ContextInternalError{ErrorKind::TimedOut, "too slow"}};
+
+    return AssignmentResult{.name = "lab",
+                            .test_results = {passing, erroring},
+                            .num_requirements_total = 4,
+                            .duration = std::chrono::milliseconds{150}};
+}
+
+} // namespace
+
+TEST_CASE("Events survive encoding and decoding") {
+    const StudentInfo info{.first_name = "Jane",
+                           .last_name = "Doe",
+                           .names_known = true,
+                           .assignment_path = "lab.out",
+                           .subst_regex_string = ""};
+    const AssignmentResult assignment_result = make_assignment_result();
+
+    EventEncoder encoder;
+    encoder.on_student_begin(info);
+    encoder.on_test_begin("passing");
+    encoder.on_test_result(assignment_result.test_results.at(0));
+    encoder.on_warning("careful");
+    encoder.on_assignment_result(assignment_result);
+    encoder.on_student_end(info);
+
+    const std::string bytes = encoder.take_bytes();
+    REQUIRE(encoder.take_bytes().empty());
+
+    StringInterner interner;
+    BufferedSerializer decoded;
+    REQUIRE(decode_events(bytes, decoded, interner));
+
+    const auto& res = decoded.get_assignment_result();
+    REQUIRE(res.has_value());
+    REQUIRE(res->name == "lab");
+    REQUIRE(res->num_requirements_total == 4);
+    REQUIRE(res->duration == std::chrono::milliseconds{150});
+    REQUIRE(res->test_results.size() == 2);
+
+    const TestResult& passing = res->test_results.at(0);
+    REQUIRE(passing.passed());
+    REQUIRE(passing.weight == 2);
+    REQUIRE(passing.duration == std::chrono::milliseconds{125});
+    REQUIRE(passing.requirement_results.size() == 1);
+    REQUIRE(passing.requirement_results.at(0).description == "it works");
+    REQUIRE(passing.requirement_results.at(0).debug_info.msg == "1 == 1");
+
+    const TestResult& erroring = res->test_results.at(1);
+    REQUIRE(erroring.error.has_value());
+    REQUIRE(erroring.error->get_error() == ErrorKind::TimedOut);
+    REQUIRE(std::string{erroring.error->what()} == "too slow");
+    REQUIRE(erroring.num_failed() == 3);
+}
+
+TEST_CASE("Malformed events are rejected") {
+    EventEncoder encoder;
+    encoder.on_assignment_result(make_assignment_result());
+
+    const std::string bytes = encoder.take_bytes();
+
+    StringInterner interner;
+    BufferedSerializer decoded;
+    REQUIRE_FALSE(decode_events(std::string_view{bytes}.substr(0, bytes.size() / 2), decoded, interner));
+    REQUIRE_FALSE(decoded.get_assignment_result().has_value());
+
+    REQUIRE_FALSE(decode_events(std::string(1, '\xff'), decoded, interner));
+
+    // A huge string size must be rejected rather than trusted
+    std::string bad_size = bytes;
+    bad_size[sizeof(u8) + sizeof(u64) - 1] = '\x7f'; // Most significant byte of the first string's size
+    REQUIRE_FALSE(decode_events(bad_size, decoded, interner));
+}
+
+TEST_CASE("Decoded events outlive the viewed strings") {
+    StringInterner interner;
+    BufferedSerializer decoded;
+
+    {
+        const std::string condition = "x == 42";
+
+        TestResult result{.name = "cached",
+                          .requirement_results = {RequirementResult{
+                              .passed = false,
+                              .description = "x is the answer",
+                              .expression_repr = std::nullopt,
+                              .debug_info = RequirementResult::DebugInfo{condition}}},
+                          .num_passed = 0,
+                          .num_total = 1,
+                          .weight = 1,
+                          .error = std::nullopt,
+                          .timed_out = true,
+                          .from_cache = true};
+
+        EventEncoder encoder;
+        encoder.on_assignment_result(AssignmentResult{.name = "lab", .test_results = {result}});
+
+        REQUIRE(decode_events(encoder.take_bytes(), decoded, interner));
+    }
+
+    const auto& res = decoded.get_assignment_result();
+    REQUIRE(res.has_value());
+
+    const TestResult& cached = res->test_results.at(0);
+    REQUIRE(cached.timed_out);
+    REQUIRE(cached.from_cache);
+    REQUIRE(cached.requirement_results.at(0).debug_info.msg == "x == 42");
+}
@@ -4,6 +4,7 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <chrono>
 #include <concepts>
 #include <type_traits>
 
@@ -65,6 +66,16 @@ TEST_CASE("Obtain present attributes") {
     REQUIRE(Metadata{ProfOnly, Assignment("", "")}.get<Assignment>() == Assignment("", ""));
     REQUIRE(Metadata{ProfOnly, Assignment("", "")}.get<Assignment>() != Assignment("oh", "no"));
     REQUIRE(Metadata{Weight{5}, ProfOnly, Assignment("", "")}.get<Weight>() == Weight(5));
+
+    using namespace std::chrono_literals;
+    STATIC_REQUIRE(Metadata{CpuTimeBudget{.per_call = 500ms}}.get<CpuTimeBudget>()->per_call == 500ms);
+    STATIC_REQUIRE(Metadata{ProfOnly, CpuTimeBudget{.per_test = 2s}}.get<CpuTimeBudget>()->per_call == 0ms);
+
+    STATIC_REQUIRE(Metadata{DrainProgram, ProfOnly}.get<DrainProgramTag>() == DrainProgram);
+    STATIC_REQUIRE(!Metadata{ProfOnly}.get<DrainProgramTag>());
+
+    STATIC_REQUIRE(Metadata{Serial, DrainProgram}.get<SerialTag>() == Serial);
+    STATIC_REQUIRE(!Metadata{DrainProgram}.get<SerialTag>());
 }
 
 TEST_CASE("Attributes with get_and") {
@@ -0,0 +1,105 @@
+#include "catch2_custom.hpp"
+
+#include "common/linux.hpp"
+#include "subprocess/output_buffer.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include <fcntl.h>
+
+using asmgrader::OutputBuffer;
+using asmgrader::OutputOverflow;
+
+TEST_CASE("Consume output from an uncapped buffer") {
+    OutputBuffer buffer(std::nullopt, OutputOverflow::DropNewest);
+
+    buffer.append("Hello, ");
+    REQUIRE(buffer.unread() == "Hello, ");
+    REQUIRE(buffer.consume() == "Hello, ");
+    REQUIRE(buffer.consume().empty());
+
+    buffer.append("world!");
+    REQUIRE(buffer.consume() == "world!");
+    REQUIRE(buffer.view() == "Hello, world!");
+    REQUIRE(buffer.bytes().size() == buffer.size());
+    REQUIRE(buffer.num_dropped() == 0);
+
+    buffer.clear();
+    REQUIRE(buffer.empty());
+    REQUIRE(buffer.unread().empty());
+}
+
+TEST_CASE("Output beyond the capacity is dropped according to the overflow policy") {
+    SECTION("Drop newest") {
+        OutputBuffer buffer(8, OutputOverflow::DropNewest);
+
+        buffer.append("0123456");
+        buffer.append("789abc");
+
+        REQUIRE(buffer.view() == "01234567");
+        REQUIRE(buffer.consume() == "01234567");
+        REQUIRE(buffer.num_dropped() == 5);
+
+        buffer.append("def");
+        REQUIRE(buffer.consume().empty());
+        REQUIRE(buffer.num_dropped() == 8);
+    }
+
+    SECTION("Ring") {
+        OutputBuffer buffer(8, OutputOverflow::Ring);
+
+        buffer.append("0123");
+        REQUIRE(buffer.consume() == "0123");
+
+        buffer.append("456789abc");
+
+        REQUIRE(buffer.view() == "56789abc");
+        // Unread data that was overwritten is skipped
+        REQUIRE(buffer.consume() == "56789abc");
+        REQUIRE(buffer.num_dropped() == 5);
+    }
+
+    SECTION("Ring keeps the newest data across many compactions") {
+        OutputBuffer buffer(100, OutputOverflow::Ring);
+
+        std::string expected;
+        for (int i = 0; i < 10'000; ++i) {
+            const std::string line = std::to_string(i) + "\n";
+            buffer.append(line);
+            expected += line;
+        }
+
+        REQUIRE(buffer.size() == 100);
+        REQUIRE(buffer.view() == std::string_view{expected}.substr(expected.size() - 100));
+        REQUIRE(buffer.num_dropped() == expected.size() - 100);
+    }
+}
+
+TEST_CASE("Drain output from a pipe") {
+    auto pipe = asmgrader::linux::pipe2(O_NONBLOCK);
+    REQUIRE(pipe);
+
+    OutputBuffer buffer(16, OutputOverflow::DropNewest);
+
+    REQUIRE(buffer.drain(pipe->read_fd) == std::size_t{0});
+
+    REQUIRE(asmgrader::linux::write(pipe->write_fd, "Hello, "));
+    REQUIRE(asmgrader::linux::write(pipe->write_fd, "world!"));
+    REQUIRE(buffer.drain(pipe->read_fd) == std::size_t{13});
+    REQUIRE(buffer.consume() == "Hello, world!");
+
+    // The pipe is still drained once the capacity is reached, so that the writer never blocks
+    REQUIRE(asmgrader::linux::write(pipe->write_fd, std::string(100, 'x')));
+    REQUIRE(buffer.drain(pipe->read_fd) == std::size_t{100});
+    REQUIRE(buffer.consume() == "xxx");
+    REQUIRE(buffer.num_dropped() == 97);
+
+    std::ignore = asmgrader::linux::close(pipe->read_fd);
+    std::ignore = asmgrader::linux::close(pipe->write_fd);
+}
@@ -3,9 +3,19 @@
 #include "common/aliases.hpp"
 #include "common/error_types.hpp"
 #include "program/program.hpp"
+#include "subprocess/memory/memory_io_serde.hpp" // IWYU pragma: keep
+#include "subprocess/memory/tracee_heap.hpp"
+#include "subprocess/output_buffer.hpp"
+#include "subprocess/tracer_options.hpp"
 
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 using namespace asmgrader::aliases;
 
@@ -14,6 +24,8 @@ using sum_and_write = void(u64, std::uint64_t);
 using timeout_fn = void();
 using segfaulting_fn = void();
 using exiting_fn = void(u64);
+using syscall_loop_fn = void(u64);
+using write_loop_fn = void(u64);
 
 TEST_CASE("Try to call functions that don't exist") {
     asmgrader::Program prog(ASM_TESTS_EXEC, {});
@@ -75,6 +87,68 @@ TEST_CASE("Test that timeouts are handled properly with timeout_fn") {
     REQUIRE(prog.call_function<timeout_fn>("timeout_fn") == TimedOut);
 }
 
+TEST_CASE("Timeouts are measured in CPU time used by the program") {
+    using namespace std::chrono_literals;
+    using asmgrader::ErrorKind::TimedOut;
+
+    asmgrader::Program prog(ASM_TESTS_EXEC, {});
+    auto& tracer = prog.get_subproc().get_tracer();
+
+    asmgrader::CpuTimeLimits limits;
+    limits.per_run = 50ms;
+    tracer.set_cpu_time_limits(limits);
+
+    const auto before = tracer.get_cpu_time_used();
+    REQUIRE(before);
+    REQUIRE(prog.call_function<timeout_fn>("timeout_fn") == TimedOut);
+    REQUIRE(*tracer.get_cpu_time_used() - *before >= 50ms);
+
+    // The total limit spans calls; once it's used up, every call times out
+    limits.total = *tracer.get_cpu_time_used() + 20ms;
+    tracer.set_cpu_time_limits(limits);
+
+    REQUIRE(prog.call_function<timeout_fn>("timeout_fn") == TimedOut);
+    REQUIRE(*tracer.get_cpu_time_used() >= *limits.total);
+    REQUIRE(prog.call_function<sum>("sum", 1, 2) == TimedOut);
+}
+
+TEST_CASE("Programs making many syscalls don't time out by default") {
+    using namespace std::chrono_literals;
+
+    asmgrader::Program prog(ASM_TESTS_EXEC, {});
+    auto& tracer = prog.get_subproc().get_tracer();
+
+    // Wall-clock time between stops used to be limited instead, which a program making steady syscalls never hit.
+    // Make more syscalls until a single call uses well over what the per-run limit once was.
+    std::chrono::nanoseconds call_cpu_time{};
+    for (u64 num_syscalls = 1000; call_cpu_time < 50ms && num_syscalls <= 10'000'000; num_syscalls *= 2) {
+        const auto before = tracer.get_cpu_time_used();
+        REQUIRE(before);
+
+        REQUIRE(prog.call_function<syscall_loop_fn>("syscall_loop_fn", num_syscalls));
+
+        call_cpu_time = *tracer.get_cpu_time_used() - *before;
+    }
+
+    REQUIRE(call_cpu_time >= 50ms);
+}
+
+TEST_CASE("Programs printing more than the stdout pipe holds don't block") {
+    asmgrader::Program prog(ASM_TESTS_EXEC, {});
+    auto& subproc = prog.get_subproc();
+
+    // Twice the largest the pipe can be, within a single call. Each write is of strHello (22 bytes).
+    constexpr std::size_t WRITE_SIZE = 22;
+    constexpr u64 NUM_WRITES = 2 * asmgrader::OutputCaptureOptions::DEFAULT_PIPE_SIZE / WRITE_SIZE;
+
+    const std::size_t size_before = subproc.get_full_stdout().size();
+
+    REQUIRE(prog.call_function<write_loop_fn>("write_loop_fn", NUM_WRITES));
+    REQUIRE_FALSE(subproc.get_tracer().has_timed_out());
+
+    REQUIRE(subproc.get_full_stdout().size() - size_before == NUM_WRITES * WRITE_SIZE);
+}
+
 TEST_CASE("Test that segfaults are essentially ignored") {
     asmgrader::Program prog(ASM_TESTS_EXEC, {});
 
@@ -100,6 +174,11 @@ TEST_CASE("Test that SYS_exit is properly thwarted") {
     REQUIRE(prog.call_function<exiting_fn>("exiting_fn", 42) == UnexpectedReturn);
 
     REQUIRE(prog.get_subproc().is_alive());
+
+    // The program should have been restored to a usable state
+    REQUIRE(prog.call_function<sum>("sum", 1, 2) == 3ull);
+    REQUIRE(prog.call_function<exiting_fn>("exiting_fn", 42) == UnexpectedReturn);
+    REQUIRE(prog.call_function<sum>("sum", 3, 4) == 7ull);
 }
 
 TEST_CASE("Test that executables with 'weird' file names work") {
@@ -121,4 +200,112 @@ TEST_CASE("Test that executables with 'weird' file names work") {
     REQUIRE(prog.call_function<exiting_fn>("exiting_fn", 42) == UnexpectedReturn);
 
     REQUIRE(prog.get_subproc().is_alive());
+
+    // The program should have been restored to a usable state
+    REQUIRE(prog.call_function<sum>("sum", 1, 2) == 3ull);
+    REQUIRE(prog.call_function<exiting_fn>("exiting_fn", 42) == UnexpectedReturn);
+    REQUIRE(prog.call_function<sum>("sum", 3, 4) == 7ull);
+}
+
+TEST_CASE("Allocate memory in the program") {
+    asmgrader::Program prog(ASM_TESTS_EXEC, {});
+    auto& mio = prog.get_subproc().get_tracer().get_memory_io();
+
+    // Far more than fits in the tracer's own page
+    constexpr std::size_t LARGE_SIZE = 1 << 20;
+    auto large = prog.alloc_mem(LARGE_SIZE);
+    REQUIRE(large);
+    REQUIRE(mio.write(large->get_address() + LARGE_SIZE - 4, std::string{"abc"}));
+    REQUIRE(mio.read<std::string>(large->get_address() + LARGE_SIZE - 4) == "abc");
+
+    std::vector<asmgrader::TraceeAllocation> small_allocations;
+    for (int i = 0; i < 1000; ++i) {
+        auto small = prog.alloc_mem(64);
+        REQUIRE(small);
+        small_allocations.push_back(*small);
+    }
+    REQUIRE(mio.write(small_allocations.back().get_address(), std::string{"xyz"}));
+
+    // The heap is not part of the checkpoint, so allocations and their contents survive the program being restored
+    REQUIRE(prog.call_function<exiting_fn>("exiting_fn", 42) == asmgrader::ErrorKind::UnexpectedReturn);
+    REQUIRE(mio.read<std::string>(small_allocations.back().get_address()) == "xyz");
+
+    // Nor do arenas added since the checkpoint prevent restoring it in place
+    auto late = prog.alloc_mem(LARGE_SIZE);
+    REQUIRE(late);
+    REQUIRE(mio.write(late->get_address(), std::string{"def"}));
+    const auto pid = prog.get_subproc().get_pid();
+    REQUIRE(prog.call_function<exiting_fn>("exiting_fn", 42) == asmgrader::ErrorKind::UnexpectedReturn);
+    REQUIRE(prog.get_subproc().get_pid() == pid);
+    REQUIRE(mio.read<std::string>(late->get_address()) == "def");
+    REQUIRE(prog.call_function<sum>("sum", 1, 2) == 3ull);
+
+    prog.reset_heap();
+    REQUIRE(prog.get_subproc().get_tracer().get_heap().num_allocated() == 0);
+}
+
+TEST_CASE("Allocate memory shared with the program") {
+    asmgrader::Program prog(ASM_TESTS_EXEC, {}, asmgrader::TracerOptions{.shared_heap_size = 64 * 1024});
+    auto& tracer = prog.get_subproc().get_tracer();
+    auto& mio = tracer.get_memory_io();
+
+    const auto& arenas = tracer.get_heap().get_arenas();
+    REQUIRE(arenas.size() == 1);
+    REQUIRE(arenas.front().shared);
+
+    auto buffer = prog.alloc_mem(64);
+    REQUIRE(buffer);
+    REQUIRE(buffer->get_address() >= arenas.front().start);
+    REQUIRE(buffer->get_address() < arenas.front().start + arenas.front().length);
+    REQUIRE(mio.write(buffer->get_address(), std::string{"abc"}));
+
+    // Shared memory is not part of the checkpoint, so its contents survive the program being restored
+    REQUIRE(prog.call_function<exiting_fn>("exiting_fn", 42) == asmgrader::ErrorKind::UnexpectedReturn);
+    REQUIRE(mio.read<std::string>(buffer->get_address()) == "abc");
+
+    // The call table and results of a batch live in the shared memory, and must be seen by both sides
+    const std::vector<std::tuple<std::uint64_t, std::uint64_t>> arg_sets{{1, 2}, {3, 4}, {5, 6}};
+    auto res = prog.call_function_batch<sum>(prog.get_symtab().find("sum")->address, std::span{arg_sets});
+    REQUIRE(res);
+    REQUIRE(*res == std::vector<u64>{3, 7, 11});
+}
+
+TEST_CASE("Call sum function in a batch") {
+    asmgrader::Program prog(ASM_TESTS_EXEC, {});
+    const std::uintptr_t sum_addr = prog.get_symtab().find("sum")->address;
+
+    std::vector<std::tuple<std::uint64_t, std::uint64_t>> arg_sets;
+    for (u64 i = 0; i < 5000; ++i) {
+        arg_sets.emplace_back(i, i * 3);
+    }
+    arg_sets.emplace_back(static_cast<u64>(-1), static_cast<u64>(-12));
+
+    auto res = prog.call_function_batch<sum>(sum_addr, std::span{std::as_const(arg_sets)});
+    REQUIRE(res);
+    REQUIRE(res->size() == arg_sets.size());
+
+    for (u64 i = 0; i < 5000; ++i) {
+        REQUIRE(res->at(i) == i * 4);
+    }
+    REQUIRE(res->back() == static_cast<u64>(-13));
+
+    // Empty batches don't run the program at all
+    REQUIRE(prog.call_function_batch<sum>(sum_addr, std::span<const std::tuple<std::uint64_t, std::uint64_t>>{})
+                ->empty());
+
+    // The program is usable as normal afterwards
+    REQUIRE(prog.call_function<sum>("sum", 1, 2) == 3ull);
+}
+
+TEST_CASE("Batch calls fail as a whole") {
+    asmgrader::Program prog(ASM_TESTS_EXEC, {});
+    const std::uintptr_t exiting_fn_addr = prog.get_symtab().find("exiting_fn")->address;
+
+    const std::vector<std::tuple<u64>> arg_sets{{1}, {2}, {3}};
+
+    REQUIRE(prog.call_function_batch<exiting_fn>(exiting_fn_addr, std::span{arg_sets}) ==
+            asmgrader::ErrorKind::UnexpectedReturn);
+
+    REQUIRE(prog.get_subproc().is_alive());
+    REQUIRE(prog.call_function<sum>("sum", 3, 4) == 7ull);
 }
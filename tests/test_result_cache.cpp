@@ -0,0 +1,202 @@
+#include "catch2_custom.hpp"
+
+#include "common/error_types.hpp"
+#include "exceptions.hpp"
+#include "grading_session.hpp"
+#include "output/event_codec.hpp"
+#include "output/serializer.hpp"
+#include "result_cache.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace asmgrader;
+
+namespace {
+
+std::filesystem::path make_temp_dir() {
+    auto dir = std::filesystem::temp_directory_path() / ("asmgrader-result-cache-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    return dir;
+}
+
+/// Paths of every entry in the cache at `dir`
+std::vector<std::filesystem::path> list_entries(const std::filesystem::path& dir) {
+    std::vector<std::filesystem::path> entries;
+
+    for (const auto& entry : std::filesystem::directory_iterator{dir}) {
+        entries.push_back(entry.path());
+    }
+
+    return entries;
+}
+
+std::string read_entry(const std::filesystem::path& path) {
+    std::ifstream file{path, std::ios::binary};
+    return {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+void write_entry(const std::filesystem::path& path, const std::string& contents) {
+    std::ofstream{path, std::ios::binary | std::ios::trunc} << contents;
+}
+
+/// Runs a fake test, counting how many times it was actually run
+class FakeTest
+{
+public:
+    explicit FakeTest(TestResult result)
+        : result_{std::move(result)} {}
+
+    TestResult run_or_replay(ResultCache& cache, std::string_view exec_key, std::string_view settings_key,
+                             std::string& output) {
+        EventEncoder encoder;
+
+        TestResult result = cache.replay_or_run(exec_key, settings_key, result_.name, encoder, [this](Serializer& tee) {
+            ++num_runs;
+
+            tee.on_test_begin(result_.name);
+
+            for (const RequirementResult& requirement : result_.requirement_results) {
+                tee.on_requirement_result(requirement);
+            }
+
+            return result_;
+        });
+
+        output = encoder.take_bytes();
+
+        return result;
+    }
+
+    int num_runs = 0;
+
+private:
+    TestResult result_;
+};
+
+TestResult make_test_result(std::string name) {
+    return TestResult{.name = std::move(name),
+                      .requirement_results = {RequirementResult{.passed = true,
+                                                                .description = "it works",
+                                                                .expression_repr = std::nullopt,
+                                                                .debug_info = RequirementResult::DebugInfo{"1 == 1"}}},
+                      .num_passed = 1,
+                      .num_total = 1,
+                      .weight = 1,
+                      .error = std::nullopt};
+}
+
+} // namespace
+
+TEST_CASE("Cached results are replayed only for the same executable, settings and test") {
+    const auto dir = make_temp_dir();
+    ResultCache cache{dir};
+
+    FakeTest test{make_test_result("passing")};
+    std::string first_output;
+    std::string output;
+
+    const TestResult first = test.run_or_replay(cache, "exec", "settings", first_output);
+    REQUIRE(test.num_runs == 1);
+    REQUIRE_FALSE(first.from_cache);
+    REQUIRE(list_entries(dir).size() == 1);
+
+    const TestResult replayed = test.run_or_replay(cache, "exec", "settings", output);
+    REQUIRE(test.num_runs == 1);
+    REQUIRE(replayed.from_cache);
+    REQUIRE(replayed.name == first.name);
+    REQUIRE(replayed.num_passed == first.num_passed);
+    REQUIRE(replayed.num_total == first.num_total);
+    REQUIRE(output == first_output);
+
+    test.run_or_replay(cache, "other exec", "settings", output);
+    REQUIRE(test.num_runs == 2);
+
+    test.run_or_replay(cache, "exec", "other settings", output);
+    REQUIRE(test.num_runs == 3);
+
+    FakeTest other_test{make_test_result("other")};
+    other_test.run_or_replay(cache, "exec", "settings", output);
+    REQUIRE(other_test.num_runs == 1);
+
+    REQUIRE(cache.clear());
+    test.run_or_replay(cache, "exec", "settings", output);
+    REQUIRE(test.num_runs == 4);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Results of tests that errored or timed out are not cached") {
+    const auto dir = make_temp_dir();
+    ResultCache cache{dir};
+    std::string output;
+
+    TestResult erroring_result = make_test_result("erroring");
+    erroring_result.error = ContextInternalError{ErrorKind::UnexpectedReturn, "oops"};
+    FakeTest erroring{erroring_result};
+
+    TestResult timing_out_result = make_test_result("timing out");
+    timing_out_result.timed_out = true;
+    FakeTest timing_out{timing_out_result};
+
+    for (int i = 0; i < 2; ++i) {
+        REQUIRE_FALSE(erroring.run_or_replay(cache, "exec", "settings", output).from_cache);
+        REQUIRE_FALSE(timing_out.run_or_replay(cache, "exec", "settings", output).from_cache);
+    }
+
+    REQUIRE(erroring.num_runs == 2);
+    REQUIRE(timing_out.num_runs == 2);
+    REQUIRE(list_entries(dir).empty());
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Cache entries with a different key or corrupt contents are ignored") {
+    const auto dir = make_temp_dir();
+    ResultCache cache{dir};
+    std::string output;
+
+    FakeTest test{make_test_result("passing")};
+    test.run_or_replay(cache, "exec", "settings", output);
+
+    const std::vector<std::filesystem::path> entries = list_entries(dir);
+    REQUIRE(entries.size() == 1);
+    const std::string contents = read_entry(entries.at(0));
+
+    SECTION("different key") {
+        // As if another key hashed to the same entry
+        std::string other_key_contents = contents;
+        const auto exec_pos = other_key_contents.find("/exec/");
+        REQUIRE(exec_pos != std::string::npos);
+        other_key_contents.replace(exec_pos, 6, "/EXEC/");
+        write_entry(entries.at(0), other_key_contents);
+    }
+
+    SECTION("truncated") {
+        write_entry(entries.at(0), contents.substr(0, contents.size() - 3));
+    }
+
+    SECTION("garbage") {
+        write_entry(entries.at(0), std::string(contents.size(), '\xFF'));
+    }
+
+    const TestResult result = test.run_or_replay(cache, "exec", "settings", output);
+    REQUIRE_FALSE(result.from_cache);
+    REQUIRE(test.num_runs == 2);
+
+    // Replaced by the new result
+    REQUIRE(test.run_or_replay(cache, "exec", "settings", output).from_cache);
+    REQUIRE(test.num_runs == 2);
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,176 @@
+#include "catch2_custom.hpp"
+
+#include "api/assignment.hpp"
+#include "grading_session.hpp"
+#include "multi_student_runner.hpp"
+#include "output/plaintext_serializer.hpp"
+#include "output/sink.hpp"
+#include "output/verbosity.hpp"
+#include "registrars/global_registrar.hpp"
+#include "test_runner.hpp"
+#include "user/program_options.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace asmgrader;
+
+// The "thing" assignment is defined in dumb_assignment.cpp
+
+namespace {
+
+class StringSink : public Sink
+{
+public:
+    void write(std::string_view str) override { contents += str; }
+
+    void flush() override {}
+
+    std::string contents;
+};
+
+Assignment& get_dumb_assignment() {
+    auto assignment = GlobalRegistrar::get().get_assignment("thing");
+    REQUIRE(assignment.has_value());
+
+    return assignment->get();
+}
+
+/// Everything that should be the same regardless of how the tests were run
+void require_same_results(const AssignmentResult& lhs, const AssignmentResult& rhs) {
+    REQUIRE(lhs.name == rhs.name);
+    REQUIRE(lhs.num_requirements_total == rhs.num_requirements_total);
+    REQUIRE(lhs.test_results.size() == rhs.test_results.size());
+
+    for (std::size_t i = 0; i < lhs.test_results.size(); ++i) {
+        const TestResult& lhs_test = lhs.test_results[i];
+        const TestResult& rhs_test = rhs.test_results[i];
+
+        REQUIRE(lhs_test.name == rhs_test.name);
+        REQUIRE(lhs_test.num_passed == rhs_test.num_passed);
+        REQUIRE(lhs_test.num_total == rhs_test.num_total);
+        REQUIRE(lhs_test.error.has_value() == rhs_test.error.has_value());
+        REQUIRE(lhs_test.requirement_results.size() == rhs_test.requirement_results.size());
+    }
+}
+
+struct TestRun
+{
+    AssignmentResult result;
+    std::string output;
+};
+
+TestRun run_tests(std::size_t num_test_jobs) {
+    StringSink sink;
+    auto serializer =
+        std::make_shared<PlainTextSerializer>(sink, ProgramOptions::ColorizeOpt::Never, VerbosityLevel::Max);
+
+    AssignmentTestRunner runner{get_dumb_assignment(), serializer, std::nullopt, {}, num_test_jobs};
+    AssignmentResult result = runner.run_all(ASM_TESTS_EXEC);
+
+    return {.result = std::move(result), .output = std::move(sink.contents)};
+}
+
+std::vector<StudentInfo> make_students() {
+    std::vector<StudentInfo> students;
+
+    for (const char* name : {"alice", "bob", "carol", "dave", "erin"}) {
+        students.push_back(StudentInfo{.first_name = name,
+                                       .last_name = "",
+                                       .names_known = false,
+                                       .assignment_path = ASM_TESTS_EXEC,
+                                       .subst_regex_string = ""});
+    }
+
+    return students;
+}
+
+struct StudentsRun
+{
+    MultiStudentResult result;
+    std::string output;
+};
+
+StudentsRun run_students(std::size_t num_jobs, ProgramOptions::OutputOrderOpt output_order,
+                         ProgramOptions::JobsModeOpt jobs_mode) {
+    StringSink sink;
+    auto serializer =
+        std::make_shared<PlainTextSerializer>(sink, ProgramOptions::ColorizeOpt::Never, VerbosityLevel::Max);
+
+    MultiStudentRunner runner{get_dumb_assignment(), serializer, std::nullopt, {}, num_jobs, output_order, jobs_mode};
+    MultiStudentResult result = runner.run_all_students(make_students());
+
+    return {.result = std::move(result), .output = std::move(sink.contents)};
+}
+
+/// For output in which the order of students isn't known
+std::vector<std::string_view> sorted_lines(std::string_view str) {
+    std::vector<std::string_view> lines;
+
+    for (std::size_t pos = 0; pos < str.size();) {
+        const std::size_t end = std::min(str.find('\n', pos), str.size());
+        lines.push_back(str.substr(pos, end - pos));
+        pos = end + 1;
+    }
+
+    std::ranges::sort(lines);
+
+    return lines;
+}
+
+} // namespace
+
+TEST_CASE("Running tests concurrently gives the same output and results as running them serially") {
+    const TestRun serial = run_tests(1);
+    REQUIRE(serial.result.all_passed());
+    REQUIRE(serial.result.test_results.size() == 3);
+
+    for (const std::size_t num_test_jobs : {2, 4}) {
+        const TestRun concurrent = run_tests(num_test_jobs);
+
+        require_same_results(concurrent.result, serial.result);
+        REQUIRE(concurrent.output == serial.output);
+    }
+}
+
+TEST_CASE("Grading students concurrently gives the same output and results as grading them serially") {
+    using enum ProgramOptions::OutputOrderOpt;
+
+    const auto jobs_mode = GENERATE(ProgramOptions::JobsModeOpt::Thread, ProgramOptions::JobsModeOpt::Process);
+
+    const StudentsRun serial = run_students(1, Student, jobs_mode);
+    REQUIRE(serial.result.results.size() == 5);
+
+    for (const StudentResult& student : serial.result.results) {
+        REQUIRE(student.result.all_passed());
+    }
+
+    const auto require_same_results_as_serial = [&](const StudentsRun& concurrent) {
+        REQUIRE(concurrent.result.results.size() == serial.result.results.size());
+
+        // Results are in the order of students, regardless of the output order
+        for (std::size_t i = 0; i < serial.result.results.size(); ++i) {
+            REQUIRE(concurrent.result.results[i].info.first_name == serial.result.results[i].info.first_name);
+            require_same_results(concurrent.result.results[i].result, serial.result.results[i].result);
+        }
+    };
+
+    SECTION("in order of students") {
+        const StudentsRun concurrent = run_students(3, Student, jobs_mode);
+
+        require_same_results_as_serial(concurrent);
+        REQUIRE(concurrent.output == serial.output);
+    }
+
+    SECTION("in order of completion") {
+        const StudentsRun concurrent = run_students(3, Completion, jobs_mode);
+
+        require_same_results_as_serial(concurrent);
+        REQUIRE(sorted_lines(concurrent.output) == sorted_lines(serial.output));
+    }
+}
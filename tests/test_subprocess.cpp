@@ -1,19 +1,38 @@
 #include "catch2_custom.hpp"
 
+#include "common/aliases.hpp"
+#include "common/byte.hpp"
+#include "common/byte_vector.hpp"
 #include "common/error_types.hpp"
 #include "common/timespec_operator_eq.hpp" // IWYU pragma: keep
 #include "logging.hpp"
+#include "subprocess/fork_server.hpp"
+#include "subprocess/memory/memory_io_base.hpp"
+#include "subprocess/memory/memory_io_serde.hpp" // IWYU pragma: keep
+#include "subprocess/process_reaper.hpp"
 #include "subprocess/run_result.hpp"
 #include "subprocess/subprocess.hpp"
 #include "subprocess/syscall_record.hpp"
+#include "subprocess/trace_loop.hpp"
 #include "subprocess/traced_subprocess.hpp"
+#include "subprocess/tracer.hpp"
+#include "subprocess/tracer_options.hpp"
 
+#include <catch2/catch_message.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 #include <fmt/ranges.h>
+#include <range/v3/algorithm/equal.hpp>
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <ctime>
+#include <memory>
+#include <optional>
+#include <string>
 #include <variant>
+#include <vector>
 
 #include <sys/syscall.h>
 #include <unistd.h>
@@ -43,6 +62,37 @@ TEST_CASE("Read /bin/echo stdout") {
     REQUIRE(proc.read_stdout() == "Hello world!");
 }
 
+TEST_CASE("Spawned processes are referred to by a pidfd") {
+    asmgrader::Subprocess proc("/bin/echo", {"-n", "Hello"});
+    REQUIRE(proc.start());
+    REQUIRE(proc.get_pidfd() != -1);
+
+    proc.wait_for_exit();
+
+    REQUIRE(proc.read_stdout() == "Hello");
+}
+
+TEST_CASE("Starting a nonexistent executable fails") {
+    asmgrader::Subprocess proc("/this/file/does/not/exist", {});
+    REQUIRE_FALSE(proc.start());
+}
+
+TEST_CASE("Killed processes are reaped in the background") {
+    asmgrader::ProcessReaper reaper;
+
+    {
+        asmgrader::Subprocess proc("/bin/sleep", {"10"});
+        REQUIRE(proc.start());
+        proc.set_reaper(&reaper);
+
+        REQUIRE(proc.kill());
+        REQUIRE_FALSE(proc.is_alive());
+    }
+
+    reaper.wait_idle();
+    REQUIRE(reaper.num_reaped() == 1);
+}
+
 TEST_CASE("Interact with /bin/cat") {
     using namespace std::chrono_literals;
 
@@ -58,6 +108,44 @@ TEST_CASE("Interact with /bin/cat") {
     REQUIRE(proc.read_stdout(100ms) == "Du Du DUHHH");
 }
 
+TEST_CASE("Send more stdin to /bin/cat than fits in the pipe") {
+    using namespace std::chrono_literals;
+
+    asmgrader::Subprocess proc("/bin/cat", {});
+    REQUIRE(proc.start());
+
+    const std::string input(std::size_t{256} * 1024, 'x');
+
+    // Must not block, even though cat can't keep up
+    REQUIRE(proc.send_stdin(input));
+
+    std::string output;
+    for (int i = 0; i < 1000 && output.size() < input.size(); ++i) {
+        auto res = proc.read_stdout(100ms);
+        REQUIRE(res);
+        output += res.value();
+    }
+
+    REQUIRE(output == input);
+    REQUIRE_FALSE(proc.get_stdin_pump().has_queued());
+    REQUIRE(proc.get_stdin_pump().num_consumed() == input.size());
+}
+
+TEST_CASE("Discard stdin that was not read") {
+    asmgrader::Subprocess proc("/bin/sleep", {"10"});
+    REQUIRE(proc.start());
+
+    REQUIRE(proc.send_stdin("Hello!"));
+
+    auto& pump = proc.get_stdin_pump();
+    REQUIRE(pump.num_unread() == std::size_t{6});
+    REQUIRE(pump.discard() == std::size_t{6});
+    REQUIRE(pump.num_unread() == std::size_t{0});
+    REQUIRE(pump.num_consumed() == std::size_t{0});
+
+    REQUIRE(proc.kill());
+}
+
 TEST_CASE("Get results of asm program") {
     asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {});
     REQUIRE(proc.start());
@@ -77,6 +165,351 @@ TEST_CASE("Get results of asm program") {
     REQUIRE(syscall_records.size() == 2);
     REQUIRE(syscall_records.at(0).num == SYS_write);
     REQUIRE(syscall_records.at(1).num == SYS_exit);
-    REQUIRE(syscall_records.at(1).args.size() == 1);
-    REQUIRE(syscall_records.at(1).args.at(0) == asmgrader::SyscallRecord::SyscallArg{42});
+    REQUIRE(syscall_records.at(1).args().size() == 1);
+    REQUIRE(syscall_records.at(1).args().at(0) == asmgrader::SyscallRecord::SyscallArg{42});
+}
+
+TEST_CASE("Tracing policies limit the syscalls recorded") {
+    using asmgrader::TracingPolicy;
+
+    asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {});
+    REQUIRE(proc.start());
+
+    SECTION("None") {
+        auto run_res = proc.run(TracingPolicy::None);
+
+        REQUIRE(run_res->get_kind() == asmgrader::RunResult::Kind::Exited);
+        REQUIRE(run_res->get_code() == 42);
+        REQUIRE(proc.get_tracer().get_records().empty());
+    }
+
+    SECTION("ExitOnly") {
+        auto run_res = proc.run(TracingPolicy::ExitOnly);
+
+        REQUIRE(run_res->get_kind() == asmgrader::RunResult::Kind::Exited);
+
+        auto syscall_records = proc.get_tracer().get_records();
+        REQUIRE(syscall_records.size() == 1);
+        REQUIRE(syscall_records.at(0).num == SYS_exit);
+    }
+
+    REQUIRE(proc.read_stdout() == "Hello, from assembly!\n");
+}
+
+TEST_CASE("Drive many tracees at once with a TraceLoop") {
+    using asmgrader::Result, asmgrader::RunResult;
+
+    constexpr std::size_t NUM_TRACEES = 8;
+
+    std::vector<std::unique_ptr<asmgrader::TracedSubprocess>> procs;
+    for (std::size_t i = 0; i < NUM_TRACEES; ++i) {
+        procs.push_back(std::make_unique<asmgrader::TracedSubprocess>(ASM_TESTS_EXEC, std::vector<std::string>{}));
+        REQUIRE(procs.back()->start());
+    }
+
+    // Blocks on reading stdin until it is given up on, which must not hold up the others
+    asmgrader::TracedSubprocess blocked_proc("/bin/cat", {});
+    REQUIRE(blocked_proc.start());
+
+    asmgrader::TraceLoop loop;
+    std::vector<std::optional<Result<RunResult>>> results(NUM_TRACEES);
+    std::optional<Result<RunResult>> blocked_result;
+
+    for (std::size_t i = 0; i < NUM_TRACEES; ++i) {
+        REQUIRE(loop.start(procs[i]->get_tracer(), [&results, i](Result<RunResult> res) { results[i] = res; }));
+    }
+    REQUIRE(loop.start(blocked_proc.get_tracer(), [&blocked_result](Result<RunResult> res) { blocked_result = res; }));
+
+    REQUIRE(loop.num_in_flight() == NUM_TRACEES + 1);
+    loop.run();
+    REQUIRE(loop.num_in_flight() == 0);
+
+    for (std::size_t i = 0; i < NUM_TRACEES; ++i) {
+        REQUIRE(results[i].has_value());
+        REQUIRE((*results[i])->get_kind() == RunResult::Kind::Exited);
+        REQUIRE((*results[i])->get_code() == 42);
+        REQUIRE(procs[i]->get_tracer().get_records().size() == 2);
+        REQUIRE(procs[i]->read_stdout() == "Hello, from assembly!\n");
+    }
+
+    REQUIRE(blocked_result == asmgrader::ErrorKind::Blocked);
+}
+
+TEST_CASE("Start a run from a TraceLoop callback") {
+    using asmgrader::Result, asmgrader::RunResult;
+
+    asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {});
+    REQUIRE(proc.start());
+
+    asmgrader::TraceLoop loop;
+    std::optional<Result<RunResult>> final_result;
+
+    auto on_write = [&](Result<RunResult> res) {
+        REQUIRE(res == asmgrader::ErrorKind::SyscallPredSat);
+        REQUIRE(proc.get_tracer().get_records().back().num == SYS_write);
+
+        auto on_exit = [&final_result](Result<RunResult> final_res) { final_result = final_res; };
+        REQUIRE(loop.start(proc.get_tracer(), on_exit));
+    };
+
+    REQUIRE(loop.start(proc.get_tracer(), on_write, [](const asmgrader::SyscallRecord& rec) {
+        return rec.num == SYS_write;
+    }));
+
+    loop.run();
+
+    REQUIRE(final_result.has_value());
+    REQUIRE((*final_result)->get_kind() == RunResult::Kind::Exited);
+    REQUIRE((*final_result)->get_code() == 42);
+}
+
+TEST_CASE("Read and write tracee memory, including read-only pages") {
+    using enum asmgrader::MemoryIOKind;
+    auto memory_io_kind = GENERATE(Auto, Ptrace, ProcessVm, ProcMem);
+    CAPTURE(memory_io_kind);
+
+    asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {}, {.memory_io = memory_io_kind});
+    REQUIRE(proc.start());
+
+    auto& tracer = proc.get_tracer();
+    auto& mio = tracer.get_memory_io();
+
+    // Writable mapping created by the tracer
+    std::uintptr_t mmapped_addr = tracer.get_mmapped_addr();
+    std::string str(asmgrader::Tracer::MMAP_LENGTH - 1, 'x');
+
+    REQUIRE(mio.write(mmapped_addr, str));
+    REQUIRE(mio.read<std::string>(mmapped_addr) == str);
+
+    // Text page at the entry point; not writable by the tracee itself
+    auto regs = tracer.get_registers();
+    REQUIRE(regs);
+#ifdef __aarch64__
+    std::uintptr_t text_addr = regs->pc;
+#else // x86_64 assumed
+    std::uintptr_t text_addr = regs->rip;
+#endif
+
+    auto orig_text = mio.read_bytes(text_addr, 16);
+    REQUIRE(orig_text);
+
+    asmgrader::NativeByteVector patch(16, asmgrader::Byte{0xAB});
+    REQUIRE(mio.write(text_addr, patch));
+    REQUIRE(ranges::equal(mio.read_bytes(text_addr, 16).value(), patch));
+
+    REQUIRE(mio.write(text_addr, *orig_text));
+    REQUIRE(ranges::equal(mio.read_bytes(text_addr, 16).value(), *orig_text));
+}
+
+TEST_CASE("Trace only a subset of syscalls with a seccomp filter") {
+    SECTION("No additional syscalls") {
+        asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {}, {.traced_syscalls = std::vector<asmgrader::u64>{}});
+        REQUIRE(proc.start());
+
+        auto run_res = proc.run();
+
+        REQUIRE(run_res->get_kind() == asmgrader::RunResult::Kind::Exited);
+        REQUIRE(run_res->get_code() == 42);
+        REQUIRE(proc.read_stdout() == "Hello, from assembly!\n");
+
+        // exit is always traced
+        const auto& syscall_records = proc.get_tracer().get_records();
+        REQUIRE(syscall_records.size() == 1);
+        REQUIRE(syscall_records.at(0).num == SYS_exit);
+    }
+
+    SECTION("Only write") {
+        asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {}, {.traced_syscalls = std::vector<asmgrader::u64>{SYS_write}});
+        REQUIRE(proc.start());
+
+        auto run_res = proc.run();
+
+        REQUIRE(run_res->get_kind() == asmgrader::RunResult::Kind::Exited);
+        REQUIRE(run_res->get_code() == 42);
+
+        const auto& syscall_records = proc.get_tracer().get_records();
+        REQUIRE(syscall_records.size() == 2);
+        REQUIRE(syscall_records.at(0).num == SYS_write);
+        // the exit of the write syscall must also have been observed
+        REQUIRE(syscall_records.at(0).ret.has_value());
+        REQUIRE(syscall_records.at(1).num == SYS_exit);
+    }
+}
+
+TEST_CASE("Spawn tracees from a fork server") {
+    asmgrader::ForkServer fork_server(ASM_TESTS_EXEC, {});
+    REQUIRE(fork_server.start());
+
+    // Each child must be fully independent of the others, and of the pristine tracee
+    for (int i = 0; i < 3; ++i) {
+        CAPTURE(i);
+
+        asmgrader::TracedSubprocess proc(fork_server);
+        REQUIRE(proc.start());
+
+        auto run_res = proc.run();
+
+        REQUIRE(run_res->get_kind() == asmgrader::RunResult::Kind::Exited);
+        REQUIRE(run_res->get_code() == 42);
+        REQUIRE(proc.read_stdout() == "Hello, from assembly!\n");
+    }
+
+    // Restarting goes through the fork server as well
+    asmgrader::TracedSubprocess proc(fork_server);
+    REQUIRE(proc.start());
+    REQUIRE(proc.run());
+    REQUIRE(proc.read_stdout() == "Hello, from assembly!\n");
+    REQUIRE(proc.restart());
+    REQUIRE(proc.run()->get_code() == 42);
+    REQUIRE(proc.read_stdout() == "Hello, from assembly!\n");
+}
+
+TEST_CASE("Restore a tracee in place from a checkpoint") {
+    asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {});
+    REQUIRE(proc.start());
+
+    auto& tracer = proc.get_tracer();
+    auto& mio = tracer.get_memory_io();
+    REQUIRE(tracer.has_checkpoint());
+
+    const std::uintptr_t mmapped_addr = tracer.get_mmapped_addr();
+    const auto orig_mem = mio.read_bytes(mmapped_addr, asmgrader::Tracer::MMAP_LENGTH);
+    const auto orig_regs = tracer.get_registers();
+    REQUIRE(orig_mem);
+    REQUIRE(orig_regs);
+
+    // Clobber memory and registers, then run up to the first syscall
+    REQUIRE(mio.write(mmapped_addr, std::string(100, 'x')));
+    auto clobbered_regs = *orig_regs;
+#ifdef __aarch64__
+    clobbered_regs.sp -= 0x100;
+#else // x86_64 assumed
+    clobbered_regs.rsp -= 0x100;
+#endif
+    REQUIRE(tracer.set_registers(clobbered_regs));
+    REQUIRE(proc.run_until([](const asmgrader::SyscallRecord&) { return true; }) == asmgrader::ErrorKind::SyscallPredSat);
+
+    REQUIRE(proc.restart());
+
+    REQUIRE(ranges::equal(mio.read_bytes(mmapped_addr, asmgrader::Tracer::MMAP_LENGTH).value(), *orig_mem));
+#ifdef __aarch64__
+    REQUIRE(tracer.get_registers()->pc == orig_regs->pc);
+    REQUIRE(tracer.get_registers()->sp == orig_regs->sp);
+#else // x86_64 assumed
+    REQUIRE(tracer.get_registers()->rip == orig_regs->rip);
+    REQUIRE(tracer.get_registers()->rsp == orig_regs->rsp);
+#endif
+
+    // The restored process runs exactly as a fresh one would
+    auto run_res = proc.run();
+    REQUIRE(run_res->get_kind() == asmgrader::RunResult::Kind::Exited);
+    REQUIRE(run_res->get_code() == 42);
+}
+
+TEST_CASE("Decode syscall arguments lazily or eagerly") {
+    using asmgrader::SyscallRecord;
+
+    auto get_write_buf = [](const SyscallRecord& rec) {
+        return std::get<asmgrader::Result<std::string>>(rec.args().at(1));
+    };
+
+    SECTION("Lazily, after the tracee has resumed") {
+        asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {});
+        REQUIRE(proc.start());
+        REQUIRE(proc.run());
+
+        const SyscallRecord& write_rec = proc.get_tracer().get_records().at(0);
+        REQUIRE(write_rec.num == SYS_write);
+        REQUIRE_FALSE(write_rec.can_decode_args());
+
+        // Integral arguments are always available, but memory is not
+        REQUIRE(write_rec.args().at(0) == SyscallRecord::SyscallArg{1});
+        REQUIRE_FALSE(get_write_buf(write_rec));
+    }
+
+    SECTION("Lazily, while stopped at the syscall") {
+        asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {});
+        REQUIRE(proc.start());
+
+        std::optional<asmgrader::Result<std::string>> buf;
+        REQUIRE_FALSE(proc.run_until([&](const SyscallRecord& rec) {
+            REQUIRE(rec.can_decode_args());
+            buf = get_write_buf(rec);
+            return true;
+        }));
+
+        REQUIRE(buf.has_value());
+        REQUIRE(buf->value().starts_with("Hello, from assembly!\n"));
+    }
+
+    SECTION("Eagerly, for selected syscalls") {
+        asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {}, {.eagerly_decoded_syscalls = {SYS_write}});
+        REQUIRE(proc.start());
+        REQUIRE(proc.run());
+
+        const SyscallRecord& write_rec = proc.get_tracer().get_records().at(0);
+        REQUIRE(write_rec.can_decode_args());
+        REQUIRE(get_write_buf(write_rec).value().starts_with("Hello, from assembly!\n"));
+    }
+}
+
+TEST_CASE("Register writes are visible before the tracee is resumed") {
+    asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {});
+    REQUIRE(proc.start());
+
+    auto& tracer = proc.get_tracer();
+    auto regs = tracer.get_registers();
+    REQUIRE(regs);
+
+#ifdef __aarch64__
+    regs->regs[19] = 0xDEADBEEF;
+    REQUIRE(tracer.set_registers(*regs));
+    REQUIRE(tracer.get_registers()->regs[19] == 0xDEADBEEF);
+#else // x86_64 assumed
+    regs->r15 = 0xDEADBEEF;
+    REQUIRE(tracer.set_registers(*regs));
+    REQUIRE(tracer.get_registers()->r15 == 0xDEADBEEF);
+#endif
+
+    // Written back upon resuming; the program doesn't rely on the register
+    auto run_res = proc.run();
+    REQUIRE(run_res->get_kind() == asmgrader::RunResult::Kind::Exited);
+    REQUIRE(run_res->get_code() == 42);
+}
+
+TEST_CASE("Injected syscalls run from the trampoline") {
+    asmgrader::TracedSubprocess proc(ASM_TESTS_EXEC, {});
+    REQUIRE(proc.start());
+
+    auto& tracer = proc.get_tracer();
+    auto& mio = tracer.get_memory_io();
+
+    const auto orig_regs = tracer.get_registers();
+    REQUIRE(orig_regs);
+#ifdef __aarch64__
+    const std::uintptr_t instr_ptr = orig_regs->pc;
+#else // x86_64 assumed
+    const std::uintptr_t instr_ptr = orig_regs->rip;
+#endif
+    const auto orig_text = mio.read_bytes(instr_ptr, 16);
+    REQUIRE(orig_text);
+
+    for (int i = 0; i < 3; ++i) {
+        auto getpid_res = tracer.execute_syscall(SYS_getpid, {});
+        REQUIRE(getpid_res);
+        REQUIRE(getpid_res->ret);
+        REQUIRE(getpid_res->ret->value() == proc.get_pid());
+    }
+
+    // Neither the code nor the registers of the tracee were changed
+    REQUIRE(ranges::equal(mio.read_bytes(instr_ptr, 16).value(), *orig_text));
+#ifdef __aarch64__
+    REQUIRE(tracer.get_registers()->pc == instr_ptr);
+#else // x86_64 assumed
+    REQUIRE(tracer.get_registers()->rip == instr_ptr);
+#endif
+
+    auto run_res = proc.run();
+    REQUIRE(run_res->get_kind() == asmgrader::RunResult::Kind::Exited);
+    REQUIRE(run_res->get_code() == 42);
 }
@@ -0,0 +1,136 @@
+#include "catch2_custom.hpp"
+
+#include "common/aliases.hpp"
+#include "common/error_types.hpp"
+#include "common/expected.hpp"
+#include "common/linux.hpp"
+#include "subprocess/syscall_log.hpp"
+#include "subprocess/syscall_record.hpp"
+#include "subprocess/tracer_options.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cerrno>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <variant>
+#include <vector>
+
+#include <sys/syscall.h>
+
+using namespace asmgrader::aliases;
+using asmgrader::SyscallLog;
+using asmgrader::SyscallLogOverflow;
+using asmgrader::SyscallRecord;
+
+namespace {
+
+SyscallRecord make_record(u64 num, u64 first_arg) {
+    return SyscallRecord{.num = num,
+                         .raw_args = {first_arg, 0, 0, 0, 0, 0},
+                         .ret = std::nullopt,
+                         .instruction_pointer = 0x1000 + first_arg,
+                         .stack_pointer = 0x2000,
+                         .stop_id = 0,
+                         .tracee_state = {},
+                         .decoded_args = std::nullopt};
+}
+
+std::vector<u64> first_args(const SyscallLog& log) {
+    std::vector<u64> result;
+    for (const SyscallRecord& rec : log.view()) {
+        result.push_back(rec.raw_args[0]);
+    }
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("Syscall log stores records and return values") {
+    SyscallLog log;
+
+    log.push(make_record(SYS_getpid, 1));
+    REQUIRE(log.awaiting_ret());
+    log.set_last_ret(1234);
+    REQUIRE_FALSE(log.awaiting_ret());
+
+    log.push(make_record(SYS_close, 2));
+    log.set_last_ret(asmgrader::linux::make_error_code(EBADF));
+
+    log.push(make_record(SYS_exit, 3));
+
+    REQUIRE(log.size() == 3);
+    REQUIRE(log.num_at(1) == SYS_close);
+
+    auto view = log.view();
+    REQUIRE(view.at(0).ret == asmgrader::Expected<i64>{1234});
+    REQUIRE(view.at(0).instruction_pointer == 0x1001);
+    REQUIRE(view.at(1).ret.has_value());
+    REQUIRE(view.at(1).ret->error() == std::make_error_code(std::errc::bad_file_descriptor));
+    REQUIRE_FALSE(view.back().ret.has_value());
+
+    // Integral arguments are always reconstructed from raw register values
+    REQUIRE(view.back().args().at(0) == SyscallRecord::SyscallArg{3});
+}
+
+TEST_CASE("Syscall log round-trips eagerly decoded arguments") {
+    SyscallLog log;
+
+    SyscallRecord write_rec = make_record(SYS_write, 1);
+    write_rec.decoded_args = {SyscallRecord::SyscallArg{1}, asmgrader::Result<std::string>{std::string{"Hello!"}},
+                              SyscallRecord::SyscallArg{u64{6}}};
+    log.push(write_rec);
+
+    SyscallRecord failed_write_rec = make_record(SYS_write, 1);
+    failed_write_rec.decoded_args = {SyscallRecord::SyscallArg{1},
+                                     asmgrader::Result<std::string>{asmgrader::ErrorKind::SyscallFailure},
+                                     SyscallRecord::SyscallArg{u64{6}}};
+    log.push(failed_write_rec);
+
+    REQUIRE(log.view().at(0).args() == *write_rec.decoded_args);
+    REQUIRE(log.view().at(1).args() == *failed_write_rec.decoded_args);
+}
+
+TEST_CASE("Syscall log capacity is respected") {
+    SECTION("Drop newest") {
+        SyscallLog log(3, SyscallLogOverflow::DropNewest, {});
+
+        for (u64 i = 0; i < 5; ++i) {
+            log.push(make_record(SYS_getpid, i));
+            log.set_last_ret(0);
+        }
+
+        REQUIRE(first_args(log) == std::vector<u64>{0, 1, 2});
+        REQUIRE(log.num_dropped() == 2);
+    }
+
+    SECTION("Ring") {
+        SyscallLog log(3, SyscallLogOverflow::Ring, {});
+
+        for (u64 i = 0; i < 5; ++i) {
+            log.push(make_record(SYS_getpid, i));
+            log.set_last_ret(static_cast<i64>(i));
+        }
+
+        REQUIRE(first_args(log) == std::vector<u64>{2, 3, 4});
+        REQUIRE(log.num_dropped() == 2);
+        REQUIRE(log.view().back().ret == asmgrader::Expected<i64>{4});
+    }
+
+    SECTION("Ring with many decoded payloads") {
+        SyscallLog log(2, SyscallLogOverflow::Ring, {});
+        const std::string payload(1000, 'x');
+
+        for (u64 i = 0; i < 1000; ++i) {
+            SyscallRecord rec = make_record(SYS_write, i);
+            rec.decoded_args = {SyscallRecord::SyscallArg{1},
+                                asmgrader::Result<std::string>{payload + std::to_string(i)},
+                                SyscallRecord::SyscallArg{u64{0}}};
+            log.push(rec);
+        }
+
+        REQUIRE(log.size() == 2);
+        REQUIRE(std::get<asmgrader::Result<std::string>>(log.view().at(1).args().at(1)) == payload + "999");
+    }
+}
@@ -0,0 +1,118 @@
+#include "catch2_custom.hpp"
+
+#include "grading_session.hpp"
+#include "timing_db.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+using namespace asmgrader;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::filesystem::path make_temp_dir() {
+    auto dir = std::filesystem::temp_directory_path() / ("asmgrader-timing-db-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    return dir;
+}
+
+StudentInfo make_student(const std::filesystem::path& exec_path, std::size_t exec_size) {
+    std::ofstream{exec_path, std::ios::binary | std::ios::trunc} << std::string(exec_size, 'x');
+
+    return StudentInfo{.first_name = exec_path.stem().string(),
+                       .last_name = "",
+                       .names_known = false,
+                       .assignment_path = exec_path,
+                       .subst_regex_string = ""};
+}
+
+TestResult make_test_result(const std::string& name, std::chrono::milliseconds duration, bool from_cache = false) {
+    return TestResult{.name = name,
+                      .requirement_results = {},
+                      .num_passed = 0,
+                      .num_total = 0,
+                      .weight = 1,
+                      .error = std::nullopt,
+                      .from_cache = from_cache,
+                      .duration = duration};
+}
+
+bool every_test(std::string_view /*test_name*/) {
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("Timing database predicts from recorded durations") {
+    const auto dir = make_temp_dir();
+    const StudentInfo alice = make_student(dir / "alice", 1000);
+    const StudentInfo bob = make_student(dir / "bob", 1000);
+
+    TimingDb timings{dir / "timings.json"};
+    REQUIRE(timings.load());
+    REQUIRE(timings.predict_student("lab", alice, every_test) == 0ms);
+
+    timings.record({.info = alice,
+                    .result = {.name = "lab",
+                               .test_results = {make_test_result("fast", 10ms), make_test_result("slow", 100ms)}}});
+    timings.record({.info = bob,
+                    .result = {.name = "lab",
+                               .test_results = {make_test_result("fast", 30ms), make_test_result("slow", 300ms)}}});
+    timings.record({.info = bob,
+                    .result = {.name = "lab",
+                               .test_results = {make_test_result("fast", 20ms),
+                                                make_test_result("slow", 5000ms, /*from_cache=*/true)}}});
+
+    REQUIRE(timings.predict_test("lab", "fast") == 20ms);
+    REQUIRE(timings.predict_test("lab", "slow") == 300ms);
+    REQUIRE(timings.predict_test("lab", "unknown") == 0ms);
+    REQUIRE(timings.predict_test("other lab", "fast") == 0ms);
+
+    // Known students take as long as last time, except for replayed tests, which keep the duration of when they were
+    // last run
+    REQUIRE(timings.predict_student("lab", alice, every_test) == 110ms);
+    REQUIRE(timings.predict_student("lab", bob, every_test) == 320ms);
+
+    // Tests that won't be run (e.g., as they're cached) take no time
+    const auto only_fast = [](std::string_view test_name) { return test_name == "fast"; };
+    REQUIRE(timings.predict_student("lab", alice, only_fast) == 10ms);
+    REQUIRE(timings.predict_student("lab", make_student(dir / "carol", 1000), only_fast) == 20ms);
+
+    REQUIRE(timings.save());
+
+    TimingDb reloaded{dir / "timings.json"};
+    REQUIRE(reloaded.load());
+    REQUIRE(reloaded.predict_test("lab", "slow") == 300ms);
+    REQUIRE(reloaded.predict_student("lab", alice, every_test) == 110ms);
+
+    // New students take as long as the median of each test, scaled by executable size within limits
+    REQUIRE(reloaded.predict_student("lab", make_student(dir / "carol", 1000), every_test) == 320ms);
+    REQUIRE(reloaded.predict_student("lab", make_student(dir / "dave", 1500), every_test) == 480ms);
+    REQUIRE(reloaded.predict_student("lab", make_student(dir / "erin", 100000), every_test) == 640ms);
+
+    // A resubmission is treated as a new student
+    REQUIRE(reloaded.predict_student("lab", make_student(dir / "alice", 500), every_test) == 160ms);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Malformed timing database is ignored") {
+    const auto dir = make_temp_dir();
+    std::ofstream{dir / "timings.json"} << "{ not json";
+
+    TimingDb timings{dir / "timings.json"};
+    REQUIRE_FALSE(timings.load());
+    REQUIRE(timings.predict_test("lab", "fast") == 0ms);
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,140 @@
+#include "catch2_custom.hpp"
+
+#include "common/error_types.hpp"
+#include "subprocess/memory/tracee_heap.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <set>
+#include <vector>
+
+using asmgrader::TraceeAllocation;
+using asmgrader::TraceeHeap;
+
+namespace {
+
+// Not actually mapped anywhere; the heap only does bookkeeping
+constexpr std::uintptr_t FAKE_ARENA_BASE = 0x7000'0000'0000;
+
+/// Allocates from `heap`, adding a fake arena if needed
+TraceeAllocation allocate(TraceeHeap& heap, std::size_t size) {
+    static std::uintptr_t next_arena = FAKE_ARENA_BASE;
+
+    if (auto allocation = heap.allocate(size)) {
+        return *allocation;
+    }
+
+    const std::size_t length = TraceeHeap::arena_size_for(size);
+    heap.add_arena(next_arena, length);
+    next_arena += length + TraceeHeap::PAGE_SIZE;
+
+    auto allocation = heap.allocate(size);
+    REQUIRE(allocation);
+
+    return *allocation;
+}
+
+} // namespace
+
+TEST_CASE("Tracee heap needs an arena before allocating") {
+    auto heap = std::make_shared<TraceeHeap>();
+
+    REQUIRE_FALSE(heap->allocate(1).has_value());
+
+    heap->add_arena(FAKE_ARENA_BASE, TraceeHeap::arena_size_for(1));
+    auto allocation = heap->allocate(1);
+
+    REQUIRE(allocation);
+    REQUIRE(allocation->get_address() == FAKE_ARENA_BASE);
+    REQUIRE(allocation->size() == TraceeHeap::MIN_BLOCK_SIZE);
+}
+
+TEST_CASE("Tracee heap allocations are distinct, aligned and rounded to size classes") {
+    auto heap = std::make_shared<TraceeHeap>();
+
+    std::vector<TraceeAllocation> allocations;
+    std::set<std::uintptr_t> addresses;
+
+    for (std::size_t size : std::vector<std::size_t>{1, 16, 17, 100, 4096, 5000, 65536, 65537, 1000000}) {
+        TraceeAllocation allocation = allocate(*heap, size);
+
+        REQUIRE(allocation.size() >= size);
+        REQUIRE(allocation.get_address() % TraceeHeap::MIN_BLOCK_SIZE == 0);
+        REQUIRE(addresses.insert(allocation.get_address()).second);
+
+        allocations.push_back(allocation);
+    }
+
+    REQUIRE(heap->num_allocated() == allocations.size());
+
+    // Large blocks are given whole pages
+    REQUIRE(allocations.back().get_address() % TraceeHeap::PAGE_SIZE == 0);
+    REQUIRE(allocations.back().size() % TraceeHeap::PAGE_SIZE == 0);
+
+    // Blocks don't overlap
+    for (std::size_t i = 0; i < allocations.size(); ++i) {
+        for (std::size_t j = i + 1; j < allocations.size(); ++j) {
+            const auto& first = allocations[i];
+            const auto& second = allocations[j];
+            REQUIRE((first.get_address() + first.size() <= second.get_address() ||
+                     second.get_address() + second.size() <= first.get_address()));
+        }
+    }
+}
+
+TEST_CASE("Tracee heap blocks are freed by their handles and reused") {
+    auto heap = std::make_shared<TraceeHeap>();
+
+    std::uintptr_t small_address{};
+    std::uintptr_t large_address{};
+
+    {
+        TraceeAllocation small = allocate(*heap, 24);
+        TraceeAllocation large = allocate(*heap, 1 << 20);
+        small_address = small.get_address();
+        large_address = large.get_address();
+
+        // Copies share ownership
+        TraceeAllocation small_copy = small;
+        small = {};
+        REQUIRE(heap->num_allocated() == 2);
+    }
+
+    REQUIRE(heap->num_allocated() == 0);
+
+    const std::size_t num_arenas = heap->get_arenas().size();
+
+    REQUIRE(allocate(*heap, 32).get_address() == small_address);
+    REQUIRE(allocate(*heap, 1 << 20).get_address() == large_address);
+    REQUIRE(heap->get_arenas().size() == num_arenas);
+
+    REQUIRE(heap->deallocate(small_address + 1) == asmgrader::ErrorKind::BadArgument);
+}
+
+TEST_CASE("Tracee heap reset makes existing handles inert") {
+    auto heap = std::make_shared<TraceeHeap>();
+
+    TraceeAllocation before_reset = allocate(*heap, 64);
+    const auto generation = heap->get_generation();
+
+    heap->reset();
+
+    REQUIRE(heap->get_generation() != generation);
+    REQUIRE(heap->num_allocated() == 0);
+
+    // The arena is kept, and the same block is handed out again
+    TraceeAllocation after_reset = allocate(*heap, 64);
+    REQUIRE(after_reset.get_address() == before_reset.get_address());
+
+    // Destroying the stale handle must not free the new allocation
+    before_reset = {};
+    REQUIRE(heap->num_allocated() == 1);
+
+    REQUIRE(heap->release().size() == 1);
+    REQUIRE(heap->get_arenas().empty());
+    REQUIRE_FALSE(heap->allocate(64).has_value());
+}